@@ -15,13 +15,22 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <fstream>
 
+// Returns the GUID stored at the given offset of the item header, or an empty string if the header is too short
+static UString headerGuid(TreeModel* model, const UModelIndex & index, const UINT32 offset)
+{
+    UByteArray header = model->header(index);
+    if ((UINT32)header.size() < offset + sizeof(EFI_GUID))
+        return UString();
+    return guidToUString(readUnaligned((const EFI_GUID*)(header.constData() + offset)));
+}
+
 USTATUS FfsDumper::dump(const UModelIndex & root, const UString & path, const DumpMode dumpMode, const UINT8 sectionType, const UString & guid)
 {
     dumped = false;
     counterHeader = counterBody = counterRaw = counterInfo = 0;
     fileList.clear();
 
-    if (changeDirectory(path)) {
+    if (isDirectory(path)) {
         printf("Directory \"%s\" already exists.\n", (const char*)path.toLocal8Bit());
         return U_DIR_ALREADY_EXIST;
     }
@@ -49,11 +58,11 @@ USTATUS FfsDumper::recursiveDump(const UModelIndex & index, const UString & path
 
     if (guid.isEmpty() ||
         (model->subtype(index) == EFI_SECTION_FREEFORM_SUBTYPE_GUID &&
-            guidToUString(readUnaligned((const EFI_GUID*)(model->header(index).constData() + sizeof(EFI_COMMON_SECTION_HEADER)))) == guid) ||
-        guidToUString(readUnaligned((const EFI_GUID*)model->header(index).constData())) == guid ||
-        guidToUString(readUnaligned((const EFI_GUID*)model->header(model->findParentOfType(index, Types::File)).constData())) == guid) {
+            headerGuid(model, index, sizeof(EFI_COMMON_SECTION_HEADER)) == guid) ||
+        headerGuid(model, index, 0) == guid ||
+        headerGuid(model, model->findParentOfType(index, Types::File), 0) == guid) {
 
-        if (!changeDirectory(path) && !makeDirectory(path)) {
+        if (!isDirectory(path) && !makeDirectory(path)) {
             printf("Cannot use directory \"%s\" (recursiveDump part 1).\n", (const char*)path.toLocal8Bit());
             return U_DIR_CREATE;
         }
@@ -64,7 +73,7 @@ USTATUS FfsDumper::recursiveDump(const UModelIndex & index, const UString & path
         }
 
         if (fileList.count(index) == 0
-            && (dumpMode == DUMP_ALL || model->rowCount(index) == 0)
+            && (dumpMode == DUMP_ALL || model->childCount(index) == 0)
             && (sectionType == IgnoreSectionType || model->subtype(index) == sectionType)) {
 
             if ((dumpMode == DUMP_ALL || dumpMode == DUMP_CURRENT || dumpMode == DUMP_HEADER)
@@ -181,7 +190,7 @@ USTATUS FfsDumper::recursiveDump(const UModelIndex & index, const UString & path
 
     USTATUS result;
 
-    for (int i = 0; i < model->rowCount(index); i++) {
+    for (int i = 0; i < model->childCount(index); i++) {
         UModelIndex childIndex = index.child(i, 0);
         bool useText = FALSE;
         if (model->type(childIndex) != Types::Volume)
@@ -189,7 +198,7 @@ USTATUS FfsDumper::recursiveDump(const UModelIndex & index, const UString & path
 
         UString childPath = path;
         if (dumpMode == DUMP_ALL || dumpMode == DUMP_CURRENT) {
-            if (!changeDirectory(path) && !makeDirectory(path)) {
+            if (!isDirectory(path) && !makeDirectory(path)) {
                 printf("Cannot use directory \"%s\" (recursiveDump part 2).\n", (const char*)path.toLocal8Bit());
                 return U_DIR_CREATE;
             }
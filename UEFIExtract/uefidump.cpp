@@ -71,7 +71,7 @@ USTATUS UEFIDumper::dump(const UByteArray & buffer, const UString & inPath, cons
         return U_DIR_CHANGE;
     
     dumped = false;
-    USTATUS result = recursiveDump(model.index(0,0));
+    USTATUS result = recursiveDump(model.childIndex(0));
     if (result)
         return result;
     else if (!dumped)
@@ -103,7 +103,7 @@ USTATUS UEFIDumper::recursiveDump(const UModelIndex & index)
     }
     
     // Add header and body only for leaf sections
-    if (model.rowCount(index) == 0) {
+    if (model.childCount(index) == 0) {
         // Header
         UByteArray data = model.header(index);
         if (!data.isEmpty()) {
@@ -141,7 +141,7 @@ USTATUS UEFIDumper::recursiveDump(const UModelIndex & index)
     
     // Process child items
     USTATUS result;
-    for (int i = 0; i < model.rowCount(index); i++) {
+    for (int i = 0; i < model.childCount(index); i++) {
         result = recursiveDump(index.child(i, 0));
         if (result)
             return result;
@@ -10,8 +10,15 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <cstring>
 #include <cstdlib>
+#include <thread>
+#include <chrono>
+
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
 
 #include "../version.h"
 #include "../common/basetypes.h"
@@ -20,6 +27,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "../common/ffsparser.h"
 #include "../common/ffsreport.h"
 #include "../common/guiddatabase.h"
+#include "../common/utility.h"
 #include "ffsdumper.h"
 #include "uefidump.h"
 
@@ -43,7 +51,197 @@ void print_usage()
         << "       UEFIExtract imagefile GUID_1 ... [ -o FILE_1 ... ] [ -m MODE_1 ... ] [ -t TYPE_1 ... ] -" << std::endl
         << "         Dump only FFS file(s) with specific GUID(s), without report or GUID database." << std::endl
         << "         Type is section type or FF to ignore. Mode is one of: all, body, header, info, file." << std::endl
-        << "         Return value is a bit mask where 0 at position N means that file with GUID_N was found and unpacked, 1 otherwise." << std::endl;
+        << "         Return value is a bit mask where 0 at position N means that file with GUID_N was found and unpacked, 1 otherwise." << std::endl
+        << "       UEFIExtract --batch listfile [-j N] [all | dump | report | guids]" << std::endl
+        << "         Process every image listed in listfile, one path per line, using up to N images in parallel." << std::endl
+        << "         Outputs are the same as for a single image in the given mode, a summary is printed at the end." << std::endl
+        << "Parsed images are cached in the existing directory set by UEFITOOL_PARSE_CACHE environment variable, if any." << std::endl;
+}
+
+// Directory of the persistent parse cache, empty if the cache is disabled
+static UString parseCacheDirectory()
+{
+    const char* directory = std::getenv("UEFITOOL_PARSE_CACHE");
+    return directory ? UString(directory) : UString();
+}
+
+// Generate outputs of one of the standard modes for a parsed image, empty mode is the default one
+static int extractParsedImage(TreeModel & model, const UString & path, const UString & mode)
+{
+    // Create ffsDumper
+    FfsDumper ffsDumper(&model);
+    
+    // Dump only leaf elements, no report or GUID database
+    if (mode == UString("dump")) {
+        return (ffsDumper.dump(model.childIndex(0), path + UString(".dump")) != U_SUCCESS);
+    }
+    // Dump named GUIDs found in the image, no dump or report
+    else if (mode == UString("guids")) {
+        GuidDatabase db = guidDatabaseFromTreeRecursive(&model, model.childIndex(0));
+        if (!db.empty()) {
+            return guidDatabaseExportToFile(path + UString(".guids.csv"), db);
+        }
+        return 1;
+    }
+    // Generate report, no dump or GUID database
+    else if (mode == UString("report")) {
+        FfsReport ffsReport(&model);
+        std::vector<UString> report = ffsReport.generate();
+        if (report.size()) {
+            std::ofstream file;
+            file.open((path + UString(".report.txt")).toLocal8Bit());
+            for (size_t i = 0; i < report.size(); i++)
+                file << report[i].toLocal8Bit() << '\n';
+            return 0;
+        }
+        return 1;
+    }
+    
+    // Either default or all mode
+    // Generate report
+    FfsReport ffsReport(&model);
+    std::vector<UString> report = ffsReport.generate();
+    if (report.size()) {
+        std::ofstream file;
+        file.open((path + UString(".report.txt")).toLocal8Bit());
+        for (size_t i = 0; i < report.size(); i++)
+            file << report[i].toLocal8Bit() << '\n';
+    }
+    
+    // Create GUID database
+    GuidDatabase db = guidDatabaseFromTreeRecursive(&model, model.childIndex(0));
+    if (!db.empty()) {
+        guidDatabaseExportToFile(path + UString(".guids.csv"), db);
+    }
+    
+    // Dump every element with report and GUID database
+    if (mode == UString("all")) {
+        return (ffsDumper.dump(model.childIndex(0), path + UString(".dump"), FfsDumper::DUMP_ALL) != U_SUCCESS);
+    }
+    
+    // Dump all non-leaf elements, with report and GUID database, default
+    return (ffsDumper.dump(model.childIndex(0), path + UString(".dump")) != U_SUCCESS);
+}
+
+static bool isStandardMode(const char* mode)
+{
+    return !std::strcmp(mode, "all") || !std::strcmp(mode, "dump") || !std::strcmp(mode, "report") || !std::strcmp(mode, "guids");
+}
+
+// Peak resident set size of the whole process in KiB, 0 if unknown
+static UINT64 peakMemoryUsage()
+{
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (UINT64)usage.ru_maxrss / 1024;
+#else
+    return (UINT64)usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Batch image processing result
+typedef struct BATCH_RESULT_ {
+    int    result = 0;
+    double seconds = 0;
+    UINT64 peakMemory = 0;
+    std::string info;
+} BATCH_RESULT;
+
+static int batchMain(int argc, char *argv[])
+{
+    // Parse arguments
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+    UINT32 jobs = 1;
+    UString mode;
+    for (int i = 3; i < argc; i++) {
+        if (!std::strcmp(argv[i], "-j") && i + 1 < argc) {
+            char *converted = argv[i + 1];
+            jobs = (UINT32)std::strtoul(argv[i + 1], &converted, 10);
+            if (converted == argv[i + 1] || *converted != '\0' || jobs == 0) {
+                print_usage();
+                return 1;
+            }
+            i++;
+        }
+        else if (mode.isEmpty() && isStandardMode(argv[i])) {
+            mode = UString(argv[i]);
+        }
+        else {
+            print_usage();
+            return 1;
+        }
+    }
+    
+    // Read image list, paths are made absolute the same way as in single image mode
+    std::ifstream listFile(argv[2]);
+    if (!listFile)
+        return U_FILE_OPEN;
+    std::vector<UString> paths;
+    std::string line;
+    while (std::getline(listFile, line)) {
+        if (line.size() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+        // Use sharp symbol as commentary
+        if (line.size() == 0 || line[0] == '#')
+            continue;
+        paths.push_back(getAbsPath(UString(line.c_str())));
+    }
+    
+    // Process images in parallel, each image is parsed by a single thread
+    std::vector<BATCH_RESULT> results(paths.size());
+    std::chrono::steady_clock::time_point batchStart = std::chrono::steady_clock::now();
+    parallelFor(paths.size(), jobs, [&](UINTN i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        UByteArray buffer;
+        if (false == readFileIntoBuffer(paths[i], buffer)) {
+            results[i].result = U_FILE_OPEN;
+        }
+        else {
+            TreeModel model;
+            FfsParser ffsParser(&model);
+            ffsParser.setCacheDirectory(parseCacheDirectory());
+            results[i].result = ffsParser.parse(buffer);
+            if (results[i].result == U_SUCCESS) {
+                // Images are processed in parallel, so parser output is printed when all of them are done
+                std::ostringstream info;
+                ffsParser.outputInfo(info);
+                results[i].info = info.str();
+                results[i].result = extractParsedImage(model, paths[i], mode);
+            }
+        }
+        results[i].seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results[i].peakMemory = peakMemoryUsage();
+    });
+    double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+    
+    // Print parser output of every image in list order
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!results[i].info.empty())
+            std::cout << (const char*)paths[i].toLocal8Bit() << ":" << std::endl << results[i].info;
+    }
+    
+    // Print summary, peak memory is the one of the whole process at the moment the image was done
+    size_t failed = 0;
+    std::cout << "  Result |  Time, s  | Peak RSS, KiB | Image" << std::endl;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (results[i].result)
+            failed++;
+        std::cout << (const char*)usprintf("%8d | %9.3f | %13llu | ", results[i].result, results[i].seconds, (unsigned long long)results[i].peakMemory).toLocal8Bit()
+            << (const char*)paths[i].toLocal8Bit() << std::endl;
+    }
+    std::cout << (const char*)usprintf("%u images, %u failed, %.3f s total, peak RSS %llu KiB",
+        (UINT32)paths.size(), (UINT32)failed, batchSeconds, (unsigned long long)peakMemoryUsage()).toLocal8Bit() << std::endl;
+    
+    return failed ? 1 : 0;
 }
 
 int main(int argc, char *argv[])
@@ -68,6 +266,11 @@ int main(int argc, char *argv[])
         }
     }
     
+    // Batch mode
+    if (!std::strcmp(argv[1], "--batch")) {
+        return batchMain(argc, argv);
+    }
+    
     // Check that input file exists
     USTATUS result;
     UByteArray buffer;
@@ -84,6 +287,8 @@ int main(int argc, char *argv[])
     // Create model and ffsParser
     TreeModel model;
     FfsParser ffsParser(&model);
+    ffsParser.setThreadCount(std::thread::hardware_concurrency());
+    ffsParser.setCacheDirectory(parseCacheDirectory());
     // Parse input buffer
     result = ffsParser.parse(buffer);
     if (result)
@@ -91,61 +296,14 @@ int main(int argc, char *argv[])
     
     ffsParser.outputInfo();
     
-    // Create ffsDumper
-    FfsDumper ffsDumper(&model);
-    
-    // Dump only leaf elements, no report or GUID database
-    if (argc == 3 && !std::strcmp(argv[2], "dump")) {
-        return (ffsDumper.dump(model.index(0, 0), path + UString(".dump")) != U_SUCCESS);
-    }
-    // Dump named GUIDs found in the image, no dump or report
-    else if (argc == 3 && !std::strcmp(argv[2], "guids")) {
-        GuidDatabase db = guidDatabaseFromTreeRecursive(&model, model.index(0, 0));
-        if (!db.empty()) {
-            return guidDatabaseExportToFile(path + UString(".guids.csv"), db);
-        }
-    }
-    // Generate report, no dump or GUID database
-    else if (argc == 3 && !std::strcmp(argv[2], "report")) {
-        FfsReport ffsReport(&model);
-        std::vector<UString> report = ffsReport.generate();
-        if (report.size()) {
-            std::ofstream file;
-            file.open((path + UString(".report.txt")).toLocal8Bit());
-            for (size_t i = 0; i < report.size(); i++)
-                file << report[i].toLocal8Bit() << '\n';
-            return 0;
-        }
-        return 1;
-    }
-    // Either default or all mode
-    else if (argc == 2 || (argc == 3 && !std::strcmp(argv[2], "all"))) {
-        // Generate report
-        FfsReport ffsReport(&model);
-        std::vector<UString> report = ffsReport.generate();
-        if (report.size()) {
-            std::ofstream file;
-            file.open((path + UString(".report.txt")).toLocal8Bit());
-            for (size_t i = 0; i < report.size(); i++)
-                file << report[i].toLocal8Bit() << '\n';
-        }
-        
-        // Create GUID database
-        GuidDatabase db = guidDatabaseFromTreeRecursive(&model, model.index(0, 0));
-        if (!db.empty()) {
-            guidDatabaseExportToFile(path + UString(".guids.csv"), db);
-        }
-        
-        // Dump all non-leaf elements, with report and GUID database, default
-        if (argc == 2) {
-            return (ffsDumper.dump(model.index(0, 0), path + UString(".dump")) != U_SUCCESS);
-        }
-        else if (argc == 3 && !std::strcmp(argv[2], "all")) { // Dump every element with report and GUID database
-            return (ffsDumper.dump(model.index(0, 0), path + UString(".dump"), FfsDumper::DUMP_ALL) != U_SUCCESS);
-        }
+    // Standard modes
+    if (argc == 2 || (argc == 3 && isStandardMode(argv[2]))) {
+        return extractParsedImage(model, path, argc == 3 ? UString(argv[2]) : UString());
     }
     // Dump specific files, without report or GUID database
     else {
+        // Create ffsDumper
+        FfsDumper ffsDumper(&model);
         std::vector<UString> inputs, outputs;
         std::vector<FfsDumper::DumpMode> modes;
         std::vector<UINT8> sectionTypes;
@@ -201,7 +359,7 @@ int main(int argc, char *argv[])
             UString outPath = outputs.empty() ? path + UString(".dump") : outputs[i];
             FfsDumper::DumpMode mode = modes.empty() ? FfsDumper::DUMP_ALL : modes[i];
             UINT8 type = sectionTypes.empty() ? FfsDumper::IgnoreSectionType : sectionTypes[i];
-            result = ffsDumper.dump(model.index(0, 0), outPath, mode, type, inputs[i]);
+            result = ffsDumper.dump(model.childIndex(0), outPath, mode, type, inputs[i]);
             if (result) {
                 std::cout << "Guid " << inputs[i].toLocal8Bit() << " failed with " << result << " code!" << std::endl;
                 lastError = result;
@@ -210,8 +368,4 @@ int main(int argc, char *argv[])
         
         return lastError;
     }
-    
-    // If parameters are different, show version and usage information
-    print_usage();
-    return 1;
 }
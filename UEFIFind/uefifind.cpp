@@ -14,12 +14,20 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "uefifind.h"
 #include <fstream>
 #include <set>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
 
 
 UEFIFind::UEFIFind()
 {
     model = new TreeModel();
     ffsParser = new FfsParser(model);
+    ffsParser->setThreadCount(std::thread::hardware_concurrency());
+    const char* cacheDirectory = std::getenv("UEFITOOL_PARSE_CACHE");
+    if (cacheDirectory)
+        ffsParser->setCacheDirectory(UString(cacheDirectory));
     initDone = false;
 }
 
@@ -44,89 +52,290 @@ USTATUS UEFIFind::init(const UString & path)
     return U_SUCCESS;
 }
 
-USTATUS UEFIFind::findFileRecursive(const UModelIndex index, const UString & hexPattern, const UINT8 mode, std::set<std::pair<UModelIndex, UModelIndex> > & files)
-{
-    if (!index.isValid())
-        return U_SUCCESS;
-
-    if (hexPattern.isEmpty())
-        return U_INVALID_PARAMETER;
+// Pattern compiled for a multi-pattern search, it is located by its longest run of fully defined bytes,
+// and then checked as a whole at every place where that run is found
+typedef struct COMPILED_PATTERN_ {
+    size_t query = 0;
+    UINT8  mode = SEARCH_MODE_ALL;
+    std::vector<UINT8> pattern;
+    std::vector<UINT8> mask;
+    UINT32 anchorOffset = 0;
+    UINT32 anchorLength = 0; // Patterns without fully defined bytes are checked at every offset
+} COMPILED_PATTERN;
 
-    const char *hexPatternRaw = hexPattern.toLocal8Bit();
-    std::vector<UINT8> pattern, patternMask;
-    if (!makePattern(hexPatternRaw, pattern, patternMask))
-        return U_INVALID_PARAMETER;
+// Aho-Corasick automaton node, transitions of all nodes but the root are sparse
+typedef struct PATTERN_NODE_ {
+    std::vector<std::pair<UINT8, UINT32> > next;
+    UINT32 fail = 0;
+    UINT32 dictionary = 0; // Nearest node on the failure chain that ends some anchors, 0 if none
+    std::vector<UINT32> patterns;
+} PATTERN_NODE;
 
-    // Check for "all substrings" pattern
-    size_t count = 0;
-    for (size_t i = 0; i < patternMask.size(); i++)
-        if (patternMask[i] == 0)
-            count++;
-    if (count == patternMask.size())
-        return U_SUCCESS;
+struct UEFIFind::PatternSet {
+    std::vector<COMPILED_PATTERN> patterns;
+    std::vector<UINT32> bruteForce;
+    std::vector<PATTERN_NODE> nodes;
+    UINT32 root[256];
+    UINT32 maxLength;
+    
+    PatternSet() : nodes(1), maxLength(0) { memset(root, 0, sizeof(root)); }
+    
+    UINT32 child(UINT32 node, UINT8 c) const {
+        if (node == 0)
+            return root[c];
+        const std::vector<std::pair<UINT8, UINT32> > & next = nodes[node].next;
+        std::vector<std::pair<UINT8, UINT32> >::const_iterator it = std::lower_bound(next.begin(), next.end(), std::pair<UINT8, UINT32>(c, 0));
+        return (it != next.end() && it->first == c) ? it->second : 0;
+    }
+    
+    UINT32 step(UINT32 node, UINT8 c) const {
+        while (node != 0) {
+            UINT32 next = child(node, c);
+            if (next)
+                return next;
+            node = nodes[node].fail;
+        }
+        return root[c];
+    }
+    
+    void add(const COMPILED_PATTERN & compiled) {
+        UINT32 index = (UINT32)patterns.size();
+        patterns.push_back(compiled);
+        maxLength = std::max(maxLength, (UINT32)compiled.pattern.size());
+        if (compiled.anchorLength == 0) {
+            bruteForce.push_back(index);
+            return;
+        }
+        
+        UINT32 node = 0;
+        for (UINT32 i = 0; i < compiled.anchorLength; i++) {
+            UINT8 c = compiled.pattern[compiled.anchorOffset + i];
+            UINT32 next = child(node, c);
+            if (next == 0) {
+                next = (UINT32)nodes.size();
+                nodes.push_back(PATTERN_NODE());
+                if (node == 0) {
+                    root[c] = next;
+                }
+                else {
+                    std::vector<std::pair<UINT8, UINT32> > & edges = nodes[node].next;
+                    edges.insert(std::lower_bound(edges.begin(), edges.end(), std::pair<UINT8, UINT32>(c, 0)), std::pair<UINT8, UINT32>(c, next));
+                }
+            }
+            node = next;
+        }
+        nodes[node].patterns.push_back(index);
+    }
+    
+    // Build failure and dictionary links in breadth-first order
+    void build() {
+        std::vector<UINT32> queue;
+        for (UINT32 c = 0; c < 256; c++) {
+            if (root[c])
+                queue.push_back(root[c]);
+        }
+        for (size_t head = 0; head < queue.size(); head++) {
+            UINT32 node = queue[head];
+            for (size_t i = 0; i < nodes[node].next.size(); i++) {
+                UINT8 c = nodes[node].next[i].first;
+                UINT32 next = nodes[node].next[i].second;
+                UINT32 fail = step(nodes[node].fail, c);
+                nodes[next].fail = fail;
+                nodes[next].dictionary = nodes[fail].patterns.empty() ? nodes[fail].dictionary : fail;
+                queue.push_back(next);
+            }
+        }
+    }
+};
 
-    bool hasChildren = (model->rowCount(index) > 0);
-    for (int i = 0; i < model->rowCount(index); i++) {
-        findFileRecursive(index.model()->index(i, index.column(), index), hexPattern, mode, files);
+USTATUS UEFIFind::findAll(std::vector<UEFIFIND_QUERY> & queries)
+{
+    // Compile patterns
+    PatternSet patterns;
+    for (size_t i = 0; i < queries.size(); i++) {
+        UEFIFIND_QUERY & query = queries[i];
+        query.status = U_SUCCESS;
+        query.result.clear();
+        
+        if (query.hexPattern.isEmpty()) {
+            query.status = U_INVALID_PARAMETER;
+            continue;
+        }
+        
+        COMPILED_PATTERN compiled;
+        if (!makePattern(query.hexPattern.toLocal8Bit(), compiled.pattern, compiled.mask)) {
+            query.status = U_INVALID_PARAMETER;
+            continue;
+        }
+        
+        // Choose the longest run of fully defined bytes as an anchor
+        bool allWildcards = true;
+        UINT32 runOffset = 0;
+        for (UINT32 j = 0; j <= (UINT32)compiled.mask.size(); j++) {
+            if (j < (UINT32)compiled.mask.size() && compiled.mask[j] != 0)
+                allWildcards = false;
+            if (j < (UINT32)compiled.mask.size() && compiled.mask[j] == 0xFF)
+                continue;
+            if (j - runOffset > compiled.anchorLength) {
+                compiled.anchorOffset = runOffset;
+                compiled.anchorLength = j - runOffset;
+            }
+            runOffset = j + 1;
+        }
+        
+        // "All substrings" pattern finds nothing
+        if (allWildcards)
+            continue;
+        
+        compiled.query = i;
+        compiled.mode = query.mode;
+        patterns.add(compiled);
     }
+    patterns.build();
+    
+    // Scan the tree once for all patterns
+    std::vector<std::set<std::pair<UModelIndex, UModelIndex> > > files(patterns.patterns.size());
+    if (!patterns.patterns.empty()) {
+        std::vector<UINT32> found(patterns.patterns.size(), 0);
+        UINT32 stamp = 0;
+        findFileRecursive(model->childIndex(0), patterns, files, found, stamp);
+    }
+    
+    for (size_t i = 0; i < patterns.patterns.size(); i++) {
+        UEFIFIND_QUERY & query = queries[patterns.patterns[i].query];
+        query.result = formatFoundItems(files[i], query.count);
+    }
+    
+    return U_SUCCESS;
+}
 
+void UEFIFind::findFileRecursive(const UModelIndex index, const PatternSet & patterns, std::vector<std::set<std::pair<UModelIndex, UModelIndex> > > & files, std::vector<UINT32> & found, UINT32 & stamp)
+{
+    if (!index.isValid())
+        return;
+    
+    bool hasChildren = (model->childCount(index) > 0);
+    for (int i = 0; i < model->childCount(index); i++) {
+        findFileRecursive(model->childIndex(i, index), patterns, files, found, stamp);
+    }
+    
+    // Search header and body as a single stream without concatenating them
+    // Items with children only have matches that start in the header, the rest of their body is searched in children
     // TODO: handle a case where an item has both compressed and uncompressed bodies
-    UByteArray data;
-    if (hasChildren) {
-        if (mode == SEARCH_MODE_HEADER)
-            data = model->header(index);
-        else if (mode == SEARCH_MODE_ALL)
-            data = model->header(index) + model->body(index);
+    UByteArray header = model->header(index);
+    UByteArray body;
+    UINT8 fill;
+    if (model->hasFillBody(index, fill)) {
+        // A pattern found anywhere in a body of a single repeated byte is also found at its start,
+        // so only the part that can hold a match crossing from the header and one more match is needed
+        body = UByteArray((int)std::min<UINT32>(model->bodySize(index), 2 * patterns.maxLength), (char)fill);
     }
     else {
-        if (mode == SEARCH_MODE_HEADER)
-            data = model->header(index);
-        else if (mode == SEARCH_MODE_BODY)
-            data = model->body(index);
-        else
-            data = model->header(index) + model->body(index);
+        body = model->body(index);
     }
-
-    const UINT8 *rawData = reinterpret_cast<const UINT8 *>(data.constData());
-    INTN offset = findPattern(pattern.data(), patternMask.data(), pattern.size(), rawData, data.size(), 0);
-
-    // For patterns that cross header|body boundary, skip patterns entirely located in body, since
-    // children search above has already found them.
-    if (hasChildren && mode == SEARCH_MODE_ALL && offset >= model->header(index).size()) {
-        offset = -1;
-    }
-
-    if (offset >= 0) {
-        if (model->type(index) != Types::File) {
-            UModelIndex parentFile = model->findParentOfType(index, Types::File);
-            if (model->type(index) == Types::Section && model->subtype(index) == EFI_SECTION_FREEFORM_SUBTYPE_GUID)
-                files.insert(std::pair<UModelIndex, UModelIndex>(parentFile, index));
-            else
-                files.insert(std::pair<UModelIndex, UModelIndex>(parentFile, UModelIndex()));
+    const UINT8 *headerData = (const UINT8*)header.constData();
+    const UINT8 *bodyData = (const UINT8*)body.constData();
+    UINT32 headerSize = (UINT32)header.size();
+    UINT32 totalSize = headerSize + (UINT32)body.size();
+    UINT32 scanSize = totalSize;
+    if (hasChildren && headerSize + patterns.maxLength - 1 < totalSize)
+        scanSize = headerSize + patterns.maxLength - 1;
+    if (scanSize == 0)
+        return;
+    
+    stamp++;
+    bool anyFound = false;
+    auto byteAt = [&](UINT32 offset) -> UINT8 { return offset < headerSize ? headerData[offset] : bodyData[offset - headerSize]; };
+    auto check = [&](UINT32 patternIndex, UINT32 start) {
+        const COMPILED_PATTERN & compiled = patterns.patterns[patternIndex];
+        UINT32 length = (UINT32)compiled.pattern.size();
+        if (found[patternIndex] == stamp || start + length > totalSize)
+            return;
+        
+        // Check that the match is in the searched part of the item
+        if (compiled.mode == SEARCH_MODE_HEADER && start + length > headerSize)
+            return;
+        if (compiled.mode == SEARCH_MODE_BODY && (hasChildren || start < headerSize))
+            return;
+        if (compiled.mode == SEARCH_MODE_ALL && hasChildren && start >= headerSize)
+            return;
+        
+        for (UINT32 i = 0; i < length; i++) {
+            if ((byteAt(start + i) & compiled.mask[i]) != compiled.pattern[i])
+                return;
         }
-        else {
-            files.insert(std::pair<UModelIndex, UModelIndex>(index, UModelIndex()));
+        found[patternIndex] = stamp;
+        anyFound = true;
+    };
+    
+    UINT32 node = 0;
+    for (UINT32 offset = 0; offset < scanSize; offset++) {
+        node = patterns.step(node, byteAt(offset));
+        for (UINT32 current = patterns.nodes[node].patterns.empty() ? patterns.nodes[node].dictionary : node; current != 0; current = patterns.nodes[current].dictionary) {
+            const std::vector<UINT32> & ends = patterns.nodes[current].patterns;
+            for (size_t i = 0; i < ends.size(); i++) {
+                const COMPILED_PATTERN & compiled = patterns.patterns[ends[i]];
+                if (offset + 1 >= compiled.anchorOffset + compiled.anchorLength)
+                    check(ends[i], offset + 1 - compiled.anchorOffset - compiled.anchorLength);
+            }
         }
     }
+    
+    for (size_t i = 0; i < patterns.bruteForce.size(); i++) {
+        for (UINT32 start = 0; start < scanSize && found[patterns.bruteForce[i]] != stamp; start++)
+            check(patterns.bruteForce[i], start);
+    }
+    
+    if (!anyFound)
+        return;
+    
+    for (size_t i = 0; i < patterns.patterns.size(); i++) {
+        if (found[i] == stamp)
+            addFoundItem(index, files[i]);
+    }
+}
 
-    return U_SUCCESS;
+void UEFIFind::addFoundItem(const UModelIndex index, std::set<std::pair<UModelIndex, UModelIndex> > & files)
+{
+    if (model->type(index) != Types::File) {
+        UModelIndex parentFile = model->findParentOfType(index, Types::File);
+        if (model->type(index) == Types::Section && model->subtype(index) == EFI_SECTION_FREEFORM_SUBTYPE_GUID)
+            files.insert(std::pair<UModelIndex, UModelIndex>(parentFile, index));
+        else
+            files.insert(std::pair<UModelIndex, UModelIndex>(parentFile, UModelIndex()));
+    }
+    else {
+        files.insert(std::pair<UModelIndex, UModelIndex>(index, UModelIndex()));
+    }
 }
 
 USTATUS UEFIFind::find(const UINT8 mode, const bool count, const UString & hexPattern, UString & result)
 {
-    UModelIndex root = model->index(0, 0);
-    std::set<std::pair<UModelIndex, UModelIndex> > files;
-
+    std::vector<UEFIFIND_QUERY> queries(1);
+    queries[0].mode = mode;
+    queries[0].count = count;
+    queries[0].hexPattern = hexPattern;
+    
     result.clear();
-
-    USTATUS returned = findFileRecursive(root, hexPattern, mode, files);
+    
+    USTATUS returned = findAll(queries);
     if (returned)
         return returned;
+    if (queries[0].status)
+        return queries[0].status;
+    
+    result = queries[0].result;
+    return U_SUCCESS;
+}
+
+UString UEFIFind::formatFoundItems(const std::set<std::pair<UModelIndex, UModelIndex> > & files, const bool count)
+{
+    UString result;
     
     if (count) {
         if (!files.empty())
             result += usprintf("%lu\n", files.size());
-        return U_SUCCESS;
+        return result;
     }
 
     for (std::set<std::pair<UModelIndex, UModelIndex> >::const_iterator citer = files.begin(); citer != files.end(); ++citer) {
@@ -144,5 +353,5 @@ USTATUS UEFIFind::find(const UINT8 mode, const bool count, const UString & hexPa
         
         result += UString("\n");
     }
-    return U_SUCCESS;
+    return result;
 }
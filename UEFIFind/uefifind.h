@@ -16,6 +16,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 #include <iterator>
 #include <set>
+#include <vector>
 
 #include "../common/basetypes.h"
 #include "../common/ustring.h"
@@ -24,6 +25,15 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "../common/ffs.h"
 #include "../common/utility.h"
 
+// Single search of a multi-pattern run, status and result are the same as find() would return for it
+typedef struct UEFIFIND_QUERY_ {
+    UINT8   mode = SEARCH_MODE_ALL;
+    bool    count = false;
+    UString hexPattern;
+    USTATUS status = U_SUCCESS;
+    UString result;
+} UEFIFIND_QUERY;
+
 class UEFIFind
 {
 public:
@@ -32,9 +42,14 @@ public:
 
     USTATUS init(const UString & path);
     USTATUS find(const UINT8 mode, const bool count, const UString & hexPattern, UString & result);
+    // Run all queries with a single pass over the tree
+    USTATUS findAll(std::vector<UEFIFIND_QUERY> & queries);
 
 private:
-    USTATUS findFileRecursive(const UModelIndex index, const UString & hexPattern, const UINT8 mode, std::set<std::pair<UModelIndex, UModelIndex> > & files);
+    struct PatternSet;
+    void findFileRecursive(const UModelIndex index, const PatternSet & patterns, std::vector<std::set<std::pair<UModelIndex, UModelIndex> > > & files, std::vector<UINT32> & found, UINT32 & stamp);
+    void addFoundItem(const UModelIndex index, std::set<std::pair<UModelIndex, UModelIndex> > & files);
+    UString formatFoundItems(const std::set<std::pair<UModelIndex, UModelIndex> > & files, const bool count);
 
     FfsParser* ffsParser;
     TreeModel* model;
@@ -114,8 +114,11 @@ int main(int argc, char *argv[])
         if (result)
             return result;
 
-        // Perform searches
-        bool somethingFound = false;
+        // Read all searches, lines that are skipped get their message right away
+        std::vector<std::string> lines;
+        std::vector<UString> skipped;
+        std::vector<UEFIFIND_QUERY> queries;
+        std::vector<size_t> lineQueries;
         while (!patternsFile.eof()) {
             std::string line;
             std::getline(patternsFile, line);
@@ -123,6 +126,10 @@ int main(int argc, char *argv[])
             if (line.size() == 0 || line[0] == '#')
                 continue;
 
+            lines.push_back(line);
+            skipped.push_back(UString());
+            lineQueries.push_back(queries.size());
+
             // Split the read line
             std::vector<UString> list;
             std::string::size_type prev = 0, curr = 0;
@@ -134,48 +141,63 @@ int main(int argc, char *argv[])
             list.push_back(UString(line.substr(prev, curr-prev).c_str()));
 
             if (list.size() < 3) {
-                std::cout << line << std::endl << "skipped, too few arguments" << std::endl << std::endl;
+                skipped.back() = UString("skipped, too few arguments");
                 continue;
             }
             // Get search mode
-            UINT8 mode;
+            UEFIFIND_QUERY query;
             if (list.at(0) == UString("header"))
-                mode = SEARCH_MODE_HEADER;
+                query.mode = SEARCH_MODE_HEADER;
             else if (list.at(0) == UString("body"))
-                mode = SEARCH_MODE_BODY;
+                query.mode = SEARCH_MODE_BODY;
             else if (list.at(0) == UString("all"))
-                mode = SEARCH_MODE_ALL;
+                query.mode = SEARCH_MODE_ALL;
             else {
-                std::cout << line << std::endl << "skipped, invalid search mode" << std::endl << std::endl;
+                skipped.back() = UString("skipped, invalid search mode");
                 continue;
             }
 
             // Get result type
-            bool count;
             if (list.at(1) == UString("list"))
-                count = false;
+                query.count = false;
             else if (list.at(1) == UString("count"))
-                count = true;
+                query.count = true;
             else {
-                std::cout << line << std::endl << "skipped, invalid result type" << std::endl << std::endl;
+                skipped.back() = UString("skipped, invalid result type");
+                continue;
+            }
+
+            query.hexPattern = list.at(2);
+            queries.push_back(query);
+        }
+
+        // Go find all supplied patterns at once
+        result = w.findAll(queries);
+        if (result)
+            return result;
+
+        // Print results in the order of the patterns file
+        bool somethingFound = false;
+        for (size_t i = 0; i < lines.size(); i++) {
+            const std::string & line = lines[i];
+            if (!skipped[i].isEmpty()) {
+                std::cout << line << std::endl << skipped[i].toLocal8Bit() << std::endl << std::endl;
                 continue;
             }
 
-            // Go find the supplied pattern
-            UString found;
-            result = w.find(mode, count, list.at(2), found);
-            if (result) {
-                std::cout << line << std::endl << "skipped, find failed with error " << (UINT32)result << std::endl << std::endl;
+            const UEFIFIND_QUERY & query = queries[lineQueries[i]];
+            if (query.status) {
+                std::cout << line << std::endl << "skipped, find failed with error " << (UINT32)query.status << std::endl << std::endl;
                 continue;
             }
 
-            if (found.isEmpty()) {
+            if (query.result.isEmpty()) {
                 // Nothing is found
                 std::cout << line << std::endl << "nothing found" << std::endl << std::endl;
             }
             else {
                 // Print result
-                std::cout << line << std::endl << found.toLocal8Bit() << std::endl;
+                std::cout << line << std::endl << query.result.toLocal8Bit() << std::endl;
                 somethingFound = true;
             }
         }
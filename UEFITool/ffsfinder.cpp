@@ -13,263 +13,255 @@
 
 #include "ffsfinder.h"
 
-#if QT_VERSION_MAJOR >= 6
-#include <QRegularExpression>
-#else
-#include <QRegExp>
-#endif
+// Find text in data, returns offset of the first match starting at or after dataOff
+static INTN findText(const FFS_FINDER_TEXT & text, const UINT8 *data, UINTN dataSize, UINTN dataOff)
+{
+    const UINTN count = text.chars.size();
+    const UINTN charSize = text.unicode ? 2 : 1;
+    if (count == 0 || dataSize < count * charSize)
+        return -1;
+    
+    const UINTN lastOff = dataSize - count * charSize;
+    for (UINTN offset = dataOff; offset <= lastOff; offset++) {
+        UINTN i = 0;
+        if (text.unicode) {
+            for (; i < count; i++) {
+                UINT32 c = data[offset + i * 2] | ((UINT32)data[offset + i * 2 + 1] << 8);
+                if (text.caseInsensitive)
+                    c = (UINT32)QChar::toCaseFolded(c);
+                if (c != text.chars[i])
+                    break;
+            }
+        }
+        else {
+            for (; i < count; i++) {
+                if (text.byteChars[data[offset + i]] != text.chars[i])
+                    break;
+            }
+        }
+        
+        if (i == count)
+            return (INTN)offset;
+    }
+    
+    return -1;
+}
+
+UString FfsFinder::itemName(const UModelIndex & index) const
+{
+    UModelIndex parentFileIndex = model->findParentOfType(index, Types::File);
+    UString name = model->name(index);
+    if (model->parent(index) == parentFileIndex) {
+        name = model->name(parentFileIndex) + UString("/") + name;
+    }
+    else if (parentFileIndex.isValid()) {
+        name = model->name(parentFileIndex) + UString("/.../") + name;
+    }
+    return name;
+}
+
+void FfsFinder::getSearchAreas(const UModelIndex & index, const UINT8 mode, const bool spanBody, const UINT32 maxMatchSize, std::vector<FFS_FINDER_AREA> & areas) const
+{
+    // Bodies of items with children are searched by their children, so only matches that start in the header
+    // are searched here, and only if they can cross into the body
+    bool hasChildren = (model->childCount(index) > 0);
+    areas.clear();
+    
+    if (mode != SEARCH_MODE_BODY) {
+        FFS_FINDER_AREA area;
+        area.data = model->header(index);
+        area.searchSize = (UINT32)area.data.size();
+        area.offset = 0;
+        if (mode == SEARCH_MODE_ALL && (spanBody || !hasChildren) && maxMatchSize > 1)
+            area.data.append(model->body(index).left(maxMatchSize - 1));
+        if (area.searchSize > 0)
+            areas.push_back(area);
+    }
+    
+    if (mode != SEARCH_MODE_HEADER && !hasChildren) {
+        FFS_FINDER_AREA area;
+        area.data = model->body(index);
+        area.searchSize = (UINT32)area.data.size();
+        area.offset = (mode == SEARCH_MODE_ALL) ? (UINT32)model->header(index).size() : 0;
+        if (area.searchSize > 0)
+            areas.push_back(area);
+    }
+}
 
 USTATUS FfsFinder::findHexPattern(const UByteArray & hexPattern, const UINT8 mode) {
-    const UModelIndex rootIndex = model->index(0, 0);
-    USTATUS ret = findHexPattern(rootIndex, hexPattern, mode);
+    const UModelIndex rootIndex = model->childIndex(0);
+    BytePattern pattern;
+    USTATUS ret;
+    if (hexPattern.isEmpty() || !pattern.compile(hexPattern.constData()))
+        ret = U_INVALID_PARAMETER;
+    else if (pattern.matchesAnything()) // Check for "all substrings" pattern
+        ret = U_SUCCESS;
+    else
+        ret = findHexPattern(rootIndex, hexPattern, pattern, mode);
     if (ret != U_SUCCESS)
         msg(UString("Hex pattern \"") + UString(hexPattern) + UString("\" could not be found"), rootIndex);
     return ret;
 }
 
-USTATUS FfsFinder::findHexPattern(const UModelIndex & index, const UByteArray & hexPattern, const UINT8 mode)
+USTATUS FfsFinder::findHexPattern(const UModelIndex & index, const UByteArray & hexPattern, const BytePattern & pattern, const UINT8 mode)
 {
     if (!index.isValid())
         return U_SUCCESS;
     
-    if (hexPattern.isEmpty())
-        return U_INVALID_PARAMETER;
-    
-    // Check for "all substrings" pattern
-    if (hexPattern.count('.') == hexPattern.length())
-        return U_SUCCESS;
-    
     USTATUS ret = U_ITEM_NOT_FOUND;
-    bool hasChildren = (model->rowCount(index) > 0);
-    for (int i = 0; i < model->rowCount(index); i++) {
-        if (U_SUCCESS == findHexPattern(index.model()->index(i, index.column(), index), hexPattern, mode))
+    for (int i = 0; i < model->childCount(index); i++) {
+        if (U_SUCCESS == findHexPattern(model->childIndex(i, index), hexPattern, pattern, mode))
             ret = U_SUCCESS;
     }
     
-    UByteArray data;
-    if (hasChildren) {
-        if (mode == SEARCH_MODE_HEADER)
-            data = model->header(index);
-        else if (mode == SEARCH_MODE_ALL)
-            data = model->header(index) + model->body(index);
-    }
-    else {
-        if (mode == SEARCH_MODE_HEADER)
-            data = model->header(index);
-        else if (mode == SEARCH_MODE_BODY)
-            data = model->body(index);
-        else
-            data = model->header(index) + model->body(index);
-    }
-    
-    UString hexBody = UString(data.toHex());
-#if QT_VERSION_MAJOR >= 6
-    QRegularExpression regexp = QRegularExpression(UString(hexPattern));
-    regexp.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch regexpmatch;
+    // For patterns that cross header|body boundary, bodies of items with children are not searched, since
+    // children search above has already found patterns entirely located in them
+    std::vector<FFS_FINDER_AREA> areas;
+    getSearchAreas(index, mode, true, (UINT32)pattern.maxSize(), areas);
     
-    INT32 offset = (INT32)hexBody.indexOf(regexp, 0, &regexpmatch);
-#else
-    QRegExp regexp = QRegExp(UString(hexPattern), Qt::CaseInsensitive);
-
-    INT32 offset = regexp.indexIn(hexBody);
-#endif
-    while (offset >= 0) {
-        if (offset % 2 == 0) {
-            // For patterns that cross header|body boundary, skip patterns entirely located in body, since
-            // children search above has already found them.
-            if (!(hasChildren && mode == SEARCH_MODE_ALL && offset/2 >= model->header(index).size())) {
-                UModelIndex parentFileIndex = model->findParentOfType(index, Types::File);
-                UString name = model->name(index);
-                if (model->parent(index) == parentFileIndex) {
-                    name = model->name(parentFileIndex) + UString("/") + name;
-                }
-                else if (parentFileIndex.isValid()) {
-                    name = model->name(parentFileIndex) + UString("/.../") + name;
-                }
-
-                msg(UString("Hex pattern \"") + UString(hexPattern)
-                    + UString("\" found as \"") + hexBody.mid(offset, hexPattern.length()).toUpper()
-                    + UString("\" in ") + name
-                    + usprintf(" at %s-offset %02Xh", mode == SEARCH_MODE_BODY ? "body" : "header", offset / 2),
-                    index);
-                ret = U_SUCCESS;
-            }
+    UString name;
+    for (size_t i = 0; i < areas.size(); i++) {
+        const UINT8* data = (const UINT8*)areas[i].data.constData();
+        UINTN matchSize;
+        INTN offset = -1;
+        while ((offset = pattern.find(data, areas[i].data.size(), offset + 1, matchSize)) >= 0
+               && (UINTN)offset < areas[i].searchSize) {
+            if (name.isEmpty())
+                name = itemName(index);
+            
+            msg(UString("Hex pattern \"") + UString(hexPattern)
+                + UString("\" found as \"") + UString(areas[i].data.mid((int)offset, (int)matchSize).toHex()).toUpper()
+                + UString("\" in ") + name
+                + usprintf(" at %s-offset %02Xh", mode == SEARCH_MODE_BODY ? "body" : "header", areas[i].offset + (UINT32)offset),
+                index);
+            ret = U_SUCCESS;
         }
-
-#if QT_VERSION_MAJOR >= 6
-        offset = (INT32)hexBody.indexOf(regexp, (qsizetype)offset + 1, &regexpmatch);
-#else
-        offset = regexp.indexIn(hexBody, offset + 1);
-#endif
     }
-
+    
     return ret;
 }
 
 USTATUS FfsFinder::findGuidPattern(const UByteArray & guidPattern, const UINT8 mode) {
-    const UModelIndex rootIndex = model->index(0, 0);
-    USTATUS ret = findGuidPattern(rootIndex, guidPattern, mode);
+    const UModelIndex rootIndex = model->childIndex(0);
+    USTATUS ret = U_INVALID_PARAMETER;
+    QList<UByteArray> list = guidPattern.split('-');
+    if (list.count() == 5) {
+        UByteArray hexPattern;
+        // Reverse first GUID block
+        hexPattern.append(list.at(0).mid(6, 2));
+        hexPattern.append(list.at(0).mid(4, 2));
+        hexPattern.append(list.at(0).mid(2, 2));
+        hexPattern.append(list.at(0).mid(0, 2));
+        // Reverse second GUID block
+        hexPattern.append(list.at(1).mid(2, 2));
+        hexPattern.append(list.at(1).mid(0, 2));
+        // Reverse third GUID block
+        hexPattern.append(list.at(2).mid(2, 2));
+        hexPattern.append(list.at(2).mid(0, 2));
+        // Append fourth and fifth GUID blocks as is
+        hexPattern.append(list.at(3)).append(list.at(4));
+        
+        BytePattern pattern;
+        if (pattern.compile(hexPattern.constData())) {
+            // Check for "all substrings" pattern
+            if (pattern.matchesAnything())
+                ret = U_SUCCESS;
+            else
+                ret = findGuidPattern(rootIndex, guidPattern, pattern, mode);
+        }
+    }
     if (ret != U_SUCCESS)
         msg(UString("GUID pattern \"") + UString(guidPattern) + UString("\" could not be found"), rootIndex);
     return ret;
 }
 
-USTATUS FfsFinder::findGuidPattern(const UModelIndex & index, const UByteArray & guidPattern, const UINT8 mode)
+USTATUS FfsFinder::findGuidPattern(const UModelIndex & index, const UByteArray & guidPattern, const BytePattern & pattern, const UINT8 mode)
 {
-    if (guidPattern.isEmpty())
-        return U_INVALID_PARAMETER;
-
     if (!index.isValid())
         return U_SUCCESS;
 
     USTATUS ret = U_ITEM_NOT_FOUND;
-    bool hasChildren = (model->rowCount(index) > 0);
-    for (int i = 0; i < model->rowCount(index); i++) {
-        if (U_SUCCESS == findGuidPattern(index.model()->index(i, index.column(), index), guidPattern, mode))
+    for (int i = 0; i < model->childCount(index); i++) {
+        if (U_SUCCESS == findGuidPattern(model->childIndex(i, index), guidPattern, pattern, mode))
             ret = U_SUCCESS;
     }
 
-    UByteArray data;
-    if (hasChildren) {
-        if (mode != SEARCH_MODE_BODY)
-            data = model->header(index);
-    }
-    else {
-        if (mode == SEARCH_MODE_HEADER)
-            data.append(model->header(index));
-        else if (mode == SEARCH_MODE_BODY)
-            data.append(model->body(index));
-        else
-            data.append(model->header(index)).append(model->body(index));
-    }
+    std::vector<FFS_FINDER_AREA> areas;
+    getSearchAreas(index, mode, false, (UINT32)pattern.maxSize(), areas);
 
-    UString hexBody = UString(data.toHex());
-    QList<UByteArray> list = guidPattern.split('-');
-    if (list.count() != 5)
-        return U_INVALID_PARAMETER;
-
-    UByteArray hexPattern;
-    // Reverse first GUID block
-    hexPattern.append(list.at(0).mid(6, 2));
-    hexPattern.append(list.at(0).mid(4, 2));
-    hexPattern.append(list.at(0).mid(2, 2));
-    hexPattern.append(list.at(0).mid(0, 2));
-    // Reverse second GUID block
-    hexPattern.append(list.at(1).mid(2, 2));
-    hexPattern.append(list.at(1).mid(0, 2));
-    // Reverse third GUID block
-    hexPattern.append(list.at(2).mid(2, 2));
-    hexPattern.append(list.at(2).mid(0, 2));
-    // Append fourth and fifth GUID blocks as is
-    hexPattern.append(list.at(3)).append(list.at(4));
-
-    // Check for "all substrings" pattern
-    if (hexPattern.count('.') == hexPattern.length())
-        return U_SUCCESS;
-
-#if QT_VERSION_MAJOR >= 6
-    QRegularExpression regexp((QString)UString(hexPattern));
-    regexp.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
-    QRegularExpressionMatch regexpmatch;
-
-    INT32 offset = (INT32)hexBody.indexOf(regexp, 0, &regexpmatch);
-#else
-    QRegExp regexp(UString(hexPattern), Qt::CaseInsensitive);
-
-    INT32 offset = regexp.indexIn(hexBody);
-#endif
-    while (offset >= 0) {
-        if (offset % 2 == 0) {
-            UModelIndex parentFileIndex = model->findParentOfType(index, Types::File);
-            UString name = model->name(index);
-            if (model->parent(index) == parentFileIndex) {
-                name = model->name(parentFileIndex) + UString("/") + name;
-            }
-            else if (parentFileIndex.isValid()) {
-                name = model->name(parentFileIndex) + UString("/.../") + name;
-            }
+    UString name;
+    for (size_t i = 0; i < areas.size(); i++) {
+        const UINT8* data = (const UINT8*)areas[i].data.constData();
+        UINTN matchSize;
+        INTN offset = -1;
+        while ((offset = pattern.find(data, areas[i].data.size(), offset + 1, matchSize)) >= 0
+               && (UINTN)offset < areas[i].searchSize) {
+            if (name.isEmpty())
+                name = itemName(index);
 
             msg(UString("GUID pattern \"") + UString(guidPattern)
-                + UString("\" found as \"") + hexBody.mid(offset, hexPattern.length()).toUpper()
+                + UString("\" found as \"") + UString(areas[i].data.mid((int)offset, (int)matchSize).toHex()).toUpper()
                 + UString("\" in ") + name
-                + usprintf(" at %s-offset %02Xh", mode == SEARCH_MODE_BODY ? "body" : "header", offset / 2),
+                + usprintf(" at %s-offset %02Xh", mode == SEARCH_MODE_BODY ? "body" : "header", areas[i].offset + (UINT32)offset),
                 index);
             ret = U_SUCCESS;
         }
-
-#if QT_VERSION_MAJOR >= 6
-        offset = (INT32)hexBody.indexOf(regexp, (qsizetype)offset + 1, &regexpmatch);
-#else
-        offset = regexp.indexIn(hexBody, offset + 1);
-#endif
     }
 
     return ret;
 }
 
 USTATUS FfsFinder::findTextPattern(const UString & pattern, const UINT8 mode, const bool unicode, const Qt::CaseSensitivity caseSensitive) {
-    const UModelIndex rootIndex = model->index(0, 0);
-    USTATUS ret = findTextPattern(rootIndex, pattern, mode, unicode, caseSensitive);
+    const UModelIndex rootIndex = model->childIndex(0);
+    USTATUS ret = U_INVALID_PARAMETER;
+    if (!pattern.isEmpty()) {
+        // Both pattern and data characters are case folded once here, and never widened to strings
+        FFS_FINDER_TEXT text;
+        text.unicode = unicode;
+        text.caseInsensitive = (caseSensitive == Qt::CaseInsensitive);
+        for (UINT32 i = 0; i < 256; i++)
+            text.byteChars[i] = text.caseInsensitive ? (UINT32)QChar::toCaseFolded(i) : i;
+        for (int i = 0; i < pattern.length(); i++) {
+            UINT32 c = pattern.at(i).unicode();
+            text.chars.push_back(text.caseInsensitive ? (UINT32)QChar::toCaseFolded(c) : c);
+        }
+        ret = findTextPattern(rootIndex, pattern, text, mode);
+    }
     if (ret != U_SUCCESS)
         msg((unicode ? UString("Unicode") : UString("ASCII")) + UString(" text \"")
             + UString(pattern) + UString("\" could not be found"), rootIndex);
     return ret;
 }
 
-USTATUS FfsFinder::findTextPattern(const UModelIndex & index, const UString & pattern, const UINT8 mode, const bool unicode, const Qt::CaseSensitivity caseSensitive)
+USTATUS FfsFinder::findTextPattern(const UModelIndex & index, const UString & pattern, const FFS_FINDER_TEXT & text, const UINT8 mode)
 {
-    if (pattern.isEmpty())
-        return U_INVALID_PARAMETER;
-
     if (!index.isValid())
         return U_SUCCESS;
 
     USTATUS ret = U_ITEM_NOT_FOUND;
-    bool hasChildren = (model->rowCount(index) > 0);
-    for (int i = 0; i < model->rowCount(index); i++) {
-        if (U_SUCCESS == findTextPattern(index.model()->index(i, index.column(), index), pattern, mode, unicode, caseSensitive))
+    for (int i = 0; i < model->childCount(index); i++) {
+        if (U_SUCCESS == findTextPattern(model->childIndex(i, index), pattern, text, mode))
             ret = U_SUCCESS;
     }
 
-    UByteArray body;
-    if (hasChildren) {
-        if (mode != SEARCH_MODE_BODY)
-            body = model->header(index);
-    }
-    else {
-        if (mode == SEARCH_MODE_HEADER)
-            body.append(model->header(index));
-        else if (mode == SEARCH_MODE_BODY)
-            body.append(model->body(index));
-        else
-            body.append(model->header(index)).append(model->body(index));
-    }
-
-    UString data = UString::fromLatin1((const char*)body.constData(), body.length());
-
-    UString searchPattern;
-    if (unicode)
-        searchPattern = UString::fromLatin1((const char*)pattern.utf16(), pattern.length() * 2);
-    else
-        searchPattern = pattern;
-
-    int offset = -1;
-    while ((offset = (int)data.indexOf(searchPattern, (int)(offset + 1), caseSensitive)) >= 0) {
-        UModelIndex parentFileIndex = model->findParentOfType(index, Types::File);
-        UString name = model->name(index);
-        if (model->parent(index) == parentFileIndex) {
-            name = model->name(parentFileIndex) + UString("/") + name;
-        }
-        else if (parentFileIndex.isValid()) {
-            name = model->name(parentFileIndex) + UString("/.../") + name;
+    std::vector<FFS_FINDER_AREA> areas;
+    getSearchAreas(index, mode, false, (UINT32)(text.chars.size() * (text.unicode ? 2 : 1)), areas);
+
+    UString name;
+    for (size_t i = 0; i < areas.size(); i++) {
+        const UINT8* data = (const UINT8*)areas[i].data.constData();
+        INTN offset = -1;
+        while ((offset = findText(text, data, areas[i].data.size(), offset + 1)) >= 0
+               && (UINTN)offset < areas[i].searchSize) {
+            if (name.isEmpty())
+                name = itemName(index);
+
+            msg((text.unicode ? UString("Unicode") : UString("ASCII")) + UString(" text \"") + UString(pattern)
+                + UString("\" found in ") + name
+                + usprintf(" at %s-offset %02Xh", mode == SEARCH_MODE_BODY ? "body" : "header", areas[i].offset + (UINT32)offset),
+                index);
+            ret = U_SUCCESS;
         }
-
-        msg((unicode ? UString("Unicode") : UString("ASCII")) + UString(" text \"") + UString(pattern)
-            + UString("\" found in ") + name
-            + usprintf(" at %s-offset %02Xh", mode == SEARCH_MODE_BODY ? "body" : "header", offset),
-            index);
-        ret = U_SUCCESS;
     }
 
     return ret;
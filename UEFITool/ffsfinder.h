@@ -20,6 +20,22 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "../common/ustring.h"
 #include "../common/basetypes.h"
 #include "../common/treemodel.h"
+#include "../common/utility.h"
+
+// Part of item data to search in, only matches starting in its first searchSize bytes are reported
+typedef struct FFS_FINDER_AREA_ {
+    UByteArray data;
+    UINT32     searchSize;
+    UINT32     offset; // Reported offset of the area start
+} FFS_FINDER_AREA;
+
+// Text pattern with case folded characters, matched against data bytes as Latin-1 characters or against UCS-2 code units
+typedef struct FFS_FINDER_TEXT_ {
+    std::vector<UINT32> chars;
+    bool               unicode;
+    bool               caseInsensitive;
+    UINT32             byteChars[256];
+} FFS_FINDER_TEXT;
 
 class FfsFinder
 {
@@ -42,9 +58,12 @@ private:
         messagesVector.push_back(std::pair<UString, UModelIndex>(message, index));
     }
 
-    USTATUS findHexPattern(const UModelIndex & index, const UByteArray & hexPattern, const UINT8 mode);
-    USTATUS findGuidPattern(const UModelIndex & index, const UByteArray & guidPattern, const UINT8 mode);
-    USTATUS findTextPattern(const UModelIndex & index, const UString & pattern, const UINT8 mode, const bool unicode, const Qt::CaseSensitivity caseSensitive);
+    USTATUS findHexPattern(const UModelIndex & index, const UByteArray & hexPattern, const BytePattern & pattern, const UINT8 mode);
+    USTATUS findGuidPattern(const UModelIndex & index, const UByteArray & guidPattern, const BytePattern & pattern, const UINT8 mode);
+    USTATUS findTextPattern(const UModelIndex & index, const UString & pattern, const FFS_FINDER_TEXT & text, const UINT8 mode);
+
+    void getSearchAreas(const UModelIndex & index, const UINT8 mode, const bool spanBody, const UINT32 maxMatchSize, std::vector<FFS_FINDER_AREA> & areas) const;
+    UString itemName(const UModelIndex & index) const;
 };
 
 #endif // FFSFINDER_H
@@ -73,10 +73,12 @@ void HexLineEdit::keyPressEvent(QKeyEvent * event)
         clipboard = QApplication::clipboard();
         originalText = clipboard->text();
         QString cleanedHex = QString(originalText).replace(QString("0x"), QString(""), Qt::CaseInsensitive);
+        // Byte patterns keep everything the search dialog accepts, GUIDs keep hex digits only
+        QString removed = m_editAsGuid ? QString("[^a-fA-F\\d]+") : QString("[^a-fA-F\\d\\.\\[\\]\\^\\-\\{\\},\\? ]+");
 #if QT_VERSION_MAJOR >= 6
-        cleanedHex.remove(QRegularExpression("[^a-fA-F\\d]+"));
+        cleanedHex.remove(QRegularExpression(removed));
 #else
-        cleanedHex.remove(QRegExp("[^a-fA-F\\d]+"));
+        cleanedHex.remove(QRegExp(removed));
 #endif
         clipboard->setText(cleanedHex);
     }
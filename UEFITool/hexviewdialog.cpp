@@ -12,6 +12,17 @@
  */
 
 #include "hexviewdialog.h"
+#include "qhexview5/model/buffer/qslicebuffer.h"
+
+// Adds item body to the buffer, bodies made of a single repeated byte are added without expanding them
+static void appendBody(QSliceBuffer* buffer, const TreeModel * model, const UModelIndex & index)
+{
+    UINT8 fill;
+    if (model->hasFillBody(index, fill))
+        buffer->appendFill(model->bodySize(index), fill);
+    else
+        buffer->append(model->body(index));
+}
 
 HexViewDialog::HexViewDialog(QWidget *parent) :
 QDialog(parent, Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowCloseButtonHint),
@@ -21,6 +32,7 @@ hexView(NULL)
     // Create UI
     ui->setupUi(this);
     hexView = new QHexView(this);
+    // Items are shown through a QSliceBuffer, which refuses edits
     hexView->setReadOnly(true);
     ui->layout->addWidget(hexView);
 }
@@ -42,27 +54,29 @@ void HexViewDialog::setItem(const UModelIndex & index, HexViewType type)
     UString itemName = model->name(index);
     UString itemText = model->text(index);
     
-    // Set hex data and dialog title
-    QByteArray hexdata;
+    // Set hex data and dialog title, the buffer shares item data with the model instead of copying it
+    QSliceBuffer* buffer = new QSliceBuffer();
     UString dialogTitle;
     
     switch (type) {
         case fullHexView:
             dialogTitle = UString("Hex view: ");
-            hexdata = model->header(index) + model->body(index) + model->tail(index);
+            buffer->append(model->header(index));
+            appendBody(buffer, model, index);
+            buffer->append(model->tail(index));
             break;
         case bodyHexView:
             dialogTitle = UString("Body hex view: ");
-            hexdata = model->body(index);
+            appendBody(buffer, model, index);
             break;
         case uncompressedHexView:
             dialogTitle = UString("Uncompressed hex view: ");
-            hexdata = model->uncompressedData(index);
+            buffer->append(model->uncompressedData(index));
             break;
     }
     
     dialogTitle += itemText.isEmpty() ? itemName : itemName + " | " + itemText;
     setWindowTitle(dialogTitle);
-    hexView->setData(hexdata);
+    hexView->setData(buffer);
     hexView->setFont(QApplication::font());
 }
@@ -0,0 +1,188 @@
+#include "qslicebuffer.h"
+#include <QFileDevice>
+#include <QtGlobal>
+#include <algorithm>
+#include <limits>
+
+// Searches read the buffer page by page, so no more than a page of fill is ever expanded
+#define QSLICEBUFFER_PAGE_SIZE 0x1000
+
+QSliceBuffer::QSliceBuffer(QObject *parent) : QHexBuffer{parent} { }
+
+QSliceBuffer::~QSliceBuffer()
+{
+    m_slices.clear();
+
+    if(m_mapping)
+    {
+        auto* file = qobject_cast<QFileDevice*>(m_device);
+        if(file) file->unmap(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if(m_device && m_device->parent() == this)
+    {
+        if(m_device->isOpen()) m_device->close();
+        m_device->deleteLater();
+    }
+
+    m_device = nullptr;
+}
+
+void QSliceBuffer::append(const QByteArray& data)
+{
+    if(data.isEmpty()) return;
+
+    Slice slice;
+    slice.offset = m_length;
+    slice.size = data.size();
+    slice.data = data;
+    slice.fill = 0;
+    m_slices.append(slice);
+    m_length += slice.size;
+}
+
+void QSliceBuffer::appendFill(qint64 size, uchar value)
+{
+    if(size <= 0) return;
+
+    Slice slice;
+    slice.offset = m_length;
+    slice.size = size;
+    slice.fill = value;
+    m_slices.append(slice);
+    m_length += size;
+}
+
+int QSliceBuffer::sliceIndex(qint64 offset) const
+{
+    auto it = std::upper_bound(m_slices.begin(), m_slices.end(), offset,
+                               [](qint64 o, const Slice& s) { return o < s.offset; });
+    return static_cast<int>(it - m_slices.begin()) - 1;
+}
+
+uchar QSliceBuffer::at(qint64 idx)
+{
+    if(idx < 0 || idx >= m_length) return 0;
+
+    const Slice& slice = m_slices.at(this->sliceIndex(idx));
+    if(slice.data.isEmpty()) return slice.fill;
+    return static_cast<uchar>(slice.data.at(static_cast<int>(idx - slice.offset)));
+}
+
+qint64 QSliceBuffer::length() const { return m_length; }
+
+void QSliceBuffer::insert(qint64 offset, const QByteArray &data)
+{
+    Q_UNUSED(offset)
+    Q_UNUSED(data)
+    Q_ASSERT_X(false, "QSliceBuffer::insert", "buffer is read-only");
+    qWarning("QSliceBuffer::insert: buffer is read-only, show it in a read-only QHexView");
+}
+
+void QSliceBuffer::replace(qint64 offset, const QByteArray& data)
+{
+    Q_UNUSED(offset)
+    Q_UNUSED(data)
+    Q_ASSERT_X(false, "QSliceBuffer::replace", "buffer is read-only");
+    qWarning("QSliceBuffer::replace: buffer is read-only, show it in a read-only QHexView");
+}
+
+void QSliceBuffer::remove(qint64 offset, int length)
+{
+    Q_UNUSED(offset)
+    Q_UNUSED(length)
+    Q_ASSERT_X(false, "QSliceBuffer::remove", "buffer is read-only");
+    qWarning("QSliceBuffer::remove: buffer is read-only, show it in a read-only QHexView");
+}
+
+QByteArray QSliceBuffer::read(qint64 offset, int length)
+{
+    if(offset < 0 || length <= 0 || offset >= m_length) return QByteArray();
+    if(length > m_length - offset) length = static_cast<int>(m_length - offset);
+
+    QByteArray result;
+    result.reserve(length);
+
+    for(int i = this->sliceIndex(offset); length > 0; i++)
+    {
+        const Slice& slice = m_slices.at(i);
+        qint64 start = offset - slice.offset;
+        int size = static_cast<int>(std::min<qint64>(slice.size - start, length));
+
+        if(slice.data.isEmpty()) result.append(size, static_cast<char>(slice.fill));
+        else result.append(slice.data.constData() + start, size);
+
+        offset += size;
+        length -= size;
+    }
+
+    return result;
+}
+
+bool QSliceBuffer::read(QIODevice *device)
+{
+    if(!device) return false;
+    if(!device->isOpen() && !device->open(QIODevice::ReadOnly)) return false;
+
+    m_device = device;
+
+    // Files are mapped instead of read, so pages are loaded only when shown
+    auto* file = qobject_cast<QFileDevice*>(device);
+    if(file && file->size() > 0 && file->size() <= std::numeric_limits<int>::max())
+    {
+        m_mapping = file->map(0, file->size());
+        if(m_mapping)
+        {
+            this->append(QByteArray::fromRawData(reinterpret_cast<const char*>(m_mapping), static_cast<int>(file->size())));
+            return true;
+        }
+    }
+
+    this->append(device->readAll());
+    return true;
+}
+
+void QSliceBuffer::write(QIODevice *device)
+{
+    for(const Slice& slice : m_slices)
+    {
+        if(!slice.data.isEmpty())
+        {
+            device->write(slice.data);
+            continue;
+        }
+
+        for(qint64 written = 0; written < slice.size; written += QSLICEBUFFER_PAGE_SIZE)
+            device->write(QByteArray(static_cast<int>(std::min<qint64>(slice.size - written, QSLICEBUFFER_PAGE_SIZE)), static_cast<char>(slice.fill)));
+    }
+}
+
+qint64 QSliceBuffer::indexOf(const QByteArray& ba, qint64 from)
+{
+    if(ba.isEmpty()) return -1;
+
+    // Pages overlap by the pattern size, so matches that cross pages are found too
+    for(qint64 pos = std::max<qint64>(from, 0); pos + ba.size() <= m_length; pos += QSLICEBUFFER_PAGE_SIZE)
+    {
+        int idx = this->read(pos, QSLICEBUFFER_PAGE_SIZE + ba.size() - 1).indexOf(ba);
+        if(idx >= 0) return pos + idx;
+    }
+
+    return -1;
+}
+
+qint64 QSliceBuffer::lastIndexOf(const QByteArray& ba, qint64 from)
+{
+    if(ba.isEmpty()) return -1;
+
+    for(qint64 last = std::min<qint64>(from, m_length - ba.size()); last >= 0; )
+    {
+        qint64 pos = std::max<qint64>(last - QSLICEBUFFER_PAGE_SIZE + 1, 0);
+        int idx = this->read(pos, static_cast<int>(last - pos) + ba.size()).lastIndexOf(ba);
+        if(idx >= 0) return pos + idx;
+        last = pos - 1;
+    }
+
+    return -1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "qhexbuffer.h"
+#include <QList>
+
+// Read-only buffer made of slices of existing byte arrays and runs of a single byte,
+// slices share data with their sources and are never joined, so views of large data cost no copies
+// Edits are refused, views showing this buffer must be read-only
+class QSliceBuffer : public QHexBuffer
+{
+    Q_OBJECT
+
+    public:
+        explicit QSliceBuffer(QObject *parent = nullptr);
+        virtual ~QSliceBuffer();
+        void append(const QByteArray& data);
+        void appendFill(qint64 size, uchar value);
+        uchar at(qint64 idx) override;
+        qint64 length() const override;
+        void insert(qint64 offset, const QByteArray& data) override;
+        void replace(qint64 offset, const QByteArray& data) override;
+        void remove(qint64 offset, int length) override;
+        QByteArray read(qint64 offset, int length) override;
+        bool read(QIODevice* device) override;
+        void write(QIODevice* device) override;
+        qint64 indexOf(const QByteArray& ba, qint64 from) override;
+        qint64 lastIndexOf(const QByteArray& ba, qint64 from) override;
+
+    private:
+        struct Slice {
+            qint64 offset;
+            qint64 size;
+            QByteArray data; // Empty for runs of fill
+            uchar fill;
+        };
+
+        int sliceIndex(qint64 offset) const;
+
+    private:
+        QList<Slice> m_slices;
+        qint64 m_length{0};
+        QIODevice* m_device{nullptr};
+        uchar* m_mapping{nullptr};
+};
@@ -219,8 +219,8 @@ void QHexView::showReplace()
 }
 #endif
 
-void QHexView::undo() { if(m_hexdocument) m_hexdocument->undo(); }
-void QHexView::redo() { if(m_hexdocument) m_hexdocument->redo(); }
+void QHexView::undo() { if(m_hexdocument && !m_readonly) m_hexdocument->undo(); }
+void QHexView::redo() { if(m_hexdocument && !m_readonly) m_hexdocument->redo(); }
 
 void QHexView::cut(bool hex)
 {
@@ -725,6 +725,8 @@ quint64 QHexView::lines() const
 
 qint64 QHexView::replace(const QVariant& oldvalue, const QVariant& newvalue, qint64 offset, QHexFindMode mode, unsigned int options, QHexFindDirection fd) const
 {
+    if(m_readonly) return -1;
+
     auto res = QHexUtils::replace(this, oldvalue, newvalue, offset, mode, options, fd);
 
     if(res.first > -1)
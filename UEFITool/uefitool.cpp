@@ -39,6 +39,24 @@ markingEnabled(true)
     ffsOps = NULL;
     ffsBuilder = NULL;
     ffsReport = NULL;
+    parseThread = NULL;
+    parsedModel = NULL;
+    parsedParser = NULL;
+    parseResult = U_SUCCESS;
+    parseProgress = 0;
+    parseItemsCreated = 0;
+    parseAbortRequested = false;
+    
+    // Create parsing progress indicator
+    parseProgressBar = new QProgressBar(this);
+    parseProgressBar->setRange(0, 1000);
+    parseProgressBar->setMaximumWidth(250);
+    parseAbortButton = new QPushButton(tr("Abort"), this);
+    ui->statusBar->addPermanentWidget(parseProgressBar);
+    ui->statusBar->addPermanentWidget(parseAbortButton);
+    showParsingProgress(false);
+    parseProgressTimer = new QTimer(this);
+    parseProgressTimer->setInterval(100);
     
     // Connect signals to slots
     connect(ui->actionOpenImageFile, SIGNAL(triggered()), this, SLOT(openImageFile()));
@@ -74,6 +92,8 @@ markingEnabled(true)
     connect(ui->actionGenerateReport, SIGNAL(triggered()), this, SLOT(generateReport()));
     connect(ui->actionToggleBootGuardMarking, SIGNAL(toggled(bool)), this, SLOT(toggleBootGuardMarking(bool)));
     connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(writeSettings()));
+    connect(parseAbortButton, SIGNAL(clicked()), this, SLOT(abortParsing()));
+    connect(parseProgressTimer, SIGNAL(timeout()), this, SLOT(updateParsingProgress()));
     
     // Enable Drag-and-Drop actions
     setAcceptDrops(true);
@@ -96,6 +116,7 @@ markingEnabled(true)
 
 UEFITool::~UEFITool()
 {
+    stopParsing();
     delete ffsBuilder;
     delete ffsOps;
     delete ffsFinder;
@@ -129,6 +150,8 @@ void UEFITool::init()
     ui->actionSearch->setEnabled(false);
     ui->actionGoToBase->setEnabled(false);
     ui->actionGoToAddress->setEnabled(false);
+    ui->actionGenerateReport->setEnabled(false);
+    ui->actionExportDiscoveredGuids->setEnabled(false);
     ui->menuCapsuleActions->setEnabled(false);
     ui->menuImageActions->setEnabled(false);
     ui->menuRegionActions->setEnabled(false);
@@ -140,23 +163,15 @@ void UEFITool::init()
     ui->menuEntryActions->setEnabled(false);
     ui->menuMessageActions->setEnabled(false);
     
-    // Create new model ...
-    delete model;
-    model = new TreeModel();
-    ui->structureTreeView->setModel(model);
-    // ... and ffsParser
-    delete ffsParser;
-    ffsParser = new FfsParser(model);
+    // Create new model and ffsParser
+    TreeModel* newModel = new TreeModel();
+    setModel(newModel, new FfsParser(newModel));
     
     // Set proper marking state
     model->setMarkingEnabled(markingEnabled);
     ui->actionToggleBootGuardMarking->setChecked(markingEnabled);
     
     // Connect signals to slots
-    connect(ui->structureTreeView->selectionModel(), SIGNAL(currentChanged(const QModelIndex &, const QModelIndex &)),
-            this, SLOT(populateUi(const QModelIndex &)));
-    connect(ui->structureTreeView->selectionModel(), SIGNAL(selectionChanged(const QItemSelection &, const QItemSelection &)),
-            this, SLOT(populateUi(const QItemSelection &)));
     connect(ui->parserMessagesListWidget,  SIGNAL(itemDoubleClicked(QListWidgetItem*)), this, SLOT(scrollTreeView(QListWidgetItem*)));
     connect(ui->parserMessagesListWidget,  SIGNAL(itemEntered(QListWidgetItem*)),       this, SLOT(enableMessagesCopyActions(QListWidgetItem*)));
     connect(ui->finderMessagesListWidget,  SIGNAL(itemDoubleClicked(QListWidgetItem*)), this, SLOT(scrollTreeView(QListWidgetItem*)));
@@ -203,6 +218,38 @@ void UEFITool::init()
 #endif // QT_VERSION_MAJOR
 }
 
+void UEFITool::setModel(TreeModel* newModel, FfsParser* newParser)
+{
+    // Keep marking state of the current model
+    if (model) {
+        newModel->setMarkingEnabled(model->markingEnabled());
+        newModel->setMarkingDarkMode(model->markingDarkMode());
+    }
+    
+    // Replace the model shown in the tree view
+    QItemSelectionModel* selectionModel = ui->structureTreeView->selectionModel();
+    ui->structureTreeView->setModel(newModel);
+    delete selectionModel;
+    delete ffsFinder;
+    delete ffsOps;
+    delete ffsReport;
+    delete ffsParser;
+    delete model;
+    model = newModel;
+    ffsParser = newParser;
+    
+    // Everything else that works on the model is replaced together with it
+    ffsFinder = new FfsFinder(model);
+    ffsOps = new FfsOperations(model);
+    ffsReport = new FfsReport(model);
+    
+    // Connect signals to slots
+    connect(ui->structureTreeView->selectionModel(), SIGNAL(currentChanged(const QModelIndex &, const QModelIndex &)),
+            this, SLOT(populateUi(const QModelIndex &)));
+    connect(ui->structureTreeView->selectionModel(), SIGNAL(selectionChanged(const QItemSelection &, const QItemSelection &)),
+            this, SLOT(populateUi(const QItemSelection &)));
+}
+
 #if QT_VERSION_MAJOR >= 6 && QT_VERSION_MINOR >= 5
 void UEFITool::updateUiForNewColorScheme(Qt::ColorScheme scheme)
 {
@@ -395,6 +442,7 @@ void UEFITool::goToBase()
     UINT32 offset = (UINT32)goToBaseDialog->ui->hexSpinBox->value();
     QModelIndex index = model->findByBase(offset);
     if (index.isValid()) {
+        model->fetchItem(index);
         ui->structureTreeView->scrollTo(index, QAbstractItemView::PositionAtCenter);
         ui->structureTreeView->selectionModel()->select(index, QItemSelectionModel::Select | QItemSelectionModel::Rows | QItemSelectionModel::Clear);
     }
@@ -410,6 +458,7 @@ void UEFITool::goToAddress()
     UINT32 address = (UINT32)goToAddressDialog->ui->hexSpinBox->value();
     QModelIndex index = model->findByBase(address - (UINT32)ffsParser->getAddressDiff());
     if (index.isValid()) {
+        model->fetchItem(index);
         ui->structureTreeView->scrollTo(index, QAbstractItemView::PositionAtCenter);
         ui->structureTreeView->selectionModel()->select(index, QItemSelectionModel::Select | QItemSelectionModel::Rows | QItemSelectionModel::Clear);
     }
@@ -424,7 +473,7 @@ void UEFITool::goToData()
     // Get parent
     QModelIndex parent = model->parent(index);
     
-    for (int i = index.row(); i < model->rowCount(parent); i++) {
+    for (int i = index.row(); i < model->childCount(parent); i++) {
         if (model->hasEmptyParsingData(index))
             continue;
         
@@ -432,12 +481,13 @@ void UEFITool::goToData()
         const NVAR_ENTRY_PARSING_DATA* pdata = (const NVAR_ENTRY_PARSING_DATA*)rdata.constData();
         UINT32 offset = model->offset(index);
         if (pdata->next == 0xFFFFFF) {
+            model->fetchItem(index);
             ui->structureTreeView->scrollTo(index, QAbstractItemView::PositionAtCenter);
             ui->structureTreeView->selectionModel()->select(index, QItemSelectionModel::Select | QItemSelectionModel::Rows | QItemSelectionModel::Clear);
         }
         
-        for (int j = i + 1; j < model->rowCount(parent); j++) {
-            QModelIndex currentIndex = parent.model()->index(j, 0, parent);
+        for (int j = i + 1; j < model->childCount(parent); j++) {
+            QModelIndex currentIndex = model->childIndex(j, parent);
             
             if (model->hasEmptyParsingData(currentIndex))
                 continue;
@@ -641,25 +691,97 @@ void UEFITool::openImageFile(QString path)
         return;
     }
     
+    // Check that the file can be read before the image shown now is thrown away
     QFile inputFile;
     inputFile.setFileName(path);
-    
     if (!inputFile.open(QFile::ReadOnly)) {
         QMessageBox::critical(this, tr("Image parsing failed"), tr("Can't open input file for reading"), QMessageBox::Ok);
         return;
     }
-    
-    QByteArray buffer = inputFile.readAll();
     inputFile.close();
     
+    // Only one image is parsed at a time
+    stopParsing();
+    
     init();
     setWindowTitle(tr("UEFITool %1 - %2").arg(version).arg(fileInfo.fileName()));
     
-    // Parse the image
-    USTATUS result = ffsParser->parse(buffer);
+    // Parse the image on a separate thread into a model that is not shown yet
+    parsedPath = path;
+    parsedModel = new TreeModel();
+    parsedParser = new FfsParser(parsedModel);
+    parsedParser->setCacheDirectory(QString::fromLocal8Bit(qgetenv("UEFITOOL_PARSE_CACHE")));
+    parsedParser->setThreadCount(QThread::idealThreadCount());
+    parsedParser->setProgressCallback([this](const FFS_PARSER_PROGRESS & progress) {
+        // Most of the time is spent in the first pass
+        UINT32 value = 950;
+        if (progress.phase == FFS_PARSER_PHASE_FIRST_PASS)
+            value = progress.bytesTotal ? (UINT32)(900ULL * progress.bytesProcessed / progress.bytesTotal) : 0;
+        else if (progress.phase == FFS_PARSER_PHASE_SECOND_PASS)
+            value = 900;
+        parseProgress = value;
+        parseItemsCreated = progress.itemsCreated;
+        return !parseAbortRequested;
+    });
+    parseResult = U_SUCCESS;
+    parseProgress = 0;
+    parseItemsCreated = 0;
+    parseAbortRequested = false;
+    
+    parseThread = new ParsingThread([this]() {
+        QFile inputFile;
+        inputFile.setFileName(parsedPath);
+        if (!inputFile.open(QFile::ReadOnly)) {
+            parseResult = U_FILE_OPEN;
+            return;
+        }
+        
+        QByteArray buffer = inputFile.readAll();
+        inputFile.close();
+        
+        parseResult = parsedParser->parse(buffer);
+    });
+    connect(parseThread, SIGNAL(finished()), this, SLOT(parsingFinished()));
+    
+    ui->statusBar->showMessage(tr("Parsing: %1").arg(fileInfo.fileName()));
+    showParsingProgress(true);
+    parseThread->start();
+}
+
+void UEFITool::parsingFinished()
+{
+    // Ignore notifications from the threads stopped before,
+    // the notification of the current thread is sent before it is fully finished
+    if (!parseThread || !parseThread->isDone())
+        return;
+    
+    parseThread->wait();
+    delete parseThread;
+    parseThread = NULL;
+    showParsingProgress(false);
+    
+    QFileInfo fileInfo = QFileInfo(parsedPath);
+    if (parseResult == U_FILE_OPEN || parseResult == U_ABORTED) {
+        delete parsedParser;
+        delete parsedModel;
+        parsedParser = NULL;
+        parsedModel = NULL;
+        if (parseResult == U_FILE_OPEN)
+            QMessageBox::critical(this, tr("Image parsing failed"), tr("Can't open input file for reading"), QMessageBox::Ok);
+        else
+            ui->statusBar->showMessage(tr("Parsing aborted: %1").arg(fileInfo.fileName()));
+        setWindowTitle(tr("UEFITool %1").arg(version));
+        return;
+    }
+    
+    // Show the parsed tree
+    setModel(parsedModel, parsedParser);
+    parsedModel = NULL;
+    parsedParser = NULL;
+    
     showParserMessages();
-    if (result) {
-        QMessageBox::critical(this, tr("Image parsing failed"), errorCodeToUString(result), QMessageBox::Ok);
+    if (parseResult) {
+        QMessageBox::critical(this, tr("Image parsing failed"), errorCodeToUString(parseResult), QMessageBox::Ok);
         return;
     }
     else {
@@ -673,16 +795,8 @@ void UEFITool::openImageFile(QString path)
     // Enable or disable Security tab
     showSecurityInfo();
     
-    // Enable search ...
-    delete ffsFinder;
-    ffsFinder = new FfsFinder(model);
+    // Enable search
     ui->actionSearch->setEnabled(true);
-    // ... and other operations
-    delete ffsOps;
-    ffsOps = new FfsOperations(model);
-    // ... and reports
-    delete ffsReport;
-    ffsReport = new FfsReport(model);
     
     // Enable goToBase and goToAddress
     ui->actionGoToBase->setEnabled(true);
@@ -699,7 +813,55 @@ void UEFITool::openImageFile(QString path)
     currentDir = fileInfo.absolutePath();
     
     // Set current path
-    currentPath = path;
+    currentPath = parsedPath;
+}
+
+void UEFITool::updateParsingProgress()
+{
+    parseProgressBar->setValue((int)parseProgress.load());
+    parseProgressBar->setFormat(tr("%p% (%1 items)").arg(parseItemsCreated.load()));
+}
+
+void UEFITool::abortParsing()
+{
+    // The thread notices the request on the next progress report and finishes normally
+    parseAbortRequested = true;
+    parseAbortButton->setEnabled(false);
+}
+
+void UEFITool::stopParsing()
+{
+    if (!parseThread)
+        return;
+    
+    parseAbortRequested = true;
+    parseThread->wait();
+    delete parseThread;
+    parseThread = NULL;
+    delete parsedParser;
+    delete parsedModel;
+    parsedParser = NULL;
+    parsedModel = NULL;
+    showParsingProgress(false);
+}
+
+void UEFITool::showParsingProgress(const bool visible)
+{
+    parseProgressBar->setValue(0);
+    parseProgressBar->setFormat(tr("%p%"));
+    parseProgressBar->setVisible(visible);
+    parseAbortButton->setEnabled(visible);
+    parseAbortButton->setVisible(visible);
+    
+    // GUID database is used by the parsing thread
+    ui->actionLoadGuidDatabase->setEnabled(!visible);
+    ui->actionUnloadGuidDatabase->setEnabled(!visible);
+    ui->actionLoadDefaultGuidDatabase->setEnabled(!visible);
+    
+    if (visible)
+        parseProgressTimer->start();
+    else
+        parseProgressTimer->stop();
 }
 
 void UEFITool::enableMessagesCopyActions(QListWidgetItem* item)
@@ -859,6 +1021,7 @@ void UEFITool::scrollTreeView(QListWidgetItem* item)
     QByteArray second = item->data(Qt::UserRole).toByteArray();
     QModelIndex *index = (QModelIndex *)second.data();
     if (index && index->isValid()) {
+        model->fetchItem(*index);
         ui->structureTreeView->scrollTo(*index, QAbstractItemView::PositionAtCenter);
         ui->structureTreeView->selectionModel()->select(*index, QItemSelectionModel::Select | QItemSelectionModel::Rows | QItemSelectionModel::Clear);
     }
@@ -869,6 +1032,7 @@ void UEFITool::scrollTreeView(QTableWidgetItem* item)
     QByteArray second = item->data(Qt::UserRole).toByteArray();
     QModelIndex *index = (QModelIndex *)second.data();
     if (index && index->isValid()) {
+        model->fetchItem(*index);
         ui->structureTreeView->scrollTo(*index, QAbstractItemView::PositionAtCenter);
         ui->structureTreeView->selectionModel()->select(*index, QItemSelectionModel::Select | QItemSelectionModel::Rows | QItemSelectionModel::Clear);
     }
@@ -1062,7 +1226,7 @@ void UEFITool::loadDefaultGuidDatabase()
 
 void UEFITool::exportDiscoveredGuids()
 {
-    GuidDatabase db = guidDatabaseFromTreeRecursive(model, model->index(0, 0));
+    GuidDatabase db = guidDatabaseFromTreeRecursive(model, model->childIndex(0));
     if (!db.empty()) {
         QString path = QFileDialog::getSaveFileName(this, tr("Save parsed GUIDs to database"), currentPath + ".guids.csv", tr("Comma-separated values files (*.csv);;All files (*)"));
         if (!path.isEmpty())
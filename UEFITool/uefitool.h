@@ -30,14 +30,21 @@
 #include <QPalette>
 #include <QPlainTextEdit>
 #include <QProcess>
+#include <QProgressBar>
+#include <QPushButton>
 #include <QSettings>
 #include <QSplitter>
 #include <QStyleFactory>
 #include <QString>
 #include <QTableWidget>
+#include <QThread>
+#include <QTimer>
 #include <QTreeView>
 #include <QUrl>
 
+#include <atomic>
+#include <functional>
+
 #include "../common/basetypes.h"
 #include "../common/utility.h"
 #include "../common/ffs.h"
@@ -57,6 +64,23 @@ namespace Ui {
     class UEFITool;
 }
 
+// Runs the given function on a new thread, QThread::create() is not available before Qt 5.10
+class ParsingThread : public QThread
+{
+public:
+    explicit ParsingThread(const std::function<void()> & function) : function(function), done(false) {}
+    
+    // Set once the function has returned, the thread itself may still be finishing
+    bool isDone() const { return done; }
+
+protected:
+    void run() { function(); done = true; }
+
+private:
+    std::function<void()> function;
+    std::atomic<bool> done;
+};
+
 class UEFITool : public QMainWindow
 {
     Q_OBJECT
@@ -79,6 +103,10 @@ private slots:
     void openImageFileInNewWindow();
     void saveImageFile();
 
+    void parsingFinished();
+    void updateParsingProgress();
+    void abortParsing();
+
     void search();
     void goToBase();
     void goToAddress();
@@ -151,11 +179,27 @@ private:
     const QString version;
     bool markingEnabled;
 
+    // Image being parsed in background, the model and the parser belong to the parsing thread until it finishes
+    ParsingThread* parseThread;
+    TreeModel* parsedModel;
+    FfsParser* parsedParser;
+    QString parsedPath;
+    USTATUS parseResult;
+    std::atomic<UINT32> parseProgress;
+    std::atomic<UINT32> parseItemsCreated;
+    std::atomic<bool> parseAbortRequested;
+    QProgressBar* parseProgressBar;
+    QPushButton* parseAbortButton;
+    QTimer* parseProgressTimer;
+
     bool eventFilter(QObject* obj, QEvent* event);
     void dragEnterEvent(QDragEnterEvent* event);
     void dropEvent(QDropEvent* event);
     void contextMenuEvent(QContextMenuEvent* event);
     void readSettings();
+    void setModel(TreeModel* newModel, FfsParser* newParser);
+    void stopParsing();
+    void showParsingProgress(const bool visible);
     void showParserMessages();
     void showFinderMessages();
     void showFitTable();
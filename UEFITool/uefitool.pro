@@ -35,6 +35,7 @@ HEADERS += uefitool.h \
  ../common/parsingdata.h \
  ../common/ffsbuilder.h \
  ../common/ffsparser.h \
+ ../common/parsecache.h \
  ../common/ffsreport.h \
  ../common/treeitem.h \
  ../common/intel_fit.h \
@@ -50,6 +51,7 @@ HEADERS += uefitool.h \
  ../common/digest/sha1.h \
  ../common/digest/sha2.h \
  ../common/digest/sm3.h \
+ ../common/digest/shani.h \
  ../common/generated/ami_nvar.h \
  ../common/generated/intel_acbp_v1.h \
  ../common/generated/intel_acbp_v2.h \
@@ -65,6 +67,7 @@ HEADERS += uefitool.h \
  qhexview5/model/buffer/qhexbuffer.h \
  qhexview5/model/buffer/qdevicebuffer.h \
  qhexview5/model/buffer/qmemorybuffer.h \
+ qhexview5/model/buffer/qslicebuffer.h \
  qhexview5/model/commands/hexcommand.h \
  qhexview5/model/commands/insertcommand.h \
  qhexview5/model/commands/removecommand.h \
@@ -97,6 +100,7 @@ SOURCES += uefitool_main.cpp \
  ../common/utility.cpp \
  ../common/ffsbuilder.cpp \
  ../common/ffsparser.cpp \
+ ../common/parsecache.cpp \
  ../common/ffsreport.cpp \
  ../common/treeitem.cpp \
  ../common/treemodel.cpp \
@@ -116,6 +120,7 @@ SOURCES += uefitool_main.cpp \
  ../common/digest/sha256.c \
  ../common/digest/sha512.c \
  ../common/digest/sm3.c \
+ ../common/digest/shani.c \
  ../common/generated/ami_nvar.cpp \
  ../common/generated/intel_acbp_v1.cpp \
  ../common/generated/intel_acbp_v2.cpp \
@@ -141,6 +146,7 @@ SOURCES += uefitool_main.cpp \
  qhexview5/model/buffer/qhexbuffer.cpp \
  qhexview5/model/buffer/qdevicebuffer.cpp \
  qhexview5/model/buffer/qmemorybuffer.cpp \
+ qhexview5/model/buffer/qslicebuffer.cpp \
  qhexview5/model/commands/hexcommand.cpp \
  qhexview5/model/commands/insertcommand.cpp \
  qhexview5/model/commands/removecommand.cpp \
@@ -162,3 +162,80 @@ LzmaDecompress (
         return U_INVALID_PARAMETER;
     }
 }
+
+/*
+Decompresses a Lzma compressed source buffer using a decoder state owned by the caller.
+
+Same as LzmaDecompress, but probability tables of the state are kept between calls
+and only reallocated when the properties of the stream need a different number of them.
+The state must be constructed with LzmaDec_Construct and released with LzmaDecompressFreeState.
+
+@param  State       The decoder state.
+@param  Source      The source buffer containing the compressed data.
+@param  SourceSize  The size of source buffer.
+@param  Destination The destination buffer to store the decompressed data
+
+@retval  EFI_SUCCESS Decompression completed successfully, and
+the uncompressed buffer is returned Destination.
+@retval  EFI_INVALID_PARAMETER
+The source buffer specified by Source is corrupted
+(not a valid compressed format).
+*/
+USTATUS
+EFIAPI
+LzmaDecompressWithState (
+    CLzmaDec    *State,
+    CONST VOID  *Source,
+    UINT32      SourceSize,
+    VOID        *Destination
+    )
+{
+    SRes              LzmaResult;
+    ELzmaStatus       Status;
+    SizeT             DecodedBufSize;
+    SizeT             EncodedDataSize;
+
+    // LzmaDecode needs at least 5 bytes to initialize the range decoder
+    if (SourceSize < LZMA_HEADER_SIZE + 5)
+        return U_INVALID_PARAMETER;
+
+    DecodedBufSize = (SizeT)GetDecodedSizeOfBuf((UINT8*)Source);
+    EncodedDataSize = (SizeT)(SourceSize - LZMA_HEADER_SIZE);
+
+    if (LzmaDec_AllocateProbs(State, (CONST Byte*)Source, LZMA_PROPS_SIZE, &SzAllocForLzma) != SZ_OK)
+        return U_INVALID_PARAMETER;
+
+    State->dic = (Byte*)Destination;
+    State->dicBufSize = DecodedBufSize;
+    LzmaDec_Init(State);
+    LzmaResult = LzmaDec_DecodeToDic(
+        State,
+        DecodedBufSize,
+        (Byte*)((UINT8*)Source + LZMA_HEADER_SIZE),
+        &EncodedDataSize,
+        LZMA_FINISH_END,
+        &Status
+        );
+    State->dic = NULL;
+
+    if (LzmaResult == SZ_OK && Status != LZMA_STATUS_NEEDS_MORE_INPUT) {
+        return U_SUCCESS;
+    }
+    else {
+        return U_INVALID_PARAMETER;
+    }
+}
+
+/*
+Releases probability tables of a decoder state used by LzmaDecompressWithState.
+
+@param  State       The decoder state.
+*/
+VOID
+EFIAPI
+LzmaDecompressFreeState (
+    CLzmaDec    *State
+    )
+{
+    LzmaDec_FreeProbs(State, &SzAllocForLzma);
+}
@@ -86,6 +86,43 @@ extern "C" {
             VOID         *Destination
         );
 
+    /*
+      Decompresses a Lzma compressed source buffer using a decoder state owned by the caller.
+
+      Same as LzmaDecompress, but probability tables of the state are kept between calls.
+      The state must be constructed with LzmaDec_Construct and released with LzmaDecompressFreeState.
+
+      @param  State       The decoder state.
+      @param  Source      The source buffer containing the compressed data.
+      @param  SourceSize  The size of source buffer.
+      @param  Destination The destination buffer to store the decompressed data
+
+      @retval  EFI_SUCCESS Decompression completed successfully, and
+      the uncompressed buffer is returned Destination.
+      @retval  EFI_INVALID_PARAMETER
+      The source buffer specified by Source is corrupted
+      (not a valid compressed format).
+      */
+    USTATUS
+        EFIAPI
+        LzmaDecompressWithState (
+            CLzmaDec    *State,
+            CONST VOID  *Source,
+            UINT32      SourceSize,
+            VOID        *Destination
+        );
+
+    /*
+      Releases probability tables of a decoder state used by LzmaDecompressWithState.
+
+      @param  State       The decoder state.
+      */
+    VOID
+        EFIAPI
+        LzmaDecompressFreeState (
+            CLzmaDec    *State
+        );
+
 #ifdef __cplusplus
 }
 #endif
@@ -16,6 +16,7 @@
 // public domain by Tom St Denis.
 //
 #include "sha1.h"
+#include "shani.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -58,12 +59,6 @@ do { (y)[0] = (unsigned char)(((x)>>56)&255); (y)[1] = (unsigned char)(((x)>>48)
 #define F2(x,y,z)  ((x & y) | (z & (x | y)))
 #define F3(x,y,z)  (x ^ y ^ z)
 
-struct sha1_state {
-    ulong64 length;
-    ulong32 state[5], curlen;
-    unsigned char buf[64];
-};
-
 static int s_sha1_compress(struct sha1_state *md, const unsigned char *buf)
 {
     ulong32 a,b,c,d,e,W[80],i;
@@ -121,7 +116,20 @@ static int s_sha1_compress(struct sha1_state *md, const unsigned char *buf)
     return 0;
 }
 
-static int sha1_init(struct sha1_state * md)
+/* compress a number of consecutive blocks, using SHA extensions if the CPU has them */
+static void s_sha1_compress_blocks(struct sha1_state * md, const unsigned char *buf, unsigned long blocks)
+{
+    if (shani_supported()) {
+        sha1_compress_shani(md->state, buf, (size_t)blocks);
+        return;
+    }
+    while (blocks--) {
+        s_sha1_compress(md, buf);
+        buf += 64;
+    }
+}
+
+int sha1_init(struct sha1_state * md)
 {
    if (md == NULL) return -1;
    md->state[0] = 0x67452301UL;
@@ -134,10 +142,9 @@ static int sha1_init(struct sha1_state * md)
    return 0;
 }
 
-static int sha1_process(struct sha1_state * md, const unsigned char *in, unsigned long inlen)
+int sha1_process(struct sha1_state * md, const unsigned char *in, unsigned long inlen)
 {
     unsigned long n;
-    int err;
     if (md == NULL) return -1;
     if (in == NULL) return -1;
     if (md->curlen > sizeof(md->buf)) {
@@ -149,12 +156,11 @@ static int sha1_process(struct sha1_state * md, const unsigned char *in, unsigne
     }
     while (inlen > 0) {
         if (md->curlen == 0 && inlen >= 64) {
-            if ((err = s_sha1_compress(md, in)) != 0) {
-                return err;
-            }
-            md->length += 64 * 8;
-            in         += 64;
-            inlen      -= 64;
+            n = inlen / 64;
+            s_sha1_compress_blocks(md, in, n);
+            md->length += n * 64 * 8;
+            in         += n * 64;
+            inlen      -= n * 64;
         } else {
             n = MIN(inlen, (64 - md->curlen));
             memcpy(md->buf + md->curlen, in, (size_t)n);
@@ -162,9 +168,7 @@ static int sha1_process(struct sha1_state * md, const unsigned char *in, unsigne
             in         += n;
             inlen      -= n;
             if (md->curlen == 64) {
-                if ((err = s_sha1_compress(md, md->buf)) != 0) {
-                    return err;
-                }
+                s_sha1_compress_blocks(md, md->buf, 1);
                 md->length += 8 * 64;
                 md->curlen = 0;
             }
@@ -173,7 +177,7 @@ static int sha1_process(struct sha1_state * md, const unsigned char *in, unsigne
     return 0;
 }
 
-static int sha1_done(struct sha1_state * md, unsigned char *out)
+int sha1_done(struct sha1_state * md, unsigned char *out)
 {
     int i;
 
@@ -198,7 +202,7 @@ static int sha1_done(struct sha1_state * md, unsigned char *out)
         while (md->curlen < 64) {
             md->buf[md->curlen++] = (unsigned char)0;
         }
-        s_sha1_compress(md, md->buf);
+        s_sha1_compress_blocks(md, md->buf, 1);
         md->curlen = 0;
     }
 
@@ -209,7 +213,7 @@ static int sha1_done(struct sha1_state * md, unsigned char *out)
 
     /* store length */
     STORE64H(md->length, md->buf+56);
-    s_sha1_compress(md, md->buf);
+    s_sha1_compress_blocks(md, md->buf, 1);
 
     /* copy output */
     for (i = 0; i < 5; i++) {
@@ -17,6 +17,30 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 extern "C" {
 #endif
 
+#include <stdint.h>
+
+struct sha256_state {
+    uint64_t length;
+    uint32_t state[8], curlen;
+    unsigned char buf[32*2];
+};
+
+struct sha512_state {
+    uint64_t length, state[8];
+    unsigned long curlen;
+    unsigned char buf[128];
+};
+
+/* Streaming interface, returns 0 on success, SHA384 is processed as SHA512 with a different initial state */
+int sha256_init(struct sha256_state * md);
+int sha256_process(struct sha256_state * md, const unsigned char *in, unsigned long inlen);
+int sha256_done(struct sha256_state * md, unsigned char *out);
+int sha384_init(struct sha512_state * md);
+int sha384_done(struct sha512_state * md, unsigned char *out);
+int sha512_init(struct sha512_state * md);
+int sha512_process(struct sha512_state * md, const unsigned char *in, unsigned long inlen);
+int sha512_done(struct sha512_state * md, unsigned char *out);
+
 void sha256(const void *in, unsigned long inlen, void* out);
 void sha384(const void *in, unsigned long inlen, void* out);
 void sha512(const void *in, unsigned long inlen, void* out);
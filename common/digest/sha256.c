@@ -17,6 +17,7 @@
 //
 
 #include "sha2.h"
+#include "shani.h"
 #include <stdint.h>
 #include <string.h>
 
@@ -63,12 +64,6 @@ do { (y)[0] = (unsigned char)(((x)>>56)&255); (y)[1] = (unsigned char)(((x)>>48)
 #define Gamma0(x)       (S(x, 7) ^ S(x, 18) ^ R(x, 3))
 #define Gamma1(x)       (S(x, 17) ^ S(x, 19) ^ R(x, 10))
 
-struct sha256_state {
-    ulong64 length;
-    ulong32 state[8], curlen;
-    unsigned char buf[32*2];
-};
-
 /* compress 512-bits */
 static int s_sha256_compress(struct sha256_state * md, const unsigned char *buf)
 {
@@ -170,7 +165,20 @@ static int s_sha256_compress(struct sha256_state * md, const unsigned char *buf)
     return 0;
 }
 
-static int sha256_init(struct sha256_state * md)
+/* compress a number of consecutive blocks, using SHA extensions if the CPU has them */
+static void s_sha256_compress_blocks(struct sha256_state * md, const unsigned char *buf, unsigned long blocks)
+{
+    if (shani_supported()) {
+        sha256_compress_shani(md->state, buf, (size_t)blocks);
+        return;
+    }
+    while (blocks--) {
+        s_sha256_compress(md, buf);
+        buf += 64;
+    }
+}
+
+int sha256_init(struct sha256_state * md)
 {
     if (md == NULL) return -1;
     md->curlen = 0;
@@ -186,10 +194,9 @@ static int sha256_init(struct sha256_state * md)
     return 0;
 }
 
-static int sha256_process(struct sha256_state * md, const unsigned char *in, unsigned long inlen)
+int sha256_process(struct sha256_state * md, const unsigned char *in, unsigned long inlen)
 {
     unsigned long n;
-    int err;
     if (md == NULL) return -1;
     if (in == NULL) return -1;
     if (md->curlen > sizeof(md->buf)) {
@@ -201,12 +208,11 @@ static int sha256_process(struct sha256_state * md, const unsigned char *in, uns
     }
     while (inlen > 0) {
         if (md->curlen == 0 && inlen >= 64) {
-            if ((err = s_sha256_compress(md, in)) != 0) {
-                return err;
-            }
-            md->length += 64 * 8;
-            in         += 64;
-            inlen      -= 64;
+            n = inlen / 64;
+            s_sha256_compress_blocks(md, in, n);
+            md->length += n * 64 * 8;
+            in         += n * 64;
+            inlen      -= n * 64;
         } else {
             n = MIN(inlen, (64 - md->curlen));
             memcpy(md->buf + md->curlen, in, (size_t)n);
@@ -214,9 +220,7 @@ static int sha256_process(struct sha256_state * md, const unsigned char *in, uns
             in         += n;
             inlen      -= n;
             if (md->curlen == 64) {
-                if ((err = s_sha256_compress(md, md->buf)) != 0) {
-                    return err;
-                }
+                s_sha256_compress_blocks(md, md->buf, 1);
                 md->length += 8 * 64;
                 md->curlen = 0;
             }
@@ -225,7 +229,7 @@ static int sha256_process(struct sha256_state * md, const unsigned char *in, uns
     return 0;
 }
 
-static int sha256_done(struct sha256_state * md, unsigned char *out)
+int sha256_done(struct sha256_state * md, unsigned char *out)
 {
     int i;
 
@@ -250,7 +254,7 @@ static int sha256_done(struct sha256_state * md, unsigned char *out)
         while (md->curlen < 64) {
             md->buf[md->curlen++] = (unsigned char)0;
         }
-        s_sha256_compress(md, md->buf);
+        s_sha256_compress_blocks(md, md->buf, 1);
         md->curlen = 0;
     }
 
@@ -261,7 +265,7 @@ static int sha256_done(struct sha256_state * md, unsigned char *out)
 
     /* store length */
     STORE64H(md->length, md->buf+56);
-    s_sha256_compress(md, md->buf);
+    s_sha256_compress_blocks(md, md->buf, 1);
 
     /* copy output */
     for (i = 0; i < 8; i++) {
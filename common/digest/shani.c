@@ -0,0 +1,196 @@
+/* shani.c
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+*/
+
+//
+// SHA-1 and SHA-256 block functions using x86 SHA extensions,
+// the code is compiled for every x86 target and is only called after a CPUID check
+//
+
+#include "shani.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#define SHANI_AVAILABLE
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define SHANI_TARGET
+#define SHANI_AVAILABLE
+#endif
+
+#if defined(SHANI_AVAILABLE)
+
+static int s_shani_detect(void)
+{
+    unsigned int leaf1[4] = { 0 };
+    unsigned int leaf7[4] = { 0 };
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return 0;
+    __cpuid(info, 1);
+    leaf1[2] = (unsigned int)info[2];
+    __cpuidex(info, 7, 0);
+    leaf7[1] = (unsigned int)info[1];
+#else
+    if (__get_cpuid_max(0, NULL) < 7)
+        return 0;
+    __cpuid(1, leaf1[0], leaf1[1], leaf1[2], leaf1[3]);
+    __cpuid_count(7, 0, leaf7[0], leaf7[1], leaf7[2], leaf7[3]);
+#endif
+    /* SSSE3, SSE4.1 and SHA */
+    return (leaf1[2] & (1U << 9)) && (leaf1[2] & (1U << 19)) && (leaf7[1] & (1U << 29));
+}
+
+int shani_supported(void)
+{
+    /* Detection is idempotent, so a race between threads only repeats it */
+    static volatile int supported = -1;
+    if (supported < 0)
+        supported = s_shani_detect();
+    return supported;
+}
+
+/* 4 rounds of SHA-1 for group g of 20, the message schedule for the following groups is computed along the way */
+#define SHA1_GROUP(g)                                                                            \
+    do {                                                                                         \
+        if ((g) == 0)                                                                            \
+            e[0] = _mm_add_epi32(e[0], msg[0]);                                                  \
+        else                                                                                     \
+            e[(g) & 1] = _mm_sha1nexte_epu32(e[(g) & 1], msg[(g) & 3]);                          \
+        e[((g) + 1) & 1] = abcd;                                                                 \
+        if ((g) >= 3 && (g) <= 18)                                                               \
+            msg[((g) + 1) & 3] = _mm_sha1msg2_epu32(msg[((g) + 1) & 3], msg[(g) & 3]);           \
+        abcd = _mm_sha1rnds4_epu32(abcd, e[(g) & 1], (g) / 5);                                   \
+        if ((g) >= 1 && (g) <= 16)                                                               \
+            msg[((g) - 1) & 3] = _mm_sha1msg1_epu32(msg[((g) - 1) & 3], msg[(g) & 3]);           \
+        if ((g) >= 2 && (g) <= 17)                                                               \
+            msg[((g) - 2) & 3] = _mm_xor_si128(msg[((g) - 2) & 3], msg[(g) & 3]);                \
+    } while (0)
+
+SHANI_TARGET
+void sha1_compress_shani(uint32_t state[5], const unsigned char *buf, size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i abcd, abcdSaved, e[2], eSaved, msg[4];
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+    e[0] = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while (blocks--) {
+        abcdSaved = abcd;
+        eSaved = e[0];
+
+        msg[0] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 0)), mask);
+        msg[1] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 16)), mask);
+        msg[2] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 32)), mask);
+        msg[3] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 48)), mask);
+
+        SHA1_GROUP(0);  SHA1_GROUP(1);  SHA1_GROUP(2);  SHA1_GROUP(3);  SHA1_GROUP(4);
+        SHA1_GROUP(5);  SHA1_GROUP(6);  SHA1_GROUP(7);  SHA1_GROUP(8);  SHA1_GROUP(9);
+        SHA1_GROUP(10); SHA1_GROUP(11); SHA1_GROUP(12); SHA1_GROUP(13); SHA1_GROUP(14);
+        SHA1_GROUP(15); SHA1_GROUP(16); SHA1_GROUP(17); SHA1_GROUP(18); SHA1_GROUP(19);
+
+        e[0] = _mm_sha1nexte_epu32(e[0], eSaved);
+        abcd = _mm_add_epi32(abcd, abcdSaved);
+        buf += 64;
+    }
+
+    _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t)_mm_extract_epi32(e[0], 3);
+}
+
+static const uint32_t K256[64] = {
+    0x428a2f98UL, 0x71374491UL, 0xb5c0fbcfUL, 0xe9b5dba5UL, 0x3956c25bUL, 0x59f111f1UL, 0x923f82a4UL, 0xab1c5ed5UL,
+    0xd807aa98UL, 0x12835b01UL, 0x243185beUL, 0x550c7dc3UL, 0x72be5d74UL, 0x80deb1feUL, 0x9bdc06a7UL, 0xc19bf174UL,
+    0xe49b69c1UL, 0xefbe4786UL, 0x0fc19dc6UL, 0x240ca1ccUL, 0x2de92c6fUL, 0x4a7484aaUL, 0x5cb0a9dcUL, 0x76f988daUL,
+    0x983e5152UL, 0xa831c66dUL, 0xb00327c8UL, 0xbf597fc7UL, 0xc6e00bf3UL, 0xd5a79147UL, 0x06ca6351UL, 0x14292967UL,
+    0x27b70a85UL, 0x2e1b2138UL, 0x4d2c6dfcUL, 0x53380d13UL, 0x650a7354UL, 0x766a0abbUL, 0x81c2c92eUL, 0x92722c85UL,
+    0xa2bfe8a1UL, 0xa81a664bUL, 0xc24b8b70UL, 0xc76c51a3UL, 0xd192e819UL, 0xd6990624UL, 0xf40e3585UL, 0x106aa070UL,
+    0x19a4c116UL, 0x1e376c08UL, 0x2748774cUL, 0x34b0bcb5UL, 0x391c0cb3UL, 0x4ed8aa4aUL, 0x5b9cca4fUL, 0x682e6ff3UL,
+    0x748f82eeUL, 0x78a5636fUL, 0x84c87814UL, 0x8cc70208UL, 0x90befffaUL, 0xa4506cebUL, 0xbef9a3f7UL, 0xc67178f2UL
+};
+
+/* 4 rounds of SHA-256 for group g of 16, the message schedule for the following groups is computed along the way */
+#define SHA256_GROUP(g)                                                                                          \
+    do {                                                                                                         \
+        rounds = _mm_add_epi32(msg[(g) & 3], _mm_loadu_si128((const __m128i*)&K256[4 * (g)]));                   \
+        state1 = _mm_sha256rnds2_epu32(state1, state0, rounds);                                                  \
+        if ((g) >= 3 && (g) <= 14) {                                                                             \
+            tmp = _mm_alignr_epi8(msg[(g) & 3], msg[((g) - 1) & 3], 4);                                          \
+            msg[((g) + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(msg[((g) + 1) & 3], tmp), msg[(g) & 3]);     \
+        }                                                                                                        \
+        state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(rounds, 0x0E));                         \
+        if ((g) >= 1 && (g) <= 12)                                                                               \
+            msg[((g) - 1) & 3] = _mm_sha256msg1_epu32(msg[((g) - 1) & 3], msg[(g) & 3]);                         \
+    } while (0)
+
+SHANI_TARGET
+void sha256_compress_shani(uint32_t state[8], const unsigned char *buf, size_t blocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, state0Saved, state1Saved, tmp, rounds, msg[4];
+
+    /* Reorder the state into ABEF and CDGH */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (blocks--) {
+        state0Saved = state0;
+        state1Saved = state1;
+
+        msg[0] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 0)), mask);
+        msg[1] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 16)), mask);
+        msg[2] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 32)), mask);
+        msg[3] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(buf + 48)), mask);
+
+        SHA256_GROUP(0);  SHA256_GROUP(1);  SHA256_GROUP(2);  SHA256_GROUP(3);
+        SHA256_GROUP(4);  SHA256_GROUP(5);  SHA256_GROUP(6);  SHA256_GROUP(7);
+        SHA256_GROUP(8);  SHA256_GROUP(9);  SHA256_GROUP(10); SHA256_GROUP(11);
+        SHA256_GROUP(12); SHA256_GROUP(13); SHA256_GROUP(14); SHA256_GROUP(15);
+
+        state0 = _mm_add_epi32(state0, state0Saved);
+        state1 = _mm_add_epi32(state1, state1Saved);
+        buf += 64;
+    }
+
+    /* Reorder the state back into ABCD and EFGH */
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#else
+
+int shani_supported(void)
+{
+    return 0;
+}
+
+void sha1_compress_shani(uint32_t state[5], const unsigned char *buf, size_t blocks)
+{
+    (void)state; (void)buf; (void)blocks;
+}
+
+void sha256_compress_shani(uint32_t state[8], const unsigned char *buf, size_t blocks)
+{
+    (void)state; (void)buf; (void)blocks;
+}
+
+#endif
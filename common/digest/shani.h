@@ -0,0 +1,33 @@
+/* shani.h
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+*/
+
+#ifndef SHANI_H
+#define SHANI_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Returns non-zero if the CPU supports x86 SHA extensions, the result is detected once */
+int shani_supported(void);
+
+/* Compress a number of consecutive 64-byte blocks, must only be called if shani_supported() returned non-zero */
+void sha1_compress_shani(uint32_t state[5], const unsigned char *buf, size_t blocks);
+void sha256_compress_shani(uint32_t state[8], const unsigned char *buf, size_t blocks);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // SHANI_H
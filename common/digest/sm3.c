@@ -5,18 +5,6 @@
 #include "sm3.h"
 #include <string.h>
 
-struct sm3_context {
-    uint32_t total[2];   /* number of bytes processed */
-    uint32_t state[8];   /* intermediate digest state */
-    uint8_t buffer[64];  /* data block being processed */
-    uint8_t ipad[64];    /* HMAC: inner padding */
-    uint8_t opad[64];    /* HMAC: outer padding */
-};
-
-static void sm3_init(struct sm3_context *ctx);
-static void sm3_update(struct sm3_context *ctx, const uint8_t *input, size_t ilen);
-static void sm3_final(struct sm3_context *ctx, uint8_t* output);
-
 #define GET_UINT32_BE(n, b, i)				\
 	do {						\
 		(n) = ((uint32_t)(b)[(i)] << 24)     |	\
@@ -33,7 +21,7 @@ static void sm3_final(struct sm3_context *ctx, uint8_t* output);
 		(b)[(i) + 3] = (uint8_t)((n));		\
 	} while (0)
 
-static void sm3_init(struct sm3_context *ctx)
+void sm3_init(struct sm3_context *ctx)
 {
 	ctx->total[0] = 0;
 	ctx->total[1] = 0;
@@ -48,19 +36,25 @@ static void sm3_init(struct sm3_context *ctx)
 	ctx->state[7] = 0xB0FB0E4E;
 }
 
+/* Round constants already rotated left by the round number */
+static const uint32_t sm3_t[64] = {
+	0x79CC4519, 0xF3988A32, 0xE7311465, 0xCE6228CB, 0x9CC45197, 0x3988A32F, 0x7311465E, 0xE6228CBC,
+	0xCC451979, 0x988A32F3, 0x311465E7, 0x6228CBCE, 0xC451979C, 0x88A32F39, 0x11465E73, 0x228CBCE6,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
+	0x7A879D8A, 0xF50F3B14, 0xEA1E7629, 0xD43CEC53, 0xA879D8A7, 0x50F3B14F, 0xA1E7629E, 0x43CEC53D,
+	0x879D8A7A, 0x0F3B14F5, 0x1E7629EA, 0x3CEC53D4, 0x79D8A7A8, 0xF3B14F50, 0xE7629EA1, 0xCEC53D43,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5
+};
+
 static void sm3_process(struct sm3_context *ctx, const uint8_t data[64])
 {
-	uint32_t SS1, SS2, TT1, TT2, W[68], W1[64];
+	uint32_t SS1, SS2, TT1, TT2, W[68];
 	uint32_t A, B, C, D, E, F, G, H;
-	uint32_t T[64];
 	uint32_t Temp1, Temp2, Temp3, Temp4, Temp5;
 	int j;
 
-	for (j = 0; j < 16; j++)
-		T[j] = 0x79CC4519;
-	for (j = 16; j < 64; j++)
-		T[j] = 0x7A879D8A;
-
 	GET_UINT32_BE(W[0], data,  0);
 	GET_UINT32_BE(W[1], data,  4);
 	GET_UINT32_BE(W[2], data,  8);
@@ -104,9 +98,6 @@ static void sm3_process(struct sm3_context *ctx, const uint8_t data[64])
 		W[j] = Temp4 ^ Temp5;
 	}
 
-	for (j =  0; j < 64; j++)
-		W1[j] = W[j] ^ W[j + 4];
-
 	A = ctx->state[0];
 	B = ctx->state[1];
 	C = ctx->state[2];
@@ -117,9 +108,9 @@ static void sm3_process(struct sm3_context *ctx, const uint8_t data[64])
 	H = ctx->state[7];
 
 	for (j = 0; j < 16; j++) {
-		SS1 = ROTL(ROTL(A, 12) + E + ROTL(T[j], j), 7);
+		SS1 = ROTL(ROTL(A, 12) + E + sm3_t[j], 7);
 		SS2 = SS1 ^ ROTL(A, 12);
-		TT1 = FF0(A, B, C) + D + SS2 + W1[j];
+		TT1 = FF0(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);
 		TT2 = GG0(E, F, G) + H + SS1 + W[j];
 		D = C;
 		C = ROTL(B, 9);
@@ -132,9 +123,9 @@ static void sm3_process(struct sm3_context *ctx, const uint8_t data[64])
 	}
 
 	for (j = 16; j < 64; j++) {
-		SS1 = ROTL(ROTL(A, 12) + E + ROTL(T[j], j), 7);
+		SS1 = ROTL(ROTL(A, 12) + E + sm3_t[j], 7);
 		SS2 = SS1 ^ ROTL(A, 12);
-		TT1 = FF1(A, B, C) + D + SS2 + W1[j];
+		TT1 = FF1(A, B, C) + D + SS2 + (W[j] ^ W[j + 4]);
 		TT2 = GG1(E, F, G) + H + SS1 + W[j];
 		D = C;
 		C = ROTL(B, 9);
@@ -156,7 +147,7 @@ static void sm3_process(struct sm3_context *ctx, const uint8_t data[64])
 	ctx->state[7] ^= H;
 }
 
-static void sm3_update(struct sm3_context *ctx, const uint8_t *input, size_t ilen)
+void sm3_update(struct sm3_context *ctx, const uint8_t *input, size_t ilen)
 {
 	size_t fill;
 	size_t left;
@@ -197,7 +188,7 @@ static const uint8_t sm3_padding[64] = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-static void sm3_final(struct sm3_context *ctx, uint8_t* output)
+void sm3_final(struct sm3_context *ctx, uint8_t* output)
 {
 	uint32_t last, padn;
 	uint32_t high, low;
@@ -81,18 +81,18 @@ USTATUS FfsBuilder::buildCapsule(const UModelIndex & index, UByteArray & capsule
     // Rebuild or Replace
     else if (model->action(index) == Actions::Rebuild
              || model->action(index) == Actions::Replace) {
-        if (model->rowCount(index)) {
+        if (model->childCount(index)) {
             // Clear the supplied UByteArray
             capsule.clear();
             
             // Right now there is only one capsule image element supported
-            if (model->rowCount(index) != 1) {
-                msg(usprintf("buildCapsule: building of capsules with %d items is not yet supported", model->rowCount(index)), index);
+            if (model->childCount(index) != 1) {
+                msg(usprintf("buildCapsule: building of capsules with %d items is not yet supported", model->childCount(index)), index);
                 return U_NOT_IMPLEMENTED;
             }
             
             // Build image
-            UModelIndex imageIndex = index.model()->index(0, 0, index);
+            UModelIndex imageIndex = model->childIndex(0, index);
             UByteArray imageData;
             
             // Check image type
@@ -165,11 +165,11 @@ USTATUS FfsBuilder::buildIntelImage(const UModelIndex & index, UByteArray & inte
     // Rebuild
     else if (model->action(index) == Actions::Rebuild) {
         // First child will always be descriptor for this type of image, and it's read only for now
-        intelImage = model->header(index.model()->index(0, 0, index)) + model->body(index.model()->index(0, 0, index)) + model->tail(index.model()->index(0, 0, index));
+        intelImage = model->header(model->childIndex(0, index)) + model->body(model->childIndex(0, index)) + model->tail(model->childIndex(0, index));
         
         // Process other regions
-        for (int i = 1; i < model->rowCount(index); i++) {
-            UModelIndex currentRegion = index.model()->index(i, 0, index);
+        for (int i = 1; i < model->childCount(index); i++) {
+            UModelIndex currentRegion = model->childIndex(i, index);
             
             // Skip regions with Remove action
             if (model->action(currentRegion) == Actions::Remove)
@@ -262,14 +262,14 @@ USTATUS FfsBuilder::buildRawArea(const UModelIndex & index, UByteArray & rawArea
     else if (model->action(index) == Actions::Rebuild
              || model->action(index) == Actions::Replace) {
         // Rebuild if there is at least 1 child
-        if (model->rowCount(index)) {
+        if (model->childCount(index)) {
             // Clear the supplied UByteArray
             rawArea.clear();
             
             // Build children
-            for (int i = 0; i < model->rowCount(index); i++) {
+            for (int i = 0; i < model->childCount(index); i++) {
                 USTATUS result = U_SUCCESS;
-                UModelIndex currentChild = index.model()->index(i, 0, index);
+                UModelIndex currentChild = model->childIndex(i, index);
                 UByteArray currentData;
                 
                 // Check child type
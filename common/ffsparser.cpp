@@ -30,6 +30,7 @@
 #include "nvramparser.h"
 #include "meparser.h"
 #include "fitparser.h"
+#include "parsecache.h"
 
 #include "digest/sha1.h"
 #include "digest/sha2.h"
@@ -37,7 +38,7 @@
 
 // Constructor
 FfsParser::FfsParser(TreeModel* treeModel) : model(treeModel),
-imageBase(0), addressDiff(0x100000000ULL), protectedRegionsBase(0) {
+imageBase(0), addressDiff(0x100000000ULL), protectedRegionsBase(0), standardCompressionAlgorithm(COMPRESSION_ALGORITHM_TIANO), threadCount(1), workerPool(NULL), prefetch(NULL), aborted(false) {
     fitParser = new FitParser(treeModel, this);
     nvramParser = new NvramParser(treeModel, this);
     meParser = new MeParser(treeModel, this);
@@ -45,11 +46,22 @@ imageBase(0), addressDiff(0x100000000ULL), protectedRegionsBase(0) {
 
 // Destructor
 FfsParser::~FfsParser() {
+    dropPreparsedSections(UModelIndex());
+    delete workerPool;
     delete nvramParser;
     delete meParser;
     delete fitParser;
 }
 
+void FfsParser::setThreadCount(const UINT32 count)
+{
+    threadCount = count > 0 ? count : 1;
+    
+    // The pool is created again with the new size when it's needed
+    delete workerPool;
+    workerPool = NULL;
+}
+
 // Obtain parser messages
 std::vector<std::pair<UString, UModelIndex> > FfsParser::getMessages() const {
     std::vector<std::pair<UString, UModelIndex> > meVector = meParser->getMessages();
@@ -87,9 +99,42 @@ USTATUS FfsParser::parse(const UByteArray & buffer)
     protectedRanges.clear();
     lastVtf = UModelIndex();
     dxeCore = UModelIndex();
+    standardCompressionAlgorithm = COMPRESSION_ALGORITHM_TIANO;
+    decompressedSections.clear();
+    prefetch = NULL;
+    dropPreparsedSections(UModelIndex());
+    progress = FFS_PARSER_PROGRESS();
+    progress.bytesTotal = (UINT32)buffer.size();
+    aborted = false;
+    
+    // Attached views are updated once when the whole tree is built
+    model->beginUpdate();
+    
+    // Try to restore the tree from the parse cache
+    UByteArray digest;
+    size_t messageCounts[4] = {};
+    int firstRow = model->childCount();
+    if (!cacheDirectory.isEmpty()) {
+        digest = UByteArray(SHA256_HASH_SIZE, '\x00');
+        sha256(buffer.constData(), buffer.size(), digest.data());
+        if (restoreFromCache(buffer, digest)) {
+            model->endUpdate();
+            return U_SUCCESS;
+        }
+        
+        messageCounts[0] = messagesVector.size();
+        messageCounts[1] = meParser->getMessages().size();
+        messageCounts[2] = nvramParser->getMessages().size();
+        messageCounts[3] = fitParser->getMessages().size();
+    }
     
     // Parse input buffer
-    USTATUS result = performFirstPass(buffer, root);
+    USTATUS result = reportPhase(FFS_PARSER_PHASE_FIRST_PASS) ? performFirstPass(buffer, root) : U_ABORTED;
+    if (aborted || !reportPhase(FFS_PARSER_PHASE_SECOND_PASS)) {
+        model->endUpdate();
+        return U_ABORTED;
+    }
+    
     if (result == U_SUCCESS) {
         if (lastVtf.isValid()) {
             result = performSecondPass(root);
@@ -99,10 +144,91 @@ USTATUS FfsParser::parse(const UByteArray & buffer)
         }
     }
     
+    if (!reportPhase(FFS_PARSER_PHASE_INFO)) {
+        model->endUpdate();
+        return U_ABORTED;
+    }
     addInfoRecursive(root);
+    
+    if (!cacheDirectory.isEmpty() && result == U_SUCCESS)
+        storeToCache(buffer, digest, firstRow, messageCounts, result);
+    
+    model->endUpdate();
     return result;
 }
 
+bool FfsParser::reportProgress(const UModelIndex & index)
+{
+    if (aborted)
+        return false;
+    if (!progressCallback)
+        return true;
+    
+    // Offsets of compressed items are not related to the image
+    if (!model->compressed(index) && model->base(index) > progress.bytesProcessed)
+        progress.bytesProcessed = model->base(index);
+    progress.itemsCreated = model->itemsCreated();
+    
+    aborted = !progressCallback(progress);
+    return !aborted;
+}
+
+bool FfsParser::reportPhase(const UINT8 phase)
+{
+    if (phase != FFS_PARSER_PHASE_FIRST_PASS)
+        progress.bytesProcessed = progress.bytesTotal;
+    progress.phase = phase;
+    return reportProgress(UModelIndex());
+}
+
+bool FfsParser::restoreFromCache(const UByteArray & buffer, const UByteArray & digest)
+{
+    PARSE_CACHE_RESULT cached;
+    if (U_SUCCESS != parseCacheLoad(cacheDirectory, buffer, digest, model, cached) || cached.result != U_SUCCESS)
+        return false;
+    
+    // Messages of all parsers are restored in the order getMessages() returned them
+    messagesVector.insert(messagesVector.end(), cached.messages.begin(), cached.messages.end());
+    fitParser->restore(cached.fitTable, cached.fitSecurityInfo);
+    securityInfo = cached.securityInfo;
+    addressDiff = cached.addressDiff;
+    imageBase = cached.imageBase;
+    protectedRegionsBase = cached.protectedRegionsBase;
+    protectedRanges = cached.protectedRanges;
+    lastVtf = cached.lastVtf;
+    dxeCore = cached.dxeCore;
+    return true;
+}
+
+void FfsParser::storeToCache(const UByteArray & buffer, const UByteArray & digest, const int firstRow, const size_t messageCounts[4], const USTATUS result)
+{
+    PARSE_CACHE_RESULT cached;
+    cached.result = result;
+    cached.addressDiff = addressDiff;
+    cached.securityInfo = securityInfo;
+    cached.fitSecurityInfo = fitParser->getSecurityInfo();
+    cached.fitTable = fitParser->getFitTable();
+    cached.imageBase = imageBase;
+    cached.protectedRegionsBase = protectedRegionsBase;
+    cached.protectedRanges = protectedRanges;
+    cached.lastVtf = lastVtf;
+    cached.dxeCore = dxeCore;
+    
+    // Only messages added by this parse are stored
+    std::vector<std::pair<UString, UModelIndex> > messages[4] = { messagesVector, meParser->getMessages(), nvramParser->getMessages(), fitParser->getMessages() };
+    for (int i = 0; i < 4; i++) {
+        if (messages[i].size() > messageCounts[i])
+            cached.messages.insert(cached.messages.end(), messages[i].begin() + messageCounts[i], messages[i].end());
+    }
+    
+    std::vector<UModelIndex> items;
+    for (int row = firstRow; row < model->childCount(); row++)
+        items.push_back(model->childIndex(row));
+    
+    // Failing to store the cache does not affect parsing results
+    parseCacheStore(cacheDirectory, buffer, digest, model, items, cached);
+}
+
 USTATUS FfsParser::performFirstPass(const UByteArray & buffer, UModelIndex & index)
 {
     // Sanity check
@@ -692,7 +818,7 @@ USTATUS FfsParser::parseMeRegion(const UByteArray & me, const UINT32 localOffset
     bool versionFound = true;
     bool emptyRegion = false;
     // Check for empty region
-    if (me.size() == me.count('\xFF') || me.size() == me.count('\x00')) {
+    if (allBytesEqual(me, 0xFF) || allBytesEqual(me, 0x00)) {
         // Further parsing not needed
         emptyRegion = true;
         info += ("\nState: empty");
@@ -778,7 +904,7 @@ USTATUS FfsParser::parseDevExp1Region(const UByteArray & devExp1, const UINT32 l
     
     bool emptyRegion = false;
     // Check for empty region
-    if (devExp1.size() == devExp1.count('\xFF') || devExp1.size() == devExp1.count('\x00')) {
+    if (allBytesEqual(devExp1, 0xFF) || allBytesEqual(devExp1, 0x00)) {
         // Further parsing not needed
         emptyRegion = true;
         info += ("\nState: empty");
@@ -845,7 +971,12 @@ USTATUS FfsParser::parseRawArea(const UModelIndex & index)
     UINT32 prevItemSize = 0;
     UINT32 prevItemAltSize = 0;
     
-    result = findNextRawAreaItem(index, 0, prevItemType, prevItemOffset, prevItemSize, prevItemAltSize);
+    // Find all signature candidates in a single pass
+    const UINT32 signatures[] = { INTEL_MICROCODE_HEADER_VERSION_1, EFI_FV_SIGNATURE, BPDT_GREEN_SIGNATURE, BPDT_YELLOW_SIGNATURE };
+    std::vector<UINT32> candidates;
+    findSignatures(signatures, sizeof(signatures) / sizeof(signatures[0]), (const UINT8*)data.constData(), (UINTN)data.size(), candidates);
+    
+    result = findNextRawAreaItem(index, data, candidates, 0, prevItemType, prevItemOffset, prevItemSize, prevItemAltSize);
     if (result) {
         // No need to parse further
         return U_SUCCESS;
@@ -956,7 +1087,7 @@ USTATUS FfsParser::parseRawArea(const UModelIndex & index)
         prevItemOffset = itemOffset;
         prevItemSize = itemSize;
         prevItemType = itemType;
-        result = findNextRawAreaItem(index, itemOffset + prevItemSize, itemType, itemOffset, itemSize, itemAltSize);
+        result = findNextRawAreaItem(index, data, candidates, itemOffset + prevItemSize, itemType, itemOffset, itemSize, itemAltSize);
         
         // Silence value not used after assignment warning
         (void)prevItemType;
@@ -976,8 +1107,8 @@ USTATUS FfsParser::parseRawArea(const UModelIndex & index)
     }
     
     // Parse bodies
-    for (int i = 0; i < model->rowCount(index); i++) {
-        UModelIndex current = index.model()->index(i, 0, index);
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
         
         switch (model->type(current)) {
             case Types::Volume:
@@ -1200,7 +1331,7 @@ USTATUS FfsParser::parseVolumeHeader(const UByteArray & volume, const UINT32 loc
     pdata.hasValidUsedSpace = FALSE; // Will be updated later, if needed
     pdata.usedSpace = usedSpace;
     pdata.isWeakAligned = (volumeHeader->Revision > 1 && (volumeHeader->Attributes & EFI_FVB2_WEAK_ALIGNMENT));
-    model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+    model->setParsingData(index, &pdata, sizeof(pdata));
     
     // Show messages
     if (isUnknown)
@@ -1281,16 +1412,17 @@ bool FfsParser::microcodeHeaderValid(const INTEL_MICROCODE_HEADER* ucodeHeader)
     return TRUE;
 }
 
-USTATUS FfsParser::findNextRawAreaItem(const UModelIndex & index, const UINT32 localOffset, UINT8 & nextItemType, UINT32 & nextItemOffset, UINT32 & nextItemSize, UINT32 & nextItemAlternativeSize)
+USTATUS FfsParser::findNextRawAreaItem(const UModelIndex & index, const UByteArray & data, const std::vector<UINT32> & candidates, const UINT32 localOffset, UINT8 & nextItemType, UINT32 & nextItemOffset, UINT32 & nextItemSize, UINT32 & nextItemAlternativeSize)
 {
-    UByteArray data = model->body(index);
     UINT32 dataSize = (UINT32)data.size();
     
     if (dataSize < sizeof(UINT32))
         return U_STORES_NOT_FOUND;
     
-    UINT32 offset = localOffset;
-    for (; offset < dataSize - sizeof(UINT32); offset++) {
+    // Only check offsets where one of the signatures is present
+    std::vector<UINT32>::const_iterator candidate = std::lower_bound(candidates.begin(), candidates.end(), localOffset);
+    for (; candidate != candidates.end() && *candidate < dataSize - sizeof(UINT32); ++candidate) {
+        UINT32 offset = *candidate;
         const UINT32* currentPos = (const UINT32*)(data.constData() + offset);
         UINT32 restSize = dataSize - offset;
         if (readUnaligned(currentPos) == INTEL_MICROCODE_HEADER_VERSION_1) {// Intel microcode
@@ -1418,7 +1550,7 @@ continue_searching: {}
     }
     
     // No more stores found
-    if (offset >= dataSize - sizeof(UINT32)) {
+    if (candidate == candidates.end() || *candidate >= dataSize - sizeof(UINT32)) {
         return U_STORES_NOT_FOUND;
     }
     
@@ -1449,6 +1581,10 @@ USTATUS FfsParser::parseVolumeBody(const UModelIndex & index)
         return U_INVALID_PARAMETER;
     }
     
+    // Stop here if parsing is aborted
+    if (!reportProgress(index))
+        return U_ABORTED;
+    
     // Get volume header size and body
     UByteArray volumeBody = model->body(index);
     UINT32 volumeHeaderSize = (UINT32)model->header(index).size();
@@ -1497,7 +1633,7 @@ USTATUS FfsParser::parseVolumeBody(const UModelIndex & index)
         
         // Check that we are at the empty space
         UByteArray header = volumeBody.mid(fileOffset, (int)std::min(sizeof(EFI_FFS_FILE_HEADER), (size_t)volumeBodySize - fileOffset));
-        if (header.count(emptyByte) == header.size()) { //Empty space
+        if (allBytesEqual(header, emptyByte)) { //Empty space
             // Check volume usedSpace entry to be valid
             if (usedSpace > 0 && usedSpace == fileOffset + volumeHeaderSize) {
                 if (model->hasEmptyParsingData(index) == false) {
@@ -1511,7 +1647,7 @@ USTATUS FfsParser::parseVolumeBody(const UModelIndex & index)
             
             // Check free space to be actually free
             UByteArray freeSpace = volumeBody.mid(fileOffset);
-            if (freeSpace.count(emptyByte) != freeSpace.size()) {
+            if (!allBytesEqual(freeSpace, emptyByte)) {
                 // Search for the first non-empty byte
                 UINT32 i;
                 UINT32 size = (UINT32)freeSpace.size();
@@ -1576,9 +1712,11 @@ USTATUS FfsParser::parseVolumeBody(const UModelIndex & index)
         fileOffset = ALIGN8(fileOffset);
     }
     
-    // Check for duplicate GUIDs
-    for (int i = 0; i < model->rowCount(index); i++) {
-        UModelIndex current = index.model()->index(i, 0, index);
+    // Check for duplicate GUIDs, every later file with the same GUID is reported once per earlier non-pad file
+    VOLUME_FILE_MAP files;
+    buildVolumeFileMap(model, index, files);
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
         
         // Skip non-file entries and padding files
         if (model->type(current) != Types::File
@@ -1587,30 +1725,28 @@ USTATUS FfsParser::parseVolumeBody(const UModelIndex & index)
         }
         
         // Get current file GUID
-        UByteArray currentGuid(model->header(current).constData(), sizeof(EFI_GUID));
+        UByteArray header = model->header(current);
+        if ((size_t)header.size() < sizeof(EFI_GUID))
+            continue;
+        EFI_GUID currentGuid = readUnaligned((const EFI_GUID*)header.constData());
         
-        // Check files after current for having an equal GUID
-        for (int j = i + 1; j < model->rowCount(index); j++) {
-            UModelIndex another = index.model()->index(j, 0, index);
-            
-            // Skip non-file entries
-            if (model->type(another) != Types::File) {
-                continue;
-            }
-            
-            // Get another file GUID
-            UByteArray anotherGuid(model->header(another).constData(), sizeof(EFI_GUID));
-            
-            // Check GUIDs for being equal
-            if (currentGuid == anotherGuid) {
-                msg(usprintf("%s: file with duplicate GUID ", __FUNCTION__) + guidToUString(readUnaligned((EFI_GUID*)(anotherGuid.data()))), another);
-            }
+        // Report files after current having an equal GUID
+        VOLUME_FILE_MAP::const_iterator found = files.find(currentGuid);
+        if (found == files.end() || found->second.size() < 2)
+            continue;
+        std::vector<int>::const_iterator another = std::upper_bound(found->second.begin(), found->second.end(), i);
+        for (; another != found->second.end(); ++another) {
+            msg(usprintf("%s: file with duplicate GUID ", __FUNCTION__) + guidToUString(currentGuid), model->childIndex(*another, index));
         }
     }
     
+    // Decompress sections of the files on worker threads ahead of parsing, the results will be picked up by parseFileBody
+    DECOMPRESSION_PREFETCH volumePrefetch;
+    startPrefetch(index, ffsVersion, volumePrefetch);
+    
     // Parse bodies
-    for (int i = 0; i < model->rowCount(index); i++) {
-        UModelIndex current = index.model()->index(i, 0, index);
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
         
         switch (model->type(current)) {
             case Types::File:
@@ -1621,10 +1757,13 @@ USTATUS FfsParser::parseVolumeBody(const UModelIndex & index)
                 // No parsing required
                 break;
             default:
+                finishPrefetch(volumePrefetch);
                 return U_UNKNOWN_ITEM_TYPE;
         }
     }
     
+    // Drop the results that were not used
+    finishPrefetch(volumePrefetch);
     return U_SUCCESS;
 }
 
@@ -1666,6 +1805,47 @@ UINT32 FfsParser::getFileSize(const UByteArray & volume, const UINT32 fileOffset
     return 0;
 }
 
+// Generates file info from the header, body and tail stored in the file item
+static UString fileHeaderInfo(const TreeItem* item)
+{
+    UByteArray header = item->header();
+    UByteArray body = item->body();
+    UINT32 tailSize = (UINT32)item->tail().size();
+    const EFI_FFS_FILE_HEADER* fileHeader = (const EFI_FFS_FILE_HEADER*)header.constData();
+    
+    // Obtain revision of the parent volume
+    UINT8 volumeRevision = 2;
+    const TreeItem* volume = item->parent();
+    while (volume && volume->type() != Types::Volume)
+        volume = volume->parent();
+    if (volume && !volume->hasEmptyParsingData()) {
+        UByteArray data = volume->parsingData();
+        volumeRevision = ((const VOLUME_PARSING_DATA*)data.constData())->revision;
+    }
+    
+    // Calculate checksums the same way parseFileHeader does
+    UINT8 calculatedHeader = 0x100 - (calculateSum8((const UINT8*)header.constData(), (UINT32)header.size()) - fileHeader->IntegrityCheck.Checksum.Header - fileHeader->IntegrityCheck.Checksum.File - fileHeader->State);
+    UINT8 calculatedData;
+    if (fileHeader->Attributes & FFS_ATTRIB_CHECKSUM)
+        calculatedData = calculateChecksum8((const UINT8*)body.constData(), (UINT32)body.size());
+    else if (volumeRevision == 1)
+        calculatedData = FFS_FIXED_CHECKSUM;
+    else
+        calculatedData = FFS_FIXED_CHECKSUM2;
+    
+    return UString("File GUID: ") + guidToUString(fileHeader->Name, false) +
+    usprintf("\nType: %02Xh\nAttributes: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nTail size: %Xh (%u)\nState: %02Xh",
+             fileHeader->Type,
+             fileHeader->Attributes,
+             (UINT32)(header.size() + body.size() + tailSize), (UINT32)(header.size() + body.size() + tailSize),
+             (UINT32)header.size(), (UINT32)header.size(),
+             (UINT32)body.size(), (UINT32)body.size(),
+             tailSize, tailSize,
+             fileHeader->State) +
+    usprintf("\nHeader checksum: %02Xh", fileHeader->IntegrityCheck.Checksum.Header) + (fileHeader->IntegrityCheck.Checksum.Header != calculatedHeader ? usprintf(", invalid, should be %02Xh", calculatedHeader) : UString(", valid")) +
+    usprintf("\nData checksum: %02Xh", fileHeader->IntegrityCheck.Checksum.File) + (fileHeader->IntegrityCheck.Checksum.File != calculatedData ? usprintf(", invalid, should be %02Xh", calculatedData) : UString(", valid"));
+}
+
 USTATUS FfsParser::parseFileHeader(const UByteArray & file, const UINT32 localOffset, const UModelIndex & parent, UModelIndex & index)
 {
     // Sanity check
@@ -1775,27 +1955,14 @@ USTATUS FfsParser::parseFileHeader(const UByteArray & file, const UINT32 localOf
         msgUnknownType = true;
     };
     
-    // Get info
+    // Get name, info will be generated from the header on request
     UString name;
-    UString info;
     if (fileHeader->Type != EFI_FV_FILETYPE_PAD) {
         name = guidToUString(fileHeader->Name);
     } else {
         name = UString("Padding file");
     }
     
-    info = UString("File GUID: ") + guidToUString(fileHeader->Name, false) +
-    usprintf("\nType: %02Xh\nAttributes: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nTail size: %Xh (%u)\nState: %02Xh",
-             fileHeader->Type,
-             fileHeader->Attributes,
-             (UINT32)(header.size() + body.size() + tail.size()), (UINT32)(header.size() + body.size() + tail.size()),
-             (UINT32)header.size(), (UINT32)header.size(),
-             (UINT32)body.size(), (UINT32)body.size(),
-             (UINT32)tail.size(), (UINT32)tail.size(),
-             fileHeader->State) +
-    usprintf("\nHeader checksum: %02Xh", fileHeader->IntegrityCheck.Checksum.Header) + (msgInvalidHeaderChecksum ? usprintf(", invalid, should be %02Xh", calculatedHeader) : UString(", valid")) +
-    usprintf("\nData checksum: %02Xh", fileHeader->IntegrityCheck.Checksum.File) + (msgInvalidDataChecksum ? usprintf(", invalid, should be %02Xh", calculatedData) : UString(", valid"));
-    
     UString text;
     bool isVtf = false;
     bool isDxeCore = false;
@@ -1819,13 +1986,14 @@ USTATUS FfsParser::parseFileHeader(const UByteArray & file, const UINT32 localOf
     ItemFixedState fixed = (ItemFixedState)((fileHeader->Attributes & FFS_ATTRIB_FIXED) != 0);
     
     // Add tree item
-    index = model->addItem(localOffset, Types::File, fileHeader->Type, name, text, info, header, body, tail, fixed, parent);
+    index = model->addItem(localOffset, Types::File, fileHeader->Type, name, text, UString(), header, body, tail, fixed, parent);
+    model->setInfoGenerator(index, fileHeaderInfo);
     
     // Set parsing data for created file
     FILE_PARSING_DATA pdata = {};
     pdata.emptyByte = (fileHeader->State & EFI_FILE_ERASE_POLARITY) ? 0xFF : 0x00;
     pdata.guid = fileHeader->Name;
-    model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+    model->setParsingData(index, &pdata, sizeof(pdata));
     
     // Override lastVtf index, if needed
     if (isVtf) {
@@ -1886,6 +2054,10 @@ USTATUS FfsParser::parseFileBody(const UModelIndex & index)
     if (!index.isValid())
         return U_INVALID_PARAMETER;
     
+    // Stop here if parsing is aborted
+    if (!reportProgress(index))
+        return U_ABORTED;
+    
     // Do not parse non-file bodies
     if (model->type(index) != Types::File)
         return U_SUCCESS;
@@ -1965,7 +2137,7 @@ USTATUS FfsParser::parsePadFileBody(const UModelIndex & index)
     }
     
     // Check if the while padding file is empty
-    if (body.size() == body.count(emptyByte))
+    if (allBytesEqual(body, emptyByte))
         return U_SUCCESS;
     
     // Search for the first non-empty byte
@@ -2055,6 +2227,31 @@ USTATUS FfsParser::parseSections(const UByteArray & sections, const UModelIndex
         ffsVersion = pdata->ffsVersion;
     }
     
+    // Section headers of a successful preparse of the same data only need to be moved into the tree, their bodies are left to parse,
+    // their messages were held back until now to keep the message order
+    if (insertIntoTree) {
+        std::map<UModelIndex, PREPARSED_SECTIONS>::iterator it = preparsedSections.find(index);
+        if (it != preparsedSections.end()
+            && it->second.sections.constData() == sections.constData() && it->second.sections.size() == sections.size()
+            && model->childCount(index) == 0) {
+            PREPARSED_SECTIONS & preparsed = it->second;
+            for (size_t i = 0; i < preparsed.messages.size(); i++) {
+                if (preparsed.messages[i].second.internalPointer() == preparsed.standIn.internalPointer())
+                    preparsed.messages[i].second = index;
+            }
+            messagesVector.insert(messagesVector.end(), preparsed.messages.begin(), preparsed.messages.end());
+            model->commitStandIn(preparsed.standIn, index);
+            preparsedSections.erase(it);
+            sectionOffset = bodySize;
+        }
+    }
+    dropPreparsedSections(index);
+    
+    // Preliminary parsing builds section headers under a stand-in of this item, so nothing is added to the tree until the preparse succeeds,
+    // the stand-in and all messages about its items are dropped if it fails
+    UModelIndex parent = insertIntoTree ? index : model->createStandIn(index);
+    size_t firstMessage = messagesVector.size();
+    
     // Iterate over sections
     UINT32 sectionSize = 0;
     while (sectionOffset < bodySize) {
@@ -2083,18 +2280,24 @@ USTATUS FfsParser::parseSections(const UByteArray & sections, const UModelIndex
             }
             // Preliminary parsing
             else {
+                model->dropStandIn(parent);
+                messagesVector.resize(firstMessage);
                 return U_INVALID_SECTION;
             }
         }
         
         // Parse section header
         UModelIndex sectionIndex;
-        result = parseSectionHeader(sections.mid(sectionOffset, sectionSize), headerSize + sectionOffset, index, sectionIndex, insertIntoTree);
+        result = parseSectionHeader(sections.mid(sectionOffset, sectionSize), headerSize + sectionOffset, parent, sectionIndex, true);
         if (result) {
-            if (insertIntoTree)
+            if (insertIntoTree) {
                 msg(usprintf("%s: section header parsing failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
-            else
+            }
+            else {
+                model->dropStandIn(parent);
+                messagesVector.resize(firstMessage);
                 return U_INVALID_SECTION;
+            }
         }
         
         // Move to next section
@@ -2123,9 +2326,19 @@ USTATUS FfsParser::parseSections(const UByteArray & sections, const UModelIndex
     }
 #endif
     
-    // Parse bodies, will be skipped if insertIntoTree is not required
-    for (int i = 0; i < model->rowCount(index); i++) {
-        UModelIndex current = index.model()->index(i, 0, index);
+    // Keep preparsed section headers for the final parsing, and hold their messages back until then
+    if (!insertIntoTree) {
+        PREPARSED_SECTIONS & preparsed = preparsedSections[index];
+        preparsed.standIn = parent;
+        preparsed.sections = sections;
+        preparsed.messages.assign(messagesVector.begin() + firstMessage, messagesVector.end());
+        messagesVector.resize(firstMessage);
+        return U_SUCCESS;
+    }
+    
+    // Parse bodies
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
         
         switch (model->type(current)) {
             case Types::Section:
@@ -2142,6 +2355,18 @@ USTATUS FfsParser::parseSections(const UByteArray & sections, const UModelIndex
     return U_SUCCESS;
 }
 
+void FfsParser::dropPreparsedSections(const UModelIndex & index)
+{
+    // Drop preparsed sections of the given item, or all of them if the index is invalid
+    std::map<UModelIndex, PREPARSED_SECTIONS>::iterator it = index.isValid() ? preparsedSections.find(index) : preparsedSections.begin();
+    while (it != preparsedSections.end()) {
+        model->dropStandIn(it->second.standIn);
+        it = preparsedSections.erase(it);
+        if (index.isValid())
+            break;
+    }
+}
+
 USTATUS FfsParser::parseSectionHeader(const UByteArray & section, const UINT32 localOffset, const UModelIndex & parent, UModelIndex & index, const bool insertIntoTree)
 {
     // Check sanity
@@ -2173,11 +2398,80 @@ USTATUS FfsParser::parseSectionHeader(const UByteArray & section, const UINT32 l
             // Unknown
         default:
             USTATUS result = parseCommonSectionHeader(section, localOffset, parent, index, insertIntoTree);
-            msg(usprintf("%s: section with unknown type %02Xh", __FUNCTION__, sectionHeader->Type), index);
+            if (insertIntoTree)
+                msg(usprintf("%s: section with unknown type %02Xh", __FUNCTION__, sectionHeader->Type), index);
             return result;
     }
 }
 
+// Section info generators, header fields specific to the section type are located at the end of its header
+static UString commonSectionInfo(const TreeItem* item)
+{
+    UINT32 headerSize = (UINT32)item->header().size();
+    UINT32 bodySize = item->bodySize();
+    return usprintf("Type: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)",
+                    item->subtype(),
+                    headerSize + bodySize, headerSize + bodySize,
+                    headerSize, headerSize,
+                    bodySize, bodySize);
+}
+
+static UString compressedSectionInfo(const TreeItem* item)
+{
+    UByteArray header = item->header();
+    const EFI_COMPRESSION_SECTION* compressedSectionHeader = (const EFI_COMPRESSION_SECTION*)(header.constData() + header.size() - sizeof(EFI_COMPRESSION_SECTION));
+    return commonSectionInfo(item) + usprintf("\nCompression type: %02Xh\nDecompressed size: %Xh (%u)",
+                                              compressedSectionHeader->CompressionType,
+                                              compressedSectionHeader->UncompressedLength, compressedSectionHeader->UncompressedLength);
+}
+
+static UString freeformGuidedSectionInfo(const TreeItem* item)
+{
+    UByteArray header = item->header();
+    const EFI_FREEFORM_SUBTYPE_GUID_SECTION* fsgSectionHeader = (const EFI_FREEFORM_SUBTYPE_GUID_SECTION*)(header.constData() + header.size() - sizeof(EFI_FREEFORM_SUBTYPE_GUID_SECTION));
+    return commonSectionInfo(item) + UString("\nSubtype GUID: ") + guidToUString(fsgSectionHeader->SubTypeGuid, false);
+}
+
+static UString versionSectionInfo(const TreeItem* item)
+{
+    UByteArray header = item->header();
+    const EFI_VERSION_SECTION* versionHeader = (const EFI_VERSION_SECTION*)(header.constData() + header.size() - sizeof(EFI_VERSION_SECTION));
+    return commonSectionInfo(item) + usprintf("\nBuild number: %u", versionHeader->BuildNumber);
+}
+
+static UString postcodeSectionInfo(const TreeItem* item)
+{
+    UByteArray header = item->header();
+    const POSTCODE_SECTION* postcodeHeader = (const POSTCODE_SECTION*)(header.constData() + header.size() - sizeof(POSTCODE_SECTION));
+    return commonSectionInfo(item) + usprintf("\nPostcode: %Xh", postcodeHeader->Postcode);
+}
+
+// Order of generators is kept, their positions are stored in parse cache files
+static const TreeItemInfoGenerator infoGenerators[] = {
+    fileHeaderInfo,
+    commonSectionInfo,
+    compressedSectionInfo,
+    freeformGuidedSectionInfo,
+    versionSectionInfo,
+    postcodeSectionInfo
+};
+
+UINT8 FfsParser::infoGeneratorId(const TreeItemInfoGenerator generator)
+{
+    for (size_t i = 0; i < sizeof(infoGenerators) / sizeof(infoGenerators[0]); i++) {
+        if (infoGenerators[i] == generator)
+            return (UINT8)(i + 1);
+    }
+    return 0;
+}
+
+TreeItemInfoGenerator FfsParser::infoGeneratorById(const UINT8 id)
+{
+    if (id == 0 || id > sizeof(infoGenerators) / sizeof(infoGenerators[0]))
+        return NULL;
+    return infoGenerators[id - 1];
+}
+
 USTATUS FfsParser::parseCommonSectionHeader(const UByteArray & section, const UINT32 localOffset, const UModelIndex & parent, UModelIndex & index, const bool insertIntoTree)
 {
     // Check sanity
@@ -2209,17 +2503,13 @@ USTATUS FfsParser::parseCommonSectionHeader(const UByteArray & section, const UI
     UByteArray header = section.left(headerSize);
     UByteArray body = section.mid(headerSize);
     
-    // Get info
+    // Get name, info will be generated from the header on request
     UString name = sectionTypeToUString(type) + UString(" section");
-    UString info = usprintf("Type: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)",
-                            type,
-                            (UINT32)section.size(), (UINT32)section.size(),
-                            headerSize, headerSize,
-                            (UINT32)body.size(), (UINT32)body.size());
     
     // Add tree item
     if (insertIntoTree) {
-        index = model->addItem(localOffset, Types::Section, type, name, UString(), info, header, body, UByteArray(), Movable, parent);
+        index = model->addItem(localOffset, Types::Section, type, name, UString(), UString(), header, body, UByteArray(), Movable, parent);
+        model->setInfoGenerator(index, commonSectionInfo);
     }
     
     return U_SUCCESS;
@@ -2270,25 +2560,19 @@ USTATUS FfsParser::parseCompressedSectionHeader(const UByteArray & section, cons
     UByteArray header = section.left(headerSize);
     UByteArray body = section.mid(headerSize);
     
-    // Get info
+    // Get name, info will be generated from the header on request
     UString name = sectionTypeToUString(sectionHeader->Type) + UString(" section");
-    UString info = usprintf("Type: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nCompression type: %02Xh\nDecompressed size: %Xh (%u)",
-                            sectionHeader->Type,
-                            (UINT32)section.size(), (UINT32)section.size(),
-                            headerSize, headerSize,
-                            (UINT32)body.size(), (UINT32)body.size(),
-                            compressionType,
-                            uncompressedLength, uncompressedLength);
     
     // Add tree item
     if (insertIntoTree) {
-        index = model->addItem(localOffset, Types::Section, sectionHeader->Type, name, UString(), info, header, body, UByteArray(), Movable, parent);
+        index = model->addItem(localOffset, Types::Section, sectionHeader->Type, name, UString(), UString(), header, body, UByteArray(), Movable, parent);
+        model->setInfoGenerator(index, compressedSectionInfo);
         
         // Set section parsing data
         COMPRESSED_SECTION_PARSING_DATA pdata = {};
         pdata.compressionType = compressionType;
         pdata.uncompressedSize = uncompressedLength;
-        model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+        model->setParsingData(index, &pdata, sizeof(pdata));
     }
     
     return U_SUCCESS;
@@ -2482,7 +2766,7 @@ USTATUS FfsParser::parseGuidedSectionHeader(const UByteArray & section, const UI
         // Set parsing data
         GUIDED_SECTION_PARSING_DATA pdata = {};
         pdata.guid = guid;
-        model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+        model->setParsingData(index, &pdata, sizeof(pdata));
         
         // Show messages
         if (msgSignedSectionFound)
@@ -2552,23 +2836,18 @@ USTATUS FfsParser::parseFreeformGuidedSectionHeader(const UByteArray & section,
     UByteArray header = section.left(headerSize);
     UByteArray body = section.mid(headerSize);
     
-    // Get info
+    // Get name, info will be generated from the header on request
     UString name = sectionTypeToUString(type) + (" section");
-    UString info = usprintf("Type: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nSubtype GUID: ",
-                            type,
-                            (UINT32)section.size(), (UINT32)section.size(),
-                            (UINT32)header.size(), (UINT32)header.size(),
-                            (UINT32)body.size(), (UINT32)body.size())
-    + guidToUString(guid, false);
     
     // Add tree item
     if (insertIntoTree) {
-        index = model->addItem(localOffset, Types::Section, type, name, UString(), info, header, body, UByteArray(), Movable, parent);
+        index = model->addItem(localOffset, Types::Section, type, name, UString(), UString(), header, body, UByteArray(), Movable, parent);
+        model->setInfoGenerator(index, freeformGuidedSectionInfo);
         
         // Set parsing data
         FREEFORM_GUIDED_SECTION_PARSING_DATA pdata = {};
         pdata.guid = guid;
-        model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+        model->setParsingData(index, &pdata, sizeof(pdata));
         
         // Rename section
         model->setName(index, guidToUString(guid));
@@ -2594,21 +2873,16 @@ USTATUS FfsParser::parseVersionSectionHeader(const UByteArray & section, const U
     
     // Obtain header fields
     UINT32 headerSize;
-    UINT16 buildNumber;
     UINT8 type;
     const EFI_COMMON_SECTION_HEADER* sectionHeader = (const EFI_COMMON_SECTION_HEADER*)(section.constData());
     const EFI_COMMON_SECTION_HEADER2* section2Header = (const EFI_COMMON_SECTION_HEADER2*)(section.constData());
     
     if (ffsVersion == 3 && uint24ToUint32(sectionHeader->Size) == EFI_SECTION2_IS_USED) { // Check for extended header section
-        const EFI_VERSION_SECTION* versionHeader = (const EFI_VERSION_SECTION*)(section2Header + 1);
         headerSize = sizeof(EFI_COMMON_SECTION_HEADER2) + sizeof(EFI_VERSION_SECTION);
-        buildNumber = versionHeader->BuildNumber;
         type = section2Header->Type;
     }
     else { // Normal section
-        const EFI_VERSION_SECTION* versionHeader = (const EFI_VERSION_SECTION*)(sectionHeader + 1);
         headerSize = sizeof(EFI_COMMON_SECTION_HEADER) + sizeof(EFI_VERSION_SECTION);
-        buildNumber = versionHeader->BuildNumber;
         type = sectionHeader->Type;
     }
     
@@ -2619,18 +2893,13 @@ USTATUS FfsParser::parseVersionSectionHeader(const UByteArray & section, const U
     UByteArray header = section.left(headerSize);
     UByteArray body = section.mid(headerSize);
     
-    // Get info
+    // Get name, info will be generated from the header on request
     UString name = sectionTypeToUString(type) + (" section");
-    UString info = usprintf("Type: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nBuild number: %u",
-                            type,
-                            (UINT32)section.size(), (UINT32)section.size(),
-                            (UINT32)header.size(), (UINT32)header.size(),
-                            (UINT32)body.size(), (UINT32)body.size(),
-                            buildNumber);
     
     // Add tree item
     if (insertIntoTree) {
-        index = model->addItem(localOffset, Types::Section, type, name, UString(), info, header, body, UByteArray(), Movable, parent);
+        index = model->addItem(localOffset, Types::Section, type, name, UString(), UString(), header, body, UByteArray(), Movable, parent);
+        model->setInfoGenerator(index, versionSectionInfo);
     }
     
     return U_SUCCESS;
@@ -2653,21 +2922,16 @@ USTATUS FfsParser::parsePostcodeSectionHeader(const UByteArray & section, const
     
     // Obtain header fields
     UINT32 headerSize;
-    UINT32 postCode;
     UINT8 type;
     const EFI_COMMON_SECTION_HEADER* sectionHeader = (const EFI_COMMON_SECTION_HEADER*)(section.constData());
     const EFI_COMMON_SECTION_HEADER2* section2Header = (const EFI_COMMON_SECTION_HEADER2*)(section.constData());
     
     if (ffsVersion == 3 && uint24ToUint32(sectionHeader->Size) == EFI_SECTION2_IS_USED) { // Check for extended header section
-        const POSTCODE_SECTION* postcodeHeader = (const POSTCODE_SECTION*)(section2Header + 1);
         headerSize = sizeof(EFI_COMMON_SECTION_HEADER2) + sizeof(POSTCODE_SECTION);
-        postCode = postcodeHeader->Postcode;
         type = section2Header->Type;
     }
     else { // Normal section
-        const POSTCODE_SECTION* postcodeHeader = (const POSTCODE_SECTION*)(sectionHeader + 1);
         headerSize = sizeof(EFI_COMMON_SECTION_HEADER) + sizeof(POSTCODE_SECTION);
-        postCode = postcodeHeader->Postcode;
         type = sectionHeader->Type;
     }
     
@@ -2678,18 +2942,13 @@ USTATUS FfsParser::parsePostcodeSectionHeader(const UByteArray & section, const
     UByteArray header = section.left(headerSize);
     UByteArray body = section.mid(headerSize);
     
-    // Get info
+    // Get name, info will be generated from the header on request
     UString name = sectionTypeToUString(type) + (" section");
-    UString info = usprintf("Type: %02Xh\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nPostcode: %Xh",
-                            type,
-                            (UINT32)section.size(), (UINT32)section.size(),
-                            (UINT32)header.size(), (UINT32)header.size(),
-                            (UINT32)body.size(), (UINT32)body.size(),
-                            postCode);
     
     // Add tree item
     if (insertIntoTree) {
-        index = model->addItem(localOffset, Types::Section, sectionHeader->Type, name, UString(), info, header, body, UByteArray(), Movable, parent);
+        index = model->addItem(localOffset, Types::Section, sectionHeader->Type, name, UString(), UString(), header, body, UByteArray(), Movable, parent);
+        model->setInfoGenerator(index, postcodeSectionInfo);
     }
     
     return U_SUCCESS;
@@ -2700,6 +2959,11 @@ USTATUS FfsParser::parseSectionBody(const UModelIndex & index)
     // Sanity check
     if (!index.isValid())
         return U_INVALID_PARAMETER;
+    
+    // Stop here if parsing is aborted
+    if (!reportProgress(index))
+        return U_ABORTED;
+    
     UByteArray header = model->header(index);
     if ((UINT32)header.size() < sizeof(EFI_COMMON_SECTION_HEADER))
         return U_INVALID_SECTION;
@@ -2753,7 +3017,15 @@ USTATUS FfsParser::parseCompressedSectionBody(const UModelIndex & index)
     UINT32 dictionarySize = 0;
     UByteArray decompressed;
     UByteArray efiDecompressed;
-    USTATUS result = decompress(model->body(index), compressionType, algorithm, dictionarySize, decompressed, efiDecompressed);
+    USTATUS result;
+    if (compressionType == EFI_STANDARD_COMPRESSION)
+        result = decompressStandard(model->body(index), index, algorithm, decompressed);
+    else if (compressionType == EFI_CUSTOMIZED_COMPRESSION)
+        result = decompressSection(model->body(index), index, COMPRESSION_ALGORITHM_LZMA, algorithm, dictionarySize, decompressed, efiDecompressed);
+    else if (compressionType == EFI_CUSTOMIZED_COMPRESSION_LZMAF86)
+        result = decompressSection(model->body(index), index, COMPRESSION_ALGORITHM_LZMAF86, algorithm, dictionarySize, decompressed, efiDecompressed);
+    else
+        result = decompress(model->body(index), compressionType, algorithm, dictionarySize, decompressed, efiDecompressed);
     if (result) {
         msg(usprintf("%s: decompression failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
         return U_SUCCESS;
@@ -2771,18 +3043,7 @@ USTATUS FfsParser::parseCompressedSectionBody(const UModelIndex & index)
     
     // Check for undecided compression algorithm, this is a special case
     if (algorithm == COMPRESSION_ALGORITHM_UNDECIDED) {
-        // Try preparse of sections decompressed with Tiano algorithm
-        if (U_SUCCESS == parseSections(decompressed, index, false)) {
-            algorithm = COMPRESSION_ALGORITHM_TIANO;
-        }
-        // Try preparse of sections decompressed with EFI 1.1 algorithm
-        else if (U_SUCCESS == parseSections(efiDecompressed, index, false)) {
-            algorithm = COMPRESSION_ALGORITHM_EFI11;
-            decompressed = efiDecompressed;
-        }
-        else {
-            msg(usprintf("%s: can't guess the correct decompression algorithm, both preparse steps are failed", __FUNCTION__), index);
-        }
+        msg(usprintf("%s: can't guess the correct decompression algorithm, both preparse steps are failed", __FUNCTION__), index);
     }
     
     // Add info
@@ -2803,12 +3064,263 @@ USTATUS FfsParser::parseCompressedSectionBody(const UModelIndex & index)
     pdata.dictionarySize = dictionarySize;
     pdata.compressionType = compressionType;
     pdata.uncompressedSize = uncompressedSize;
-    model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+    model->setParsingData(index, &pdata, sizeof(pdata));
     
     // Parse decompressed data
     return parseSections(decompressed, index, true);
 }
 
+USTATUS FfsParser::decompressStandard(const UByteArray & compressed, const UModelIndex & index, UINT8 & algorithm, UByteArray & decompressed)
+{
+    // EFI 1.1 and Tiano algorithms share the same format, so the correct one can only be guessed by trying to parse the decompressed data
+    // Tiano is tried first and wins if its data can be parsed, EFI 1.1 is decompressed only if that fails
+    UINT8 algorithmUnused;
+    UINT32 dictionarySizeUnused;
+    UByteArray efiDecompressedUnused;
+    UByteArray tianoDecompressed;
+    USTATUS tianoResult = decompressSection(compressed, index, COMPRESSION_ALGORITHM_TIANO, algorithmUnused, dictionarySizeUnused, tianoDecompressed, efiDecompressedUnused);
+    
+    // Preparse keeps the section headers it added to the tree if it succeeds, so mark this item as compressed beforehand for them to inherit the flag
+    if (tianoResult == U_SUCCESS)
+        model->setCompressed(index, true);
+    
+    if (tianoResult == U_SUCCESS && U_SUCCESS == parseSections(tianoDecompressed, index, false)) {
+        algorithm = COMPRESSION_ALGORITHM_TIANO;
+        decompressed = tianoDecompressed;
+        return U_SUCCESS;
+    }
+    
+    UByteArray efiDecompressed;
+    USTATUS efiResult = decompressSection(compressed, index, COMPRESSION_ALGORITHM_EFI11, algorithmUnused, dictionarySizeUnused, efiDecompressed, efiDecompressedUnused);
+    if (tianoResult != U_SUCCESS && efiResult != U_SUCCESS) { // Both decompressions failed
+        algorithm = COMPRESSION_ALGORITHM_UNKNOWN;
+        return U_STANDARD_DECOMPRESSION_FAILED;
+    }
+    
+    if (efiResult == U_SUCCESS)
+        model->setCompressed(index, true);
+    
+    if (efiResult != U_SUCCESS) { // Only Tiano is OK
+        algorithm = COMPRESSION_ALGORITHM_TIANO;
+        decompressed = tianoDecompressed;
+    }
+    else if (tianoResult != U_SUCCESS) { // Only EFI 1.1 is OK
+        algorithm = COMPRESSION_ALGORITHM_EFI11;
+        decompressed = efiDecompressed;
+    }
+    else if (U_SUCCESS == parseSections(efiDecompressed, index, false)) { // Both are OK, but only EFI 1.1 passed preparse
+        algorithm = COMPRESSION_ALGORITHM_EFI11;
+        decompressed = efiDecompressed;
+        // Remember that this image uses EFI 1.1, so that further sections are prefetched with both algorithms
+        standardCompressionAlgorithm = COMPRESSION_ALGORITHM_EFI11;
+    }
+    else { // Both are OK, but none passed preparse, keep Tiano result
+        algorithm = COMPRESSION_ALGORITHM_UNDECIDED;
+        decompressed = tianoDecompressed;
+    }
+    
+    return U_SUCCESS;
+}
+
+// Decompress a section body with a given method, method is one of the COMPRESSION_ALGORITHM_* values
+static USTATUS decompressWithMethod(const UByteArray & compressed, const UINT8 method, UINT8 & algorithm, UINT32 & dictionarySize, UByteArray & decompressed, UByteArray & efiDecompressed)
+{
+    switch (method) {
+        case COMPRESSION_ALGORITHM_EFI11:
+        case COMPRESSION_ALGORITHM_TIANO:
+            algorithm = method;
+            return standardDecompress(compressed, method, decompressed);
+        case COMPRESSION_ALGORITHM_LZMA:
+            return decompress(compressed, EFI_CUSTOMIZED_COMPRESSION, algorithm, dictionarySize, decompressed, efiDecompressed);
+        case COMPRESSION_ALGORITHM_LZMAF86:
+            return decompress(compressed, EFI_CUSTOMIZED_COMPRESSION_LZMAF86, algorithm, dictionarySize, decompressed, efiDecompressed);
+        case COMPRESSION_ALGORITHM_GZIP:
+            algorithm = method;
+            return gzipDecompress(compressed, decompressed);
+        case COMPRESSION_ALGORITHM_ZLIB:
+            algorithm = method;
+            return zlibDecompress(compressed, decompressed);
+    }
+    
+    return U_UNKNOWN_COMPRESSION_ALGORITHM;
+}
+
+USTATUS FfsParser::decompressSection(const UByteArray & compressed, const UModelIndex & index, const UINT8 method, UINT8 & algorithm, UINT32 & dictionarySize, UByteArray & decompressed, UByteArray & efiDecompressed)
+{
+    // Use the result prepared by a worker thread, if there is one for exactly this data
+    if (!decompressedSections.empty()) {
+        DECOMPRESSED_SECTION_KEY key(model->base(index), method);
+        std::map<DECOMPRESSED_SECTION_KEY, std::shared_ptr<DECOMPRESSED_SECTION> >::iterator it = decompressedSections.find(key);
+        if (it != decompressedSections.end() && it->second->compressed == compressed) {
+            std::shared_ptr<DECOMPRESSED_SECTION> section = it->second;
+            section->ready.wait();
+            algorithm = section->algorithm;
+            dictionarySize = section->dictionarySize;
+            decompressed = section->decompressed;
+            efiDecompressed = section->efiDecompressed;
+            
+            // Sections submitted before this one were skipped by parsing, so their slots can go to the next ones
+            dropPrefetched(key);
+            fillPrefetchWindow();
+            return section->result;
+        }
+    }
+    
+    return decompressWithMethod(compressed, method, algorithm, dictionarySize, decompressed, efiDecompressed);
+}
+
+void FfsParser::startPrefetch(const UModelIndex & index, const UINT8 ffsVersion, DECOMPRESSION_PREFETCH & volumePrefetch)
+{
+    // Sections of outer volumes are not used until this one is parsed, so no more of them are submitted meanwhile
+    volumePrefetch.outer = prefetch;
+    prefetch = NULL;
+    if (threadCount < 2)
+        return;
+    
+    // Collect compressed sections on the top level of all files that will be parsed by parseSections
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
+        if (model->type(current) != Types::File
+            || model->subtype(current) == EFI_FV_FILETYPE_PAD
+            || model->subtype(current) == EFI_FV_FILETYPE_RAW
+            || model->subtype(current) == EFI_FV_FILETYPE_ALL)
+            continue;
+        
+        UByteArray body = model->body(current);
+        UINT32 bodyBase = model->base(current) + (UINT32)model->header(current).size();
+        UINT32 sectionOffset = 0;
+        while (sectionOffset < (UINT32)body.size()) {
+            UINT32 sectionSize = getSectionSize(body, sectionOffset, ffsVersion);
+            if (sectionSize < sizeof(EFI_COMMON_SECTION_HEADER) || sectionSize > (UINT32)body.size() - sectionOffset)
+                break;
+            
+            // The header sizes here follow the common case, quirky sections will not match and will be decompressed during parsing
+            const EFI_COMMON_SECTION_HEADER* sectionHeader = (const EFI_COMMON_SECTION_HEADER*)(body.constData() + sectionOffset);
+            UINT32 headerSize = sizeof(EFI_COMMON_SECTION_HEADER);
+            if (ffsVersion == 3 && uint24ToUint32(sectionHeader->Size) == EFI_SECTION2_IS_USED)
+                headerSize = sizeof(EFI_COMMON_SECTION_HEADER2);
+            
+            UINT8 method = COMPRESSION_ALGORITHM_NONE;
+            UINT32 dataOffset = 0;
+            if (sectionHeader->Type == EFI_SECTION_COMPRESSION && sectionSize >= headerSize + sizeof(EFI_COMPRESSION_SECTION)) {
+                const EFI_COMPRESSION_SECTION* compressedSectionHeader = (const EFI_COMPRESSION_SECTION*)((const UINT8*)sectionHeader + headerSize);
+                if (compressedSectionHeader->CompressionType == EFI_STANDARD_COMPRESSION)
+                    method = COMPRESSION_ALGORITHM_TIANO;
+                else if (compressedSectionHeader->CompressionType == EFI_CUSTOMIZED_COMPRESSION)
+                    method = COMPRESSION_ALGORITHM_LZMA;
+                else if (compressedSectionHeader->CompressionType == EFI_CUSTOMIZED_COMPRESSION_LZMAF86)
+                    method = COMPRESSION_ALGORITHM_LZMAF86;
+                dataOffset = headerSize + sizeof(EFI_COMPRESSION_SECTION);
+            }
+            else if (sectionHeader->Type == EFI_SECTION_GUID_DEFINED && sectionSize >= headerSize + sizeof(EFI_GUID_DEFINED_SECTION)) {
+                const EFI_GUID_DEFINED_SECTION* guidDefinedSectionHeader = (const EFI_GUID_DEFINED_SECTION*)((const UINT8*)sectionHeader + headerSize);
+                UByteArray baGuid((const char*)&guidDefinedSectionHeader->SectionDefinitionGuid, sizeof(EFI_GUID));
+                if (baGuid == EFI_GUIDED_SECTION_TIANO)
+                    method = COMPRESSION_ALGORITHM_TIANO;
+                else if (baGuid == EFI_GUIDED_SECTION_LZMA || baGuid == EFI_GUIDED_SECTION_LZMA_HP)
+                    method = COMPRESSION_ALGORITHM_LZMA;
+                else if (baGuid == EFI_GUIDED_SECTION_LZMAF86)
+                    method = COMPRESSION_ALGORITHM_LZMAF86;
+                else if (baGuid == EFI_GUIDED_SECTION_GZIP)
+                    method = COMPRESSION_ALGORITHM_GZIP;
+                else if (baGuid == EFI_GUIDED_SECTION_ZLIB_AMD)
+                    method = COMPRESSION_ALGORITHM_ZLIB;
+                dataOffset = guidDefinedSectionHeader->DataOffset;
+            }
+            
+            if (method != COMPRESSION_ALGORITHM_NONE && dataOffset <= sectionSize) {
+                // Standard sections are decompressed with EFI 1.1 too once this image was found to use it
+                UINT8 methods[2] = { method, COMPRESSION_ALGORITHM_NONE };
+                if (method == COMPRESSION_ALGORITHM_TIANO && standardCompressionAlgorithm == COMPRESSION_ALGORITHM_EFI11)
+                    methods[1] = COMPRESSION_ALGORITHM_EFI11;
+                
+                for (int m = 0; m < 2 && methods[m] != COMPRESSION_ALGORITHM_NONE; m++) {
+                    volumePrefetch.candidates.push_back(std::make_pair(DECOMPRESSED_SECTION_KEY(bodyBase + sectionOffset, methods[m]),
+                                                                       body.mid(sectionOffset + dataOffset, sectionSize - dataOffset)));
+                }
+            }
+            
+            sectionOffset = ALIGN4(sectionOffset + sectionSize);
+        }
+    }
+    
+    // Small volumes are decompressed faster than worker threads can be started
+    UINTN compressedSize = 0;
+    for (size_t i = 0; i < volumePrefetch.candidates.size(); i++)
+        compressedSize += volumePrefetch.candidates[i].second.size();
+    if (volumePrefetch.candidates.size() < 2 || compressedSize < FFS_PARSER_PREFETCH_MIN_SIZE) {
+        volumePrefetch.candidates.clear();
+        return;
+    }
+    
+    // The parsing thread is busy with parsing, so the others decompress
+    if (!workerPool)
+        workerPool = new WorkerPool(threadCount - 1, 2 * (threadCount - 1));
+    prefetch = &volumePrefetch;
+    fillPrefetchWindow();
+}
+
+void FfsParser::fillPrefetchWindow()
+{
+    // Keep only a few decompressed sections of the current volume in memory at once
+    if (!prefetch)
+        return;
+    
+    const size_t windowSize = 2 * workerPool->maxThreadCount();
+    while (prefetch->pending.size() < windowSize && prefetch->next < prefetch->candidates.size()) {
+        const std::pair<DECOMPRESSED_SECTION_KEY, UByteArray> & candidate = prefetch->candidates[prefetch->next++];
+        if (decompressedSections.find(candidate.first) != decompressedSections.end())
+            continue;
+        
+        std::shared_ptr<DECOMPRESSED_SECTION> section = std::make_shared<DECOMPRESSED_SECTION>();
+        section->compressed = candidate.second;
+        decompressedSections[candidate.first] = section;
+        prefetch->pending.push_back(candidate.first);
+        
+        const UINT8 method = candidate.first.second;
+        workerPool->submit([section, method]() {
+            if (!section->cancelled.load(std::memory_order_relaxed))
+                section->result = decompressWithMethod(section->compressed, method, section->algorithm, section->dictionarySize, section->decompressed, section->efiDecompressed);
+            section->finished.set_value();
+        });
+    }
+}
+
+void FfsParser::dropPrefetched(const DECOMPRESSED_SECTION_KEY & last)
+{
+    // Drop the given section and all sections of the current volume submitted before it
+    if (prefetch && std::find(prefetch->pending.begin(), prefetch->pending.end(), last) != prefetch->pending.end()) {
+        for (;;) {
+            DECOMPRESSED_SECTION_KEY key = prefetch->pending.front();
+            prefetch->pending.pop_front();
+            std::map<DECOMPRESSED_SECTION_KEY, std::shared_ptr<DECOMPRESSED_SECTION> >::iterator it = decompressedSections.find(key);
+            if (it != decompressedSections.end()) {
+                it->second->cancelled.store(true, std::memory_order_relaxed);
+                decompressedSections.erase(it);
+            }
+            if (key == last)
+                break;
+        }
+    }
+    else {
+        decompressedSections.erase(last);
+    }
+}
+
+void FfsParser::finishPrefetch(DECOMPRESSION_PREFETCH & volumePrefetch)
+{
+    // Workers skip the sections that were not started yet, and release the results of the others when done
+    while (!volumePrefetch.pending.empty()) {
+        std::map<DECOMPRESSED_SECTION_KEY, std::shared_ptr<DECOMPRESSED_SECTION> >::iterator it = decompressedSections.find(volumePrefetch.pending.front());
+        if (it != decompressedSections.end()) {
+            it->second->cancelled.store(true, std::memory_order_relaxed);
+            decompressedSections.erase(it);
+        }
+        volumePrefetch.pending.pop_front();
+    }
+    prefetch = volumePrefetch.outer;
+}
+
 USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
 {
     // Sanity check
@@ -2833,7 +3345,7 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
     UByteArray baGuid = UByteArray((const char*)&guid, sizeof(EFI_GUID));
     // Tiano compressed section
     if (baGuid == EFI_GUIDED_SECTION_TIANO) {
-        USTATUS result = decompress(model->body(index), EFI_STANDARD_COMPRESSION, algorithm, dictionarySize, processed, efiDecompressed);
+        USTATUS result = decompressStandard(model->body(index), index, algorithm, processed);
         if (result) {
             msg(usprintf("%s: decompression failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
             return U_SUCCESS;
@@ -2841,19 +3353,8 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
         
         // Check for undecided compression algorithm, this is a special case
         if (algorithm == COMPRESSION_ALGORITHM_UNDECIDED) {
-            // Try preparse of sections decompressed with Tiano algorithm
-            if (U_SUCCESS == parseSections(processed, index, false)) {
-                algorithm = COMPRESSION_ALGORITHM_TIANO;
-            }
-            // Try preparse of sections decompressed with EFI 1.1 algorithm
-            else if (U_SUCCESS == parseSections(efiDecompressed, index, false)) {
-                algorithm = COMPRESSION_ALGORITHM_EFI11;
-                processed = efiDecompressed;
-            }
-            else {
-                msg(usprintf("%s: can't guess the correct decompression algorithm, both preparse steps are failed", __FUNCTION__), index);
-                parseCurrentSection = false;
-            }
+            msg(usprintf("%s: can't guess the correct decompression algorithm, both preparse steps are failed", __FUNCTION__), index);
+            parseCurrentSection = false;
         }
         
         info += UString("\nCompression algorithm: ") + compressionTypeToUString(algorithm);
@@ -2862,7 +3363,7 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
     // LZMA compressed section
     else if (baGuid == EFI_GUIDED_SECTION_LZMA
              || baGuid == EFI_GUIDED_SECTION_LZMA_HP) {
-        USTATUS result = decompress(model->body(index), EFI_CUSTOMIZED_COMPRESSION, algorithm, dictionarySize, processed, efiDecompressed);
+        USTATUS result = decompressSection(model->body(index), index, COMPRESSION_ALGORITHM_LZMA, algorithm, dictionarySize, processed, efiDecompressed);
         if (result) {
             msg(usprintf("%s: decompression failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
             return U_SUCCESS;
@@ -2880,7 +3381,7 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
     }
     // LZMAF86 compressed section
     else if (baGuid == EFI_GUIDED_SECTION_LZMAF86) {
-        USTATUS result = decompress(model->body(index), EFI_CUSTOMIZED_COMPRESSION_LZMAF86, algorithm, dictionarySize, processed, efiDecompressed);
+        USTATUS result = decompressSection(model->body(index), index, COMPRESSION_ALGORITHM_LZMAF86, algorithm, dictionarySize, processed, efiDecompressed);
         if (result) {
             msg(usprintf("%s: decompression failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
             return U_SUCCESS;
@@ -2898,7 +3399,7 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
     }
     // GZip compressed section
     else if (baGuid == EFI_GUIDED_SECTION_GZIP) {
-        USTATUS result = gzipDecompress(model->body(index), processed);
+        USTATUS result = decompressSection(model->body(index), index, COMPRESSION_ALGORITHM_GZIP, algorithm, dictionarySize, processed, efiDecompressed);
         if (result) {
             msg(usprintf("%s: decompression failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
             return U_SUCCESS;
@@ -2910,7 +3411,7 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
     }
     // Zlib compressed section
     else if (baGuid == EFI_GUIDED_SECTION_ZLIB_AMD) {
-        USTATUS result = zlibDecompress(model->body(index), processed);
+        USTATUS result = decompressSection(model->body(index), index, COMPRESSION_ALGORITHM_ZLIB, algorithm, dictionarySize, processed, efiDecompressed);
         if (result) {
             msg(usprintf("%s: decompression failed with error ", __FUNCTION__) + errorCodeToUString(result), index);
             return U_SUCCESS;
@@ -2927,7 +3428,7 @@ USTATUS FfsParser::parseGuidedSectionBody(const UModelIndex & index)
     // Set parsing data
     GUIDED_SECTION_PARSING_DATA pdata = {};
     pdata.dictionarySize = dictionarySize;
-    model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+    model->setParsingData(index, &pdata, sizeof(pdata));
     
     // Set compression data
     if (algorithm != COMPRESSION_ALGORITHM_NONE) {
@@ -2950,7 +3451,8 @@ USTATUS FfsParser::parseVersionSectionBody(const UModelIndex & index)
         return U_INVALID_PARAMETER;
     
     // Add info
-    model->addInfo(index, UString("\nVersion string: ") + uFromUcs2(model->body(index).constData()));
+    UByteArray body = model->body(index);
+    model->addInfo(index, UString("\nVersion string: ") + uFromUcs2(body.constData(), body.size() / 2));
     
     return U_SUCCESS;
 }
@@ -3087,7 +3589,8 @@ USTATUS FfsParser::parseUiSectionBody(const UModelIndex & index)
     if (!index.isValid())
         return U_INVALID_PARAMETER;
     
-    UString text = uFromUcs2(model->body(index).constData());
+    UByteArray body = model->body(index);
+    UString text = uFromUcs2(body.constData(), body.size() / 2);
     
     // Add info
     model->addInfo(index, UString("\nText: ") + text);
@@ -3291,7 +3794,7 @@ USTATUS FfsParser::parseTeImageSectionBody(const UModelIndex & index)
     pdata.imageBaseType = EFI_IMAGE_TE_BASE_OTHER; // Will be determined later
     pdata.originalImageBase = (UINT32)teHeader->ImageBase;
     pdata.adjustedImageBase = (UINT32)(teHeader->ImageBase + teHeader->StrippedSize - sizeof(EFI_IMAGE_TE_HEADER));
-    model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+    model->setParsingData(index, &pdata, sizeof(pdata));
     
     // Add TE info
     model->addInfo(index, info);
@@ -3419,13 +3922,13 @@ USTATUS FfsParser::checkTeImageBase(const UModelIndex & index)
             pdata.imageBaseType = imageBaseType;
             pdata.originalImageBase = originalImageBase;
             pdata.adjustedImageBase = adjustedImageBase;
-            model->setParsingData(index, UByteArray((const char*)&pdata, sizeof(pdata)));
+            model->setParsingData(index, &pdata, sizeof(pdata));
         }
     }
     
     // Process child items
-    for (int i = 0; i < model->rowCount(index); i++) {
-        checkTeImageBase(index.model()->index(i, 0, index));
+    for (int i = 0; i < model->childCount(index); i++) {
+        checkTeImageBase(model->childIndex(i, index));
     }
     
     return U_SUCCESS;
@@ -3437,106 +3940,107 @@ USTATUS FfsParser::addInfoRecursive(const UModelIndex & index)
     if (!index.isValid())
         return U_INVALID_PARAMETER;
     
-    // Add offset
-    model->addInfo(index, usprintf("Offset: %Xh\n", model->offset(index)), false);
-    
-    // Add current base if the element is not compressed
-    // or it's compressed, but its parent isn't
-    if ((!model->compressed(index)) || (index.parent().isValid() && !model->compressed(index.parent()))) {
-        // Add physical address of the whole item or its header and data portions separately
-        UINT64 address = addressDiff + model->base(index);
-        if (address <= 0xFFFFFFFFUL) {
-            UINT32 headerSize = (UINT32)model->header(index).size();
-            if (headerSize) {
-                model->addInfo(index, usprintf("Data address: %08Xh\n", (UINT32)address + headerSize),false);
-                model->addInfo(index, usprintf("Header address: %08Xh\n", (UINT32)address), false);
-            }
-            else {
-                model->addInfo(index, usprintf("Address: %08Xh\n", (UINT32)address), false);
-            }
-        }
-        // Add base
-        model->addInfo(index, usprintf("Base: %Xh\n", model->base(index)), false);
-    }
-    model->addInfo(index, usprintf("Fixed: %s\n", model->fixed(index) ? "Yes" : "No"), false);
+    // Add offset, base and physical address, the info text for them is generated on request
+    // Base is meaningful only if the element is not compressed, or it's compressed, but its parent isn't
+    bool hasBase = model->hasFlatBase(index);
+    UINT64 address = addressDiff + model->base(index);
+    model->setLocationInfo(index, hasBase, address <= 0xFFFFFFFFUL, (UINT32)address);
     
     // Process child items
-    for (int i = 0; i < model->rowCount(index); i++) {
-        addInfoRecursive(index.model()->index(i, 0, index));
+    for (int i = 0; i < model->childCount(index); i++) {
+        addInfoRecursive(model->childIndex(i, index));
     }
     
     return U_SUCCESS;
 }
 
+// Calculate the digest of an image range with a TCG hash algorithm, the range is hashed in place
+// Returns false and leaves the digest as is if the algorithm is unknown
+static bool calculateTcgDigest(const UByteArray & image, const UINT32 offset, const UINT32 size, const UINT16 algorithmId, UByteArray & digest)
+{
+    std::vector<std::pair<UINT32, UINT32> > ranges(1, std::make_pair(offset, size));
+    DIGESTS digests;
+    switch (algorithmId) {
+        case TCG_HASH_ALGORITHM_ID_SHA1:
+            calculateDigests(image, ranges, DIGEST_ALGORITHM_SHA1, digests);
+            digest = digests.sha1;
+            return true;
+        case TCG_HASH_ALGORITHM_ID_SHA256:
+            calculateDigests(image, ranges, DIGEST_ALGORITHM_SHA256, digests);
+            digest = digests.sha256;
+            return true;
+        case TCG_HASH_ALGORITHM_ID_SHA384:
+            calculateDigests(image, ranges, DIGEST_ALGORITHM_SHA384, digests);
+            digest = digests.sha384;
+            return true;
+        case TCG_HASH_ALGORITHM_ID_SHA512:
+            calculateDigests(image, ranges, DIGEST_ALGORITHM_SHA512, digests);
+            digest = digests.sha512;
+            return true;
+        case TCG_HASH_ALGORITHM_ID_SM3:
+            calculateDigests(image, ranges, DIGEST_ALGORITHM_SM3, digests);
+            digest = digests.sm3;
+            return true;
+    }
+    return false;
+}
+
+// Checks that the whole protected range is inside the opened image
+bool FfsParser::isProtectedRangeInImage(const PROTECTED_RANGE & range) const
+{
+    return (UINT64)range.Offset + (UINT64)range.Size <= (UINT64)openedImage.size();
+}
+
 USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
 {
     // Sanity check
     if (!index.isValid())
         return U_INVALID_PARAMETER;
     
-    // QByteArray (Qt builds) supports obtaining data from invalid offsets in QByteArray,
-    // so mid() here doesn't throw anything for UEFITool, just returns ranges with all zeroes
-    // UByteArray (non-Qt builds) throws an exception that needs to be caught every time or the tools will crash.
+    // Ranges that are not fully inside the opened image are skipped, they are likely not found in it
     
     // Calculate digest for BG-protected ranges
-    UByteArray protectedParts;
+    std::vector<std::pair<UINT32, UINT32> > ibbRanges;
+    std::vector<UINT32> markedRanges;
     bool bgProtectedRangeFound = false;
-    try {
-        for (UINT32 i = 0; i < (UINT32)protectedRanges.size(); i++) {
-            if (protectedRanges[i].Type == PROTECTED_RANGE_INTEL_BOOT_GUARD_IBB) {
-                bgProtectedRangeFound = true;
-                if ((UINT64)protectedRanges[i].Offset >= addressDiff) {
-                    protectedRanges[i].Offset -= (UINT32)addressDiff;
-                } else {
-                    msg(usprintf("%s: suspicious protected range offset", __FUNCTION__), index);
-                }
-                protectedParts += openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-                markProtectedRangeRecursive(index, protectedRanges[i]);
+    for (UINT32 i = 0; i < (UINT32)protectedRanges.size(); i++) {
+        if (protectedRanges[i].Type == PROTECTED_RANGE_INTEL_BOOT_GUARD_IBB) {
+            bgProtectedRangeFound = true;
+            if ((UINT64)protectedRanges[i].Offset >= addressDiff) {
+                protectedRanges[i].Offset -= (UINT32)addressDiff;
+            } else {
+                msg(usprintf("%s: suspicious protected range offset", __FUNCTION__), index);
+            }
+            if (!isProtectedRangeInImage(protectedRanges[i])) {
+                bgProtectedRangeFound = false;
+                break;
             }
+            ibbRanges.push_back(std::make_pair(protectedRanges[i].Offset, protectedRanges[i].Size));
+            markedRanges.push_back(i);
         }
-    } catch (...) {
-        bgProtectedRangeFound = false;
     }
     
     if (bgProtectedRangeFound) {
-        UINT8 digest[SHA512_HASH_SIZE] = {};
-        UString digestString;
+        // Hash all IBB ranges in place with every algorithm at once
+        DIGESTS digests;
+        calculateDigests(openedImage, ibbRanges, DIGEST_ALGORITHM_SHA1 | DIGEST_ALGORITHM_SHA256 | DIGEST_ALGORITHM_SHA384 | DIGEST_ALGORITHM_SHA512 | DIGEST_ALGORITHM_SM3, digests);
+        
+        const std::pair<const char*, const UByteArray*> ibbHashes[] = {
+            std::make_pair("SHA1", &digests.sha1),
+            std::make_pair("SHA256", &digests.sha256),
+            std::make_pair("SHA384", &digests.sha384),
+            std::make_pair("SHA512", &digests.sha512),
+            std::make_pair("SM3", &digests.sm3)
+        };
         UString ibbDigests;
-        // SHA1
-        digestString = "";
-        sha1(protectedParts.constData(), protectedParts.size(), digest);
-        for (UINT8 i = 0; i < SHA1_HASH_SIZE; i++) {
-            digestString += usprintf("%02X", digest[i]);
-        }
-        ibbDigests += UString("Computed IBB Hash (SHA1): ") + digestString + "\n";
-        // SHA256
-        digestString = "";
-        sha256(protectedParts.constData(), protectedParts.size(), digest);
-        for (UINT8 i = 0; i < SHA256_HASH_SIZE; i++) {
-            digestString += usprintf("%02X", digest[i]);
-        }
-        ibbDigests += UString("Computed IBB Hash (SHA256): ") + digestString + "\n";
-        // SHA384
-        digestString = "";
-        sha384(protectedParts.constData(), protectedParts.size(), digest);
-        for (UINT8 i = 0; i < SHA384_HASH_SIZE; i++) {
-            digestString += usprintf("%02X", digest[i]);
-        }
-        ibbDigests += UString("Computed IBB Hash (SHA384): ") + digestString + "\n";
-        // SHA512
-        digestString = "";
-        sha512(protectedParts.constData(), protectedParts.size(), digest);
-        for (UINT8 i = 0; i < SHA512_HASH_SIZE; i++) {
-            digestString += usprintf("%02X", digest[i]);
-        }
-        ibbDigests += UString("Computed IBB Hash (SHA512): ") + digestString + "\n";
-        // SM3
-        digestString = "";
-        sm3(protectedParts.constData(), protectedParts.size(), digest);
-        for (UINT8 i = 0; i < SM3_HASH_SIZE; i++) {
-            digestString += usprintf("%02X", digest[i]);
-        }
-        ibbDigests += UString("Computed IBB Hash (SM3): ") + digestString + "\n";
+        for (size_t i = 0; i < sizeof(ibbHashes) / sizeof(ibbHashes[0]); i++) {
+            UString digestString;
+            const UByteArray & digest = *ibbHashes[i].second;
+            for (int j = 0; j < digest.size(); j++) {
+                digestString += usprintf("%02X", (UINT8)digest.at(j));
+            }
+            ibbDigests += UString("Computed IBB Hash (") + UString(ibbHashes[i].first) + UString("): ") + digestString + "\n";
+        }
         
         securityInfo += ibbDigests + "\n";
     }
@@ -3554,34 +4058,12 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                     msg(usprintf("%s: can't determine DXE volume offset, post-IBB protected range hash can't be checked", __FUNCTION__), index);
                 }
                 else {
-                    try {
-                        protectedRanges[i].Offset = model->base(dxeRootVolumeIndex);
-                        protectedRanges[i].Size = (UINT32)(model->header(dxeRootVolumeIndex).size() + model->body(dxeRootVolumeIndex).size() + model->tail(dxeRootVolumeIndex).size());
-                        protectedParts = openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-                        
+                    protectedRanges[i].Offset = model->base(dxeRootVolumeIndex);
+                    protectedRanges[i].Size = (UINT32)(model->header(dxeRootVolumeIndex).size() + model->body(dxeRootVolumeIndex).size() + model->tail(dxeRootVolumeIndex).size());
+                    if (isProtectedRangeInImage(protectedRanges[i])) {
                         // Calculate the hash
                         UByteArray digest(SHA512_HASH_SIZE, '\x00');
-                        if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA1) {
-                            sha1(protectedParts.constData(), protectedParts.size(), digest.data());
-                            digest = digest.left(SHA1_HASH_SIZE);
-                        }
-                        else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA256) {
-                            sha256(protectedParts.constData(), protectedParts.size(), digest.data());
-                            digest = digest.left(SHA256_HASH_SIZE);
-                        }
-                        else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA384) {
-                            sha384(protectedParts.constData(), protectedParts.size(), digest.data());
-                            digest = digest.left(SHA384_HASH_SIZE);
-                        }
-                        else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA512) {
-                            sha512(protectedParts.constData(), protectedParts.size(), digest.data());
-                            digest = digest.left(SHA512_HASH_SIZE);
-                        }
-                        else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SM3) {
-                            sm3(protectedParts.constData(), protectedParts.size(), digest.data());
-                            digest = digest.left(SM3_HASH_SIZE);
-                        }
-                        else {
+                        if (!calculateTcgDigest(openedImage, protectedRanges[i].Offset, protectedRanges[i].Size, protectedRanges[i].AlgorithmId, digest)) {
                             msg(usprintf("%s: post-IBB protected range [%Xh:%Xh] uses unknown hash algorithm %04Xh", __FUNCTION__,
                                          protectedRanges[i].Offset, protectedRanges[i].Offset + protectedRanges[i].Size, protectedRanges[i].AlgorithmId),
                                 model->findByBase(protectedRanges[i].Offset));
@@ -3594,10 +4076,7 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                                 model->findByBase(protectedRanges[i].Offset));
                         }
                         
-                        markProtectedRangeRecursive(index, protectedRanges[i]);
-                    }
-                    catch(...) {
-                        // Do nothing, this range is likely not found in the image
+                        markedRanges.push_back(i);
                     }
                 }
             }
@@ -3613,12 +4092,10 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                     msg(usprintf("%s: can't determine DXE volume offset, AMI v1 protected range hash can't be checked", __FUNCTION__), index);
                 }
                 else {
-                    try {
-                        protectedRanges[i].Offset = model->base(dxeRootVolumeIndex);
-                        protectedParts = openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-
-                        UByteArray digest(SHA256_HASH_SIZE, '\x00');
-                        sha256(protectedParts.constData(), protectedParts.size(), digest.data());
+                    protectedRanges[i].Offset = model->base(dxeRootVolumeIndex);
+                    if (isProtectedRangeInImage(protectedRanges[i])) {
+                        UByteArray digest;
+                        calculateTcgDigest(openedImage, protectedRanges[i].Offset, protectedRanges[i].Size, TCG_HASH_ALGORITHM_ID_SHA256, digest);
 
                         if (digest != protectedRanges[i].Hash) {
                             msg(usprintf("%s: AMI v1 protected range [%Xh:%Xh] hash mismatch, opened image may refuse to boot", __FUNCTION__,
@@ -3626,21 +4103,16 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                                 model->findByBase(protectedRanges[i].Offset));
                         }
 
-                        markProtectedRangeRecursive(index, protectedRanges[i]);
-                    }
-                    catch (...) {
-                        // Do nothing, this range is likely not found in the image
+                        markedRanges.push_back(i);
                     }
                 }
             }
         }
         else if (protectedRanges[i].Type == PROTECTED_RANGE_VENDOR_HASH_AMI_V2) {
-            try {
-                protectedRanges[i].Offset -= (UINT32)addressDiff;
-                protectedParts = openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-                
-                UByteArray digest(SHA256_HASH_SIZE, '\x00');
-                sha256(protectedParts.constData(), protectedParts.size(), digest.data());
+            protectedRanges[i].Offset -= (UINT32)addressDiff;
+            if (isProtectedRangeInImage(protectedRanges[i])) {
+                UByteArray digest;
+                calculateTcgDigest(openedImage, protectedRanges[i].Offset, protectedRanges[i].Size, TCG_HASH_ALGORITHM_ID_SHA256, digest);
                 
                 if (digest != protectedRanges[i].Hash) {
                     msg(usprintf("%s: AMI v2 protected range [%Xh:%Xh] hash mismatch, opened image may refuse to boot", __FUNCTION__,
@@ -3648,63 +4120,38 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                         model->findByBase(protectedRanges[i].Offset));
                 }
                 
-                markProtectedRangeRecursive(index, protectedRanges[i]);
-            }
-            catch(...) {
-                // Do nothing, this range is likely not found in the image
+                markedRanges.push_back(i);
             }
         }
         else if (protectedRanges[i].Type == PROTECTED_RANGE_VENDOR_HASH_AMI_V3) {
-            try {
+            // Up to four consecutive ranges are hashed together, the check is skipped if any of them is outside of the image
+            std::vector<std::pair<UINT32, UINT32> > amiRanges;
+            bool amiRangesInImage = true;
+            UINT32 first = i;
+            for (; i < (UINT32)protectedRanges.size() && i < first + 4 && protectedRanges[i].Type == PROTECTED_RANGE_VENDOR_HASH_AMI_V3; i++) {
                 protectedRanges[i].Offset -= (UINT32)addressDiff;
-                protectedParts = openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-                markProtectedRangeRecursive(index, protectedRanges[i]);
-
-                // Process second range
-                if (i + 1 < (UINT32)protectedRanges.size() && protectedRanges[i + 1].Type == PROTECTED_RANGE_VENDOR_HASH_AMI_V3) {
-                    protectedRanges[i + 1].Offset -= (UINT32)addressDiff;
-                    protectedParts += openedImage.mid(protectedRanges[i + 1].Offset, protectedRanges[i + 1].Size);
-                    markProtectedRangeRecursive(index, protectedRanges[i + 1]);
-
-                    // Process third range
-                    if (i + 2 < (UINT32)protectedRanges.size() && protectedRanges[i + 2].Type == PROTECTED_RANGE_VENDOR_HASH_AMI_V3) {
-                        protectedRanges[i + 2].Offset -= (UINT32)addressDiff;
-                        protectedParts += openedImage.mid(protectedRanges[i + 2].Offset, protectedRanges[i + 2].Size);
-                        markProtectedRangeRecursive(index, protectedRanges[i + 2]);
-
-                        // Process fourth range
-                        if (i + 3 < (UINT32)protectedRanges.size() && protectedRanges[i + 3].Type == PROTECTED_RANGE_VENDOR_HASH_AMI_V3) {
-                            protectedRanges[i + 3].Offset -= (UINT32)addressDiff;
-                            protectedParts += openedImage.mid(protectedRanges[i + 3].Offset, protectedRanges[i + 3].Size);
-                            markProtectedRangeRecursive(index, protectedRanges[i + 3]);
-                            i += 3; // Skip 3 already processed ranges
-                        }
-                        else {
-                            i += 2; // Skip 2 already processed ranges
-                        }
-                    }
-                    else {
-                        i += 1;  // Skip 1 already processed range
-                    }
+                amiRangesInImage = amiRangesInImage && isProtectedRangeInImage(protectedRanges[i]);
+                amiRanges.push_back(std::make_pair(protectedRanges[i].Offset, protectedRanges[i].Size));
+            }
+            i--; // Skip already processed ranges
+            
+            if (amiRangesInImage) {
+                for (UINT32 j = first; j <= i; j++) {
+                    markedRanges.push_back(j);
                 }
-
-                UByteArray digest(SHA256_HASH_SIZE, '\x00');
-                sha256(protectedParts.constData(), protectedParts.size(), digest.data());
-                if (digest != protectedRanges[i].Hash) {
+                
+                DIGESTS digests;
+                calculateDigests(openedImage, amiRanges, DIGEST_ALGORITHM_SHA256, digests);
+                if (digests.sha256 != protectedRanges[i].Hash) {
                     msg(usprintf("%s: AMI v3 protected ranges hash mismatch, opened image may refuse to boot", __FUNCTION__));
                 }
             }
-            catch (...) {
-                // Do nothing, this range is likely not found in the image
-            }
         }
         else if (protectedRanges[i].Type == PROTECTED_RANGE_VENDOR_HASH_PHOENIX) {
-            try {
-                protectedRanges[i].Offset += (UINT32)protectedRegionsBase;
-                protectedParts = openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-                
-                UByteArray digest(SHA256_HASH_SIZE, '\x00');
-                sha256(protectedParts.constData(), protectedParts.size(), digest.data());
+            protectedRanges[i].Offset += (UINT32)protectedRegionsBase;
+            if (isProtectedRangeInImage(protectedRanges[i])) {
+                UByteArray digest;
+                calculateTcgDigest(openedImage, protectedRanges[i].Offset, protectedRanges[i].Size, TCG_HASH_ALGORITHM_ID_SHA256, digest);
                 
                 if (digest != protectedRanges[i].Hash) {
                     msg(usprintf("%s: Phoenix protected range [%Xh:%Xh] hash mismatch, opened image may refuse to boot", __FUNCTION__,
@@ -3712,40 +4159,15 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                         model->findByBase(protectedRanges[i].Offset));
                 }
                 
-                markProtectedRangeRecursive(index, protectedRanges[i]);
-            }
-            catch(...) {
-                // Do nothing, this range is likely not found in the image
+                markedRanges.push_back(i);
             }
         }
         else if (protectedRanges[i].Type == PROTECTED_RANGE_VENDOR_HASH_MICROSOFT_PMDA) {
-            try {
-                protectedRanges[i].Offset -= (UINT32)addressDiff;
-                protectedParts = openedImage.mid(protectedRanges[i].Offset, protectedRanges[i].Size);
-                
+            protectedRanges[i].Offset -= (UINT32)addressDiff;
+            if (isProtectedRangeInImage(protectedRanges[i])) {
                 // Calculate the hash
                 UByteArray digest(SHA512_HASH_SIZE, '\x00');
-                if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA1) {
-                    sha1(protectedParts.constData(), protectedParts.size(), digest.data());
-                    digest = digest.left(SHA1_HASH_SIZE);
-                }
-                else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA256) {
-                    sha256(protectedParts.constData(), protectedParts.size(), digest.data());
-                    digest = digest.left(SHA256_HASH_SIZE);
-                }
-                else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA384) {
-                    sha384(protectedParts.constData(), protectedParts.size(), digest.data());
-                    digest = digest.left(SHA384_HASH_SIZE);
-                }
-                else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SHA512) {
-                    sha512(protectedParts.constData(), protectedParts.size(), digest.data());
-                    digest = digest.left(SHA512_HASH_SIZE);
-                }
-                else if (protectedRanges[i].AlgorithmId == TCG_HASH_ALGORITHM_ID_SM3) {
-                    sm3(protectedParts.constData(), protectedParts.size(), digest.data());
-                    digest = digest.left(SM3_HASH_SIZE);
-                }
-                else {
+                if (!calculateTcgDigest(openedImage, protectedRanges[i].Offset, protectedRanges[i].Size, protectedRanges[i].AlgorithmId, digest)) {
                     msg(usprintf("%s: Microsoft PMDA protected range [%Xh:%Xh] uses unknown hash algorithm %04Xh", __FUNCTION__,
                                  protectedRanges[i].Offset, protectedRanges[i].Offset + protectedRanges[i].Size, protectedRanges[i].AlgorithmId),
                         model->findByBase(protectedRanges[i].Offset));
@@ -3758,34 +4180,81 @@ USTATUS FfsParser::checkProtectedRanges(const UModelIndex & index)
                         model->findByBase(protectedRanges[i].Offset));
                 }
                 
-                markProtectedRangeRecursive(index, protectedRanges[i]);
+                markedRanges.push_back(i);
             }
-            catch(...) {
-                // Do nothing, this range is likely not found in the image
+        }
+    }
+    
+    // Mark all tree items covered by the ranges checked above
+    return markProtectedRanges(index, markedRanges);
+}
+
+USTATUS FfsParser::markProtectedRanges(const UModelIndex & index, const std::vector<UINT32> & rangeIndices)
+{
+    if (!index.isValid() || rangeIndices.empty())
+        return U_SUCCESS;
+    
+    // Split the image into elementary segments between sorted range boundaries,
+    // ranges with zero or wrapping size can't overlap anything and are skipped
+    std::vector<UINT32> boundaries;
+    boundaries.reserve(2 * rangeIndices.size());
+    for (size_t i = 0; i < rangeIndices.size(); i++) {
+        const PROTECTED_RANGE & range = protectedRanges[rangeIndices[i]];
+        if (range.Offset + range.Size > range.Offset) {
+            boundaries.push_back(range.Offset);
+            boundaries.push_back(range.Offset + range.Size);
+        }
+    }
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+    
+    // Each segment is owned by the last marked range that covers it, as later ranges override earlier ones
+    std::vector<INT32> segmentRanges(boundaries.empty() ? 0 : boundaries.size() - 1, -1);
+    for (size_t i = 0; i < rangeIndices.size(); i++) {
+        const PROTECTED_RANGE & range = protectedRanges[rangeIndices[i]];
+        if (range.Offset + range.Size > range.Offset) {
+            size_t first = std::lower_bound(boundaries.begin(), boundaries.end(), range.Offset) - boundaries.begin();
+            size_t last = std::lower_bound(boundaries.begin(), boundaries.end(), range.Offset + range.Size) - boundaries.begin();
+            for (size_t j = first; j < last; j++) {
+                segmentRanges[j] = (INT32)i;
             }
         }
     }
     
-    return U_SUCCESS;
+    return markProtectedRangesRecursive(index, rangeIndices, boundaries, segmentRanges);
 }
 
-USTATUS FfsParser::markProtectedRangeRecursive(const UModelIndex & index, const PROTECTED_RANGE & range)
+USTATUS FfsParser::markProtectedRangesRecursive(const UModelIndex & index, const std::vector<UINT32> & rangeIndices, const std::vector<UINT32> & boundaries, const std::vector<INT32> & segmentRanges)
 {
     if (!index.isValid())
         return U_SUCCESS;
     
     // Mark compressed items
     UModelIndex parentIndex = model->parent(index);
-    if (parentIndex.isValid() && model->compressed(index) && model->compressed(parentIndex)) {
+    if (parentIndex.isValid() && !model->hasFlatBase(index)) {
         model->setMarking(index, model->marking(parentIndex));
     }
     // Mark normal items
     else {
         UINT32 currentOffset = model->base(index);
-        UINT32 currentSize = (UINT32)(model->header(index).size() + model->body(index).size() + model->tail(index).size());
+        UINT32 currentSize = (UINT32)(model->header(index).size() + model->bodySize(index) + model->tail(index).size());
+        UINT32 currentEnd = currentOffset + currentSize;
+        
+        // Find the last marked range among the ones overlapping this item
+        INT32 last = -1;
+        if (currentEnd > currentOffset && !segmentRanges.empty()) {
+            size_t segment = std::upper_bound(boundaries.begin(), boundaries.end(), currentOffset) - boundaries.begin();
+            if (segment > 0)
+                segment--;
+            for (; segment < segmentRanges.size() && boundaries[segment] < currentEnd; segment++) {
+                if (boundaries[segment + 1] > currentOffset && segmentRanges[segment] > last)
+                    last = segmentRanges[segment];
+            }
+        }
         
-        if (std::min(currentOffset + currentSize, range.Offset + range.Size) > std::max(currentOffset, range.Offset)) {
-            if (range.Offset <= currentOffset && currentOffset + currentSize <= range.Offset + range.Size) { // Mark as fully in range
+        if (last >= 0) {
+            const PROTECTED_RANGE & range = protectedRanges[rangeIndices[last]];
+            if (range.Offset <= currentOffset && currentEnd <= range.Offset + range.Size) { // Mark as fully in range
                 if (range.Type == PROTECTED_RANGE_INTEL_BOOT_GUARD_IBB) {
                     model->setMarking(index, BootGuardMarking::BootGuardFullyInRange);
                 }
@@ -3799,8 +4268,8 @@ USTATUS FfsParser::markProtectedRangeRecursive(const UModelIndex & index, const
         }
     }
     
-    for (int i = 0; i < model->rowCount(index); i++) {
-        markProtectedRangeRecursive(index.model()->index(i, 0, index), range);
+    for (int i = 0; i < model->childCount(index); i++) {
+        markProtectedRangesRecursive(model->childIndex(i, index), rangeIndices, boundaries, segmentRanges);
     }
     
     return U_SUCCESS;
@@ -3995,7 +4464,7 @@ USTATUS FfsParser::parseMicrocodeVolumeBody(const UModelIndex & index)
         UByteArray ucode = model->body(index).mid(offset);
         
         // Check for empty area
-        if (ucode.size() == ucode.count('\xFF') || ucode.size() == ucode.count('\x00')) {
+        if (allBytesEqual(ucode, 0xFF) || allBytesEqual(ucode, 0x00)) {
             result = U_INVALID_MICROCODE;
         }
         else {
@@ -4908,20 +5377,24 @@ USTATUS FfsParser::parseSignedPackageInfoData(const UModelIndex & index)
 }
 
 void FfsParser::outputInfo(void) {
+    outputInfo(std::cout);
+}
+
+void FfsParser::outputInfo(std::ostream & stream) {
     // Show ffsParser's messages
     std::vector<std::pair<UString, UModelIndex> > messages = getMessages();
     for (size_t i = 0; i < messages.size(); i++) {
-        std::cout << (const char *)messages[i].first.toLocal8Bit() << std::endl;
+        stream << (const char *)messages[i].first.toLocal8Bit() << std::endl;
     }
     
     // Get last VTF
     std::vector<std::pair<std::vector<UString>, UModelIndex > > fitTable = getFitTable();
     if (fitTable.size()) {
-        std::cout << "---------------------------------------------------------------------------" << std::endl;
-        std::cout << "     Address      |   Size    |  Ver  | CS  |          Type / Info          " << std::endl;
-        std::cout << "---------------------------------------------------------------------------" << std::endl;
+        stream << "---------------------------------------------------------------------------" << std::endl;
+        stream << "     Address      |   Size    |  Ver  | CS  |          Type / Info          " << std::endl;
+        stream << "---------------------------------------------------------------------------" << std::endl;
         for (size_t i = 0; i < fitTable.size(); i++) {
-            std::cout
+            stream
             << (const char *)fitTable[i].first[0].toLocal8Bit() << " | "
             << (const char *)fitTable[i].first[1].toLocal8Bit() << " | "
             << (const char *)fitTable[i].first[2].toLocal8Bit() << " | "
@@ -4934,9 +5407,9 @@ void FfsParser::outputInfo(void) {
     // Get security info
     UString secInfo = getSecurityInfo();
     if (!secInfo.isEmpty()) {
-        std::cout << "---------------------------------------------------------------------------"  << std::endl;
-        std::cout << "Security Info" << std::endl;
-        std::cout << "---------------------------------------------------------------------------"  << std::endl;
-        std::cout << (const char *)secInfo.toLocal8Bit() << std::endl;
+        stream << "---------------------------------------------------------------------------"  << std::endl;
+        stream << "Security Info" << std::endl;
+        stream << "---------------------------------------------------------------------------"  << std::endl;
+        stream << (const char *)secInfo.toLocal8Bit() << std::endl;
     }
 }
@@ -14,6 +14,13 @@ WITHWARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define FFSPARSER_H
 
 #include <vector>
+#include <map>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <iosfwd>
 
 #include "basetypes.h"
 #include "ustring.h"
@@ -59,6 +66,40 @@ typedef struct PROTECTED_RANGE_ {
     UByteArray Hash;
 } PROTECTED_RANGE;
 
+// Section body decompressed ahead of parsing by a worker thread, results can be read once ready is set
+typedef struct DECOMPRESSED_SECTION_ {
+    UByteArray compressed;
+    USTATUS    result = U_SUCCESS;
+    UINT8      algorithm = COMPRESSION_ALGORITHM_NONE;
+    UINT32     dictionarySize = 0;
+    UByteArray decompressed;
+    UByteArray efiDecompressed;
+    std::atomic<bool>  cancelled{ false };
+    std::promise<void> finished;
+    std::future<void>  ready = finished.get_future();
+} DECOMPRESSED_SECTION;
+
+// Section base and decompression method
+typedef std::pair<UINT32, UINT8> DECOMPRESSED_SECTION_KEY;
+
+// Minimal total size of compressed sections of a volume worth decompressing on worker threads
+#define FFS_PARSER_PREFETCH_MIN_SIZE 0x10000
+
+// Compressed sections of a volume, decompressed ahead of parsing a few at a time
+typedef struct DECOMPRESSION_PREFETCH_ {
+    std::vector<std::pair<DECOMPRESSED_SECTION_KEY, UByteArray> > candidates;
+    size_t next = 0;
+    std::deque<DECOMPRESSED_SECTION_KEY> pending; // Submitted and not used yet, in order of submission
+    struct DECOMPRESSION_PREFETCH_* outer = NULL; // Prefetch of the volume this one is nested in
+} DECOMPRESSION_PREFETCH;
+
+// Section headers found by a successful preparse, built under a stand-in of their parent until the final parsing of the same data
+typedef struct PREPARSED_SECTIONS_ {
+    UModelIndex standIn;
+    UByteArray  sections;
+    std::vector<std::pair<UString, UModelIndex> > messages;
+} PREPARSED_SECTIONS;
+
 #define PROTECTED_RANGE_INTEL_BOOT_GUARD_IBB       0x01
 #define PROTECTED_RANGE_INTEL_BOOT_GUARD_POST_IBB  0x02
 #define PROTECTED_RANGE_INTEL_BOOT_GUARD_OBB       0x03
@@ -68,9 +109,25 @@ typedef struct PROTECTED_RANGE_ {
 #define PROTECTED_RANGE_VENDOR_HASH_AMI_V3         0x07
 #define PROTECTED_RANGE_VENDOR_HASH_MICROSOFT_PMDA 0x08
 
+// Parsing phases reported to the progress callback
+#define FFS_PARSER_PHASE_FIRST_PASS   0x00
+#define FFS_PARSER_PHASE_SECOND_PASS  0x01
+#define FFS_PARSER_PHASE_INFO         0x02
+
+typedef struct FFS_PARSER_PROGRESS_ {
+    UINT8  phase = FFS_PARSER_PHASE_FIRST_PASS;
+    UINT32 bytesProcessed = 0; // Highest image offset reached by uncompressed items
+    UINT32 bytesTotal = 0;
+    UINT32 itemsCreated = 0;
+} FFS_PARSER_PROGRESS;
+
+// Called on the parsing thread, returning false aborts parsing with U_ABORTED
+typedef std::function<bool(const FFS_PARSER_PROGRESS & progress)> FfsParserProgressCallback;
+
 class FitParser;
 class NvramParser;
 class MeParser;
+class WorkerPool;
 
 class FfsParser
 {
@@ -86,6 +143,10 @@ public:
 
     // Parse firmware image
     USTATUS parse(const UByteArray &buffer);
+
+    // Info generators set by the parser, numbered from 1 for parse cache files, 0 stands for none or unknown
+    static UINT8 infoGeneratorId(const TreeItemInfoGenerator generator);
+    static TreeItemInfoGenerator infoGeneratorById(const UINT8 id);
     
     // Obtain parsed FIT table
     std::vector<std::pair<std::vector<UString>, UModelIndex> > getFitTable() const;
@@ -93,11 +154,23 @@ public:
     // Obtain Security Info
     UString getSecurityInfo() const;
 
+    // Set the number of threads used to decompress sections of a volume in parallel, 1 disables parallel decompression
+    // Worker threads are started only when there are compressed sections to decompress, and are reused for all volumes
+    void setThreadCount(const UINT32 count);
+
+    // Set the directory of the persistent parse cache, empty directory disables the cache
+    void setCacheDirectory(const UString & directory) { cacheDirectory = directory; }
+
+    // Set the callback that receives parsing progress and can abort parsing
+    void setProgressCallback(const FfsParserProgressCallback & callback) { progressCallback = callback; }
+
     // Obtain offset/address difference
     UINT64 getAddressDiff() { return addressDiff; }
 
     // Output some info to stdout
     void outputInfo(void);
+    // Output the same info to a given stream
+    void outputInfo(std::ostream & stream);
 
 private:
     TreeModel *model;
@@ -120,6 +193,23 @@ private:
     std::vector<PROTECTED_RANGE> protectedRanges;
     UINT64 protectedRegionsBase;
     UModelIndex dxeCore;
+    UINT8 standardCompressionAlgorithm;
+    UINT32 threadCount;
+    WorkerPool* workerPool;
+    DECOMPRESSION_PREFETCH* prefetch;
+    std::map<DECOMPRESSED_SECTION_KEY, std::shared_ptr<DECOMPRESSED_SECTION> > decompressedSections;
+    std::map<UModelIndex, PREPARSED_SECTIONS> preparsedSections;
+    void dropPreparsedSections(const UModelIndex & index);
+    UString cacheDirectory;
+    FfsParserProgressCallback progressCallback;
+    FFS_PARSER_PROGRESS progress;
+    bool aborted;
+    bool reportProgress(const UModelIndex & index);
+    bool reportPhase(const UINT8 phase);
+
+    // Parse cache
+    bool restoreFromCache(const UByteArray & buffer, const UByteArray & digest);
+    void storeToCache(const UByteArray & buffer, const UByteArray & digest, const int firstRow, const size_t messageCounts[4], const USTATUS result);
 
     // First pass
     USTATUS performFirstPass(const UByteArray & imageFile, UModelIndex & index);
@@ -161,6 +251,12 @@ private:
     USTATUS parsePostcodeSectionHeader(const UByteArray & section, const UINT32 localOffset, const UModelIndex & parent, UModelIndex & index, const bool insertIntoTree);
 
     USTATUS parseCompressedSectionBody(const UModelIndex & index);
+    USTATUS decompressStandard(const UByteArray & compressed, const UModelIndex & index, UINT8 & algorithm, UByteArray & decompressed);
+    USTATUS decompressSection(const UByteArray & compressed, const UModelIndex & index, const UINT8 method, UINT8 & algorithm, UINT32 & dictionarySize, UByteArray & decompressed, UByteArray & efiDecompressed);
+    void startPrefetch(const UModelIndex & index, const UINT8 ffsVersion, DECOMPRESSION_PREFETCH & volumePrefetch);
+    void fillPrefetchWindow();
+    void dropPrefetched(const DECOMPRESSED_SECTION_KEY & last);
+    void finishPrefetch(DECOMPRESSION_PREFETCH & volumePrefetch);
     USTATUS parseGuidedSectionBody(const UModelIndex & index);
     USTATUS parseVersionSectionBody(const UModelIndex & index);
     USTATUS parseDepexSectionBody(const UModelIndex & index);
@@ -170,7 +266,7 @@ private:
     USTATUS parseTeImageSectionBody(const UModelIndex & index);
 
     USTATUS parseAprioriRawSection(const UByteArray & body, UString & parsed);
-    USTATUS findNextRawAreaItem(const UModelIndex & index, const UINT32 localOffset, UINT8 & nextItemType, UINT32 & nextItemOffset, UINT32 & nextItemSize, UINT32 & nextItemAlternativeSize);
+    USTATUS findNextRawAreaItem(const UModelIndex & index, const UByteArray & data, const std::vector<UINT32> & candidates, const UINT32 localOffset, UINT8 & nextItemType, UINT32 & nextItemOffset, UINT32 & nextItemSize, UINT32 & nextItemAlternativeSize);
     UINT32  getFileSize(const UByteArray & volume, const UINT32 fileOffset, const UINT8 ffsVersion, const UINT8 revision);
     UINT32  getSectionSize(const UByteArray & file, const UINT32 sectionOffset, const UINT8 ffsVersion);
     
@@ -185,7 +281,9 @@ private:
     USTATUS checkTeImageBase(const UModelIndex & index);
     
     USTATUS checkProtectedRanges(const UModelIndex & index);
-    USTATUS markProtectedRangeRecursive(const UModelIndex & index, const PROTECTED_RANGE & range);
+    bool isProtectedRangeInImage(const PROTECTED_RANGE & range) const;
+    USTATUS markProtectedRanges(const UModelIndex & index, const std::vector<UINT32> & rangeIndices);
+    USTATUS markProtectedRangesRecursive(const UModelIndex & index, const std::vector<UINT32> & rangeIndices, const std::vector<UINT32> & boundaries, const std::vector<INT32> & segmentRanges);
 
     USTATUS parseResetVectorData();
     
@@ -15,6 +15,8 @@
 #include "ffs.h"
 #include "utility.h"
 
+#include <algorithm>
+
 std::vector<UString> FfsReport::generate()
 {
     std::vector<UString> report;
@@ -26,7 +28,7 @@ std::vector<UString> FfsReport::generate()
     }
     
     // Check root index to be valid
-    UModelIndex root = model->index(0,0);
+    UModelIndex root = model->childIndex(0);
     if (!root.isValid()) {
         report.push_back(usprintf("%s: model root index is invalid", __FUNCTION__));
         return report;
@@ -47,14 +49,32 @@ USTATUS FfsReport::generateRecursive(std::vector<UString> & report, const UModel
     if (!index.isValid())
         return U_SUCCESS; // Nothing to report for invalid index
     
-    // Calculate item CRC32
-    UByteArray data = model->header(index) + model->body(index) + model->tail(index);
-    UINT32 crc = (UINT32)crc32(0, (const UINT8*)data.constData(), (uInt)data.size());
+    // Calculate item CRC32 over its parts without joining them, compacted bodies are not expanded
+    // Empty parts are skipped, crc32() returns the initial value for a NULL buffer
+    UByteArray header = model->header(index);
+    UByteArray tail = model->tail(index);
+    UINT32 bodySize = model->bodySize(index);
+    uLong crc = crc32(0, (const UINT8*)header.constData(), (uInt)header.size());
+    UINT8 fill;
+    if (model->hasFillBody(index, fill)) {
+        UINT8 chunk[0x1000];
+        memset(chunk, fill, sizeof(chunk));
+        for (UINT32 done = 0; done < bodySize; done += sizeof(chunk))
+            crc = crc32(crc, chunk, (uInt)std::min<UINT32>(sizeof(chunk), bodySize - done));
+    }
+    else {
+        UByteArray body = model->body(index);
+        if (!body.isEmpty())
+            crc = crc32(crc, (const UINT8*)body.constData(), (uInt)body.size());
+    }
+    if (!tail.isEmpty())
+        crc = crc32(crc, (const UINT8*)tail.constData(), (uInt)tail.size());
+    UINT32 size = (UINT32)header.size() + bodySize + (UINT32)tail.size();
     
     // Information on current item
     UString text = model->text(index);
     UString offset = "|   N/A    ";
-    if ((!model->compressed(index)) || (index.parent().isValid() && !model->compressed(index.parent()))) {
+    if (model->hasFlatBase(index)) {
         offset = usprintf("| %08X ", model->base(index));
     }
     
@@ -62,13 +82,13 @@ USTATUS FfsReport::generateRecursive(std::vector<UString> & report, const UModel
                      UString(" ") + itemTypeToUString(model->type(index)).leftJustified(16)
                      + UString("| ") + itemSubtypeToUString(model->type(index), model->subtype(index)).leftJustified(22)
                      + offset
-                     + usprintf("| %08X | %08X | ", (UINT32)data.size(), crc)
+                     + usprintf("| %08X | %08X | ", size, (UINT32)crc)
                      + urepeated('-', level) + UString(" ") + model->name(index) + (text.isEmpty() ? UString() : UString(" | ") + text)
                      );
     
     // Information on child items
-    for (int i = 0; i < model->rowCount(index); i++) {
-        generateRecursive(report, index.model()->index(i,0,index), level + 1);
+    for (int i = 0; i < model->childCount(index); i++) {
+        generateRecursive(report, model->childIndex(i, index), level + 1);
     }
     
     return U_SUCCESS;
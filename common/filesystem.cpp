@@ -14,17 +14,82 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "filesystem.h"
 #include <sys/stat.h>
 #include <fstream>
+#include <climits>
+
+#if !defined(QT_CORE_LIB) && !defined(_WIN32) && !defined(__MINGW32__)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define U_USE_MMAP
+#endif
+
+#if defined(U_USE_MMAP)
+// Map the file read-only, pages are loaded on first access and shared with the page cache
+// Accessing a page beyond the end of a file truncated after mapping raises SIGBUS, so a file that changes while it is
+// being mapped is read instead, but one truncated later, while its data is still in use, will crash the process
+static bool mapFileIntoBuffer(const UString& inPath, UByteArray& buf)
+{
+    int fd = open(inPath.toLocal8Bit(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || st.st_size > INT32_MAX) {
+        close(fd);
+        return false;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+    
+    // Check that the file was not changed in the meantime
+    struct stat mapped;
+    bool unchanged = fstat(fd, &mapped) == 0 && mapped.st_size == st.st_size && mapped.st_mtime == st.st_mtime;
+    close(fd);
+    if (!unchanged) {
+        munmap(mapping, size);
+        return false;
+    }
+    
+    buf = UByteArray(std::shared_ptr<const char>((const char*)mapping, [size](const char* p) { munmap((void*)p, size); }), (int32_t)size);
+    return true;
+}
+#endif
 
 bool readFileIntoBuffer(const UString& inPath, UByteArray& buf) 
 {
     if (!isExistOnFs(inPath))
         return false;
 
-    std::ifstream inputFile(inPath.toLocal8Bit(), std::ios::in | std::ios::binary);
+#if defined(U_USE_MMAP)
+    if (mapFileIntoBuffer(inPath, buf))
+        return true;
+#endif
+
+    std::ifstream inputFile(inPath.toLocal8Bit(), std::ios::in | std::ios::binary | std::ios::ate);
     if (!inputFile)
         return false;
-    std::vector<char> buffer(std::istreambuf_iterator<char>(inputFile),
-        (std::istreambuf_iterator<char>()));
+
+    // Read regular files directly into the buffer, everything else char by char
+    std::streamoff size = inputFile.tellg();
+    if (size < 0) {
+        inputFile.clear();
+        std::vector<char> buffer(std::istreambuf_iterator<char>(inputFile),
+            (std::istreambuf_iterator<char>()));
+        buf = buffer;
+        return true;
+    }
+    if (size > INT32_MAX)
+        return false;
+
+    UByteArray buffer((size_t)size, '\x00');
+    inputFile.seekg(0, std::ios::beg);
+    if (size > 0 && !inputFile.read(buffer.data(), size))
+        return false;
     inputFile.close();
 
     buf = buffer;
@@ -41,6 +106,12 @@ bool isExistOnFs(const UString & path)
     return (_stat(path.toLocal8Bit(), &buf) == 0);
 }
 
+bool isDirectory(const UString & path)
+{
+    struct _stat buf;
+    return (_stat(path.toLocal8Bit(), &buf) == 0 && (buf.st_mode & _S_IFDIR));
+}
+
 bool makeDirectory(const UString & dir) 
 {
     return (_mkdir(dir.toLocal8Bit()) == 0);
@@ -53,12 +124,7 @@ bool changeDirectory(const UString & dir)
 
 bool removeDirectory(const UString & dir) 
 {
-    int r = _rmdir(dir.toLocal8Bit());
-    // Hack: unlike *nix, Windows does not permit deleting current directories
-    if (r < 0 && errno == EACCES && changeDirectory(dir + UString("/../"))) {
-        return (_rmdir(dir.toLocal8Bit()) == 0);
-    }
-    return (r == 0);
+    return (_rmdir(dir.toLocal8Bit()) == 0);
 }
 
 UString getAbsPath(const UString & path) 
@@ -84,6 +150,12 @@ bool isExistOnFs(const UString & path)
     return (stat(path.toLocal8Bit(), &buf) == 0);
 }
 
+bool isDirectory(const UString & path)
+{
+    struct stat buf;
+    return (stat(path.toLocal8Bit(), &buf) == 0 && S_ISDIR(buf.st_mode));
+}
+
 bool makeDirectory(const UString & dir) 
 {
     return (mkdir(dir.toLocal8Bit(), ACCESSPERMS) == 0);
@@ -18,9 +18,12 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "ubytearray.h"
 
 bool isExistOnFs(const UString& path);
+bool isDirectory(const UString& path);
 bool makeDirectory(const UString& dir);
 bool changeDirectory(const UString& dir);
 bool removeDirectory(const UString& dir);
+// Regular files are mapped into memory instead of being read where possible, such a file must not be truncated
+// while the buffer or any array sharing its data is alive, reading past the new end of file raises SIGBUS
 bool readFileIntoBuffer(const UString& inPath, UByteArray& buf);
 UString getAbsPath(const UString& path);
 
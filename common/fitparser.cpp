@@ -208,8 +208,8 @@ void FitParser::findFitRecursive(const UModelIndex & index, UModelIndex & found,
     }
     
     // Process child items
-    for (int i = 0; i < model->rowCount(index); i++) {
-        findFitRecursive(index.model()->index(i, 0, index), found, fitOffset);
+    for (int i = 0; i < model->childCount(index); i++) {
+        findFitRecursive(model->childIndex(i, index), found, fitOffset);
         
         if (found.isValid()) {
             // Found it, no need to process further
@@ -242,7 +242,7 @@ void FitParser::findFitRecursive(const UModelIndex & index, UModelIndex & found,
                 break;
             }
         }
-        else if (model->rowCount(index) == 0) { // Show messages only to leaf items
+        else if (model->childCount(index) == 0) { // Show messages only to leaf items
             msg(usprintf("%s: FIT table candidate found, but not referenced from the last VTF", __FUNCTION__), index);
         }
     }
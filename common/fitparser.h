@@ -47,6 +47,9 @@ public:
     // Obtain security info
     UString getSecurityInfo() const { return securityInfo; }
     
+    // Restore results of a previous FIT parsing
+    void restore(const std::vector<std::pair<std::vector<UString>, UModelIndex> > & table, const UString & info) { fitTable = table; securityInfo = info; }
+    
     // FIT parsing
     USTATUS parseFit(const UModelIndex & index);
         
@@ -93,6 +96,9 @@ public:
     // Obtain security info
     UString getSecurityInfo() const { return UString(); }
     
+    // Restore results of a previous FIT parsing
+    void restore(const std::vector<std::pair<std::vector<UString>, UModelIndex> > & table, const UString & info) { U_UNUSED_PARAMETER(table); U_UNUSED_PARAMETER(info); }
+    
     // FIT parsing
     USTATUS parseFit(const UModelIndex & index) { U_UNUSED_PARAMETER(index); return U_SUCCESS; }
 };
@@ -13,6 +13,7 @@
 #include "guiddatabase.h"
 #include "ubytearray.h"
 #include "ffs.h"
+#include "digest/sha2.h"
 
 #include <fstream>
 #include <string>
@@ -23,6 +24,7 @@
 #include <cstdio>
 
 static GuidDatabase gLocalGuidDatabase;
+static UByteArray gLocalGuidDatabaseDigest;
 
 #ifdef QT_CORE_LIB
 
@@ -54,7 +56,11 @@ void initGuidDatabase(const UString & path, UINT32* numEntries)
 {
     gLocalGuidDatabase.clear();
     
-    std::stringstream file(readGuidDatabase(path));
+    std::string contents = readGuidDatabase(path);
+    gLocalGuidDatabaseDigest = UByteArray(SHA256_HASH_SIZE, '\x00');
+    sha256(contents.data(), (unsigned long)contents.size(), gLocalGuidDatabaseDigest.data());
+    
+    std::stringstream file(contents);
     
     while (!file.eof()) {
         std::string line;
@@ -90,7 +96,16 @@ void initGuidDatabase(const UString & path, UINT32* numEntries)
 
 UString guidDatabaseLookup(const EFI_GUID & guid)
 {
-    return gLocalGuidDatabase[guid];
+    // Do not insert missing entries, lookups can be done from multiple threads at once
+    GuidDatabase::const_iterator it = gLocalGuidDatabase.find(guid);
+    if (it == gLocalGuidDatabase.end())
+        return UString();
+    return it->second;
+}
+
+UByteArray guidDatabaseDigest()
+{
+    return gLocalGuidDatabaseDigest;
 }
 
 #else
@@ -106,6 +121,11 @@ UString guidDatabaseLookup(const EFI_GUID & guid)
     U_UNUSED_PARAMETER(guid);
     return UString();
 }
+
+UByteArray guidDatabaseDigest()
+{
+    return UByteArray();
+}
 #endif
 
 GuidDatabase guidDatabaseFromTreeRecursive(TreeModel * model, const UModelIndex index)
@@ -115,8 +135,8 @@ GuidDatabase guidDatabaseFromTreeRecursive(TreeModel * model, const UModelIndex
     if (!index.isValid())
         return db;
     
-    for (int i = 0; i < model->rowCount(index); i++) {
-        GuidDatabase tmpDb = guidDatabaseFromTreeRecursive(model, index.model()->index(i, index.column(), index));
+    for (int i = 0; i < model->childCount(index); i++) {
+        GuidDatabase tmpDb = guidDatabaseFromTreeRecursive(model, model->childIndex(i, index));
         
         db.insert(tmpDb.begin(), tmpDb.end());
     }
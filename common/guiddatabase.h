@@ -34,6 +34,7 @@ typedef std::map<EFI_GUID, UString, OperatorLessForGuids> GuidDatabase;
 
 UString guidDatabaseLookup(const EFI_GUID & guid);
 void initGuidDatabase(const UString & path = "", UINT32* numEntries = NULL);
+UByteArray guidDatabaseDigest();
 GuidDatabase guidDatabaseFromTreeRecursive(TreeModel * model, const UModelIndex index);
 USTATUS guidDatabaseExportToFile(const UString & outPath, GuidDatabase & db);
 
@@ -68,7 +68,7 @@ USTATUS NvramParser::parseNvarStore(const UModelIndex & index)
                 // Get info
                 UString info = usprintf("Full size: %Xh (%u)", (UINT32)padding.size(), (UINT32)padding.size());
 
-                if ((UINT32)padding.count(0xFF) == unparsedSize) { // Free space
+                if ((UINT32)padding.size() == unparsedSize && allBytesEqual(padding, 0xFF)) { // Free space
                     // Add tree item
                     model->addItem(localOffset + entry->offset(), Types::FreeSpace, 0, UString("Free space"), UString(), info, UByteArray(), padding, UByteArray(), Fixed, index);
                 }
@@ -131,7 +131,7 @@ USTATUS NvramParser::parseNvarStore(const UModelIndex & index)
                             break;
 
                         if ((UINT32)previousEntry->next() + (UINT32)previousEntry->offset() == (UINT32)entry->offset()) { // Previous link is present and valid
-                            prevEntryIndex = index.model()->index(i, 0, index);
+                            prevEntryIndex = model->childIndex(i, index);
                             // Make sure that we are linking to a valid entry
                             NVAR_ENTRY_PARSING_DATA pd = readUnaligned((NVAR_ENTRY_PARSING_DATA*)model->parsingData(prevEntryIndex).constData());
                             if (!pd.isValid) {
@@ -167,7 +167,7 @@ USTATUS NvramParser::parseNvarStore(const UModelIndex & index)
                 for (const auto & ch : *entry_body->ucs2_name()->ucs2_chars()) {
                     temp += UByteArray((const char*)&ch, sizeof(ch));
                 }
-                text = uFromUcs2(temp.constData());
+                text = uFromUcs2(temp.constData(), temp.size() / 2);
             }
 
             // Obtain GUID
@@ -265,7 +265,7 @@ processing_done:
             currentEntryIndex++;
 
             // Set parsing data
-            model->setParsingData(varIndex, UByteArray((const char*)&pdata, sizeof(pdata)));
+            model->setParsingData(varIndex, &pdata, sizeof(pdata));
 
             // Try parsing the entry data as NVAR storage if it begins with NVAR signature
             if ((subtype == Subtypes::DataNvarEntry || subtype == Subtypes::FullNvarEntry)
@@ -387,7 +387,7 @@ USTATUS NvramParser::parseNvramVolumeBody(const UModelIndex & index)
         // Add info
         info = usprintf("Full size: %Xh (%u)", (UINT32)padding.size(), (UINT32)padding.size());
         
-        if (padding.count(emptyByte) == padding.size()) { // Free space
+        if (allBytesEqual(padding, emptyByte)) { // Free space
             // Add tree item
             model->addItem(localOffset + storeOffset, Types::FreeSpace, 0, UString("Free space"), UString(), info, UByteArray(), padding, UByteArray(), Fixed, index);
         }
@@ -404,8 +404,8 @@ USTATUS NvramParser::parseNvramVolumeBody(const UModelIndex & index)
     }
     
     // Parse bodies
-    for (int i = 0; i < model->rowCount(index); i++) {
-        UModelIndex current = index.model()->index(i, 0, index);
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
         
         switch (model->type(current)) {
             case Types::FdcStore:
@@ -1128,12 +1128,12 @@ USTATUS NvramParser::parseSlicMarkerHeader(const UByteArray & store, const UINT3
     // Add info
     UString name("SLIC marker");
     UString info = usprintf("Type: 1h\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: 0h (0)\n"
-                            "Version: %08Xh\nOEM ID: %s\nOEM table ID: %s\nWindows flag: WINDOWS\nSLIC version: %08Xh",
+                            "Version: %08Xh\nOEM ID: %.6s\nOEM table ID: %.8s\nWindows flag: WINDOWS\nSLIC version: %08Xh",
                             markerHeader->Size, markerHeader->Size,
                             (UINT32)header.size(), (UINT32)header.size(),
                             markerHeader->Version,
-                            (const char*)UString((const char*)&(markerHeader->OemId)).left(6).toLocal8Bit(),
-                            (const char*)UString((const char*)&(markerHeader->OemTableId)).left(8).toLocal8Bit(),
+                            (const char*)markerHeader->OemId,
+                            (const char*)markerHeader->OemTableId,
                             markerHeader->SlicVersion);
     
     
@@ -1350,8 +1350,10 @@ USTATUS NvramParser::parseVssStoreBody(const UModelIndex & index, UINT8 alignmen
                 variableGuid = (EFI_GUID*)&intelVariableHeader->VendorGuid;
                 variableName = (CHAR16*)(intelVariableHeader + 1);
                 
+                // Name is NUL-terminated, but must not be searched for beyond the store
+                UINT32 maxNameLength = unparsedSize > sizeof(VSS_INTEL_VARIABLE_HEADER) ? (UINT32)(unparsedSize - sizeof(VSS_INTEL_VARIABLE_HEADER)) / 2 : 0;
                 UINT32 i = 0;
-                while (variableName[i] != 0) ++i;
+                while (i < maxNameLength && variableName[i] != 0) ++i;
                 
                 i = sizeof(VSS_INTEL_VARIABLE_HEADER) + 2 * (i + 1);
                 i = i < variableSize ? i : variableSize;
@@ -1390,7 +1392,7 @@ USTATUS NvramParser::parseVssStoreBody(const UModelIndex & index, UINT8 alignmen
             // Get info
             UString info = usprintf("Full size: %Xh (%u)", (UINT32)padding.size(), (UINT32)padding.size());
             
-            if (padding.count(emptyByte) == padding.size()) { // Free space
+            if (allBytesEqual(padding, emptyByte)) { // Free space
                 // Add tree item
                 model->addItem(localOffset + offset, Types::FreeSpace, 0, UString("Free space"), UString(), info, UByteArray(), padding, UByteArray(), Fixed, index);
             }
@@ -1418,7 +1420,7 @@ USTATUS NvramParser::parseVssStoreBody(const UModelIndex & index, UINT8 alignmen
         else { // Add GUID and text for valid variables
             name = guidToUString(readUnaligned(variableGuid));
             info += UString("Variable GUID: ") + guidToUString(readUnaligned(variableGuid), false) + "\n";
-            text = uFromUcs2((const char*)variableName);
+            text = uFromUcs2((const char*)variableName, (dataSize - (UINT32)((const char*)variableName - data.constData())) / 2);
         }
         
         // Add info
@@ -1550,7 +1552,7 @@ USTATUS NvramParser::parseFsysStoreBody(const UModelIndex & index)
                                 (UINT32)body.size(), (UINT32)body.size());
         
         // Add tree item
-        model->addItem(localOffset + offset, Types::FsysEntry, valid ? Subtypes::NormalFsysEntry : Subtypes::InvalidFsysEntry, UString(name.constData()), UString(), info, header, body, UByteArray(), Fixed, index);
+        model->addItem(localOffset + offset, Types::FsysEntry, valid ? Subtypes::NormalFsysEntry : Subtypes::InvalidFsysEntry, usprintf("%.*s", name.size(), name.constData()), UString(), info, header, body, UByteArray(), Fixed, index);
         
         // Move to next variable
         offset += variableSize;
@@ -1606,7 +1608,7 @@ USTATUS NvramParser::parseEvsaStoreBody(const UModelIndex & index)
             body = data.mid(offset);
             info = usprintf("Full size: %Xh (%u)", (UINT32)body.size(), (UINT32)body.size());
             
-            if (body.count(emptyByte) == body.size()) { // Free space
+            if (allBytesEqual(body, emptyByte)) { // Free space
                 // Add free space tree item
                 model->addItem(localOffset + offset, Types::FreeSpace, 0, UString("Free space"), UString(), info, UByteArray(), body, UByteArray(), Fixed, index);
             }
@@ -1650,7 +1652,7 @@ USTATUS NvramParser::parseEvsaStoreBody(const UModelIndex & index)
             const EVSA_NAME_ENTRY* nameHeader = (const EVSA_NAME_ENTRY*)entryHeader;
             header = data.mid(offset, sizeof(EVSA_NAME_ENTRY));
             body = data.mid(offset + sizeof(EVSA_NAME_ENTRY), nameHeader->Header.Size - sizeof(EVSA_NAME_ENTRY));
-            name = uFromUcs2(body.constData());
+            name = uFromUcs2(body.constData(), body.size() / 2);
             info = UString("Name: ") + name
             + usprintf("\nFull size: %Xh (%u)\nHeader size: %Xh (%u)\nBody size: %Xh (%u)\nType: %02Xh\nChecksum: %02Xh",
                        variableSize, variableSize,
@@ -1700,7 +1702,7 @@ USTATUS NvramParser::parseEvsaStoreBody(const UModelIndex & index)
             body = data.mid(offset);
             info = usprintf("Full size: %Xh (%u)", (UINT32)body.size(), (UINT32)body.size());
             
-            if (body.count(emptyByte) == body.size()) { // Free space
+            if (allBytesEqual(body, emptyByte)) { // Free space
                 // Add free space tree item
                 model->addItem(localOffset + offset, Types::FreeSpace, 0, UString("Free space"), UString(), info, UByteArray(), body, UByteArray(), Fixed, index);
             }
@@ -1723,8 +1725,8 @@ USTATUS NvramParser::parseEvsaStoreBody(const UModelIndex & index)
     }
     
     // Reparse all data variables to detect invalid ones and assign name and test to valid ones
-    for (int i = 0; i < model->rowCount(index); i++) {
-        UModelIndex current = index.model()->index(i, 0, index);
+    for (int i = 0; i < model->childCount(index); i++) {
+        UModelIndex current = model->childIndex(i, index);
         
         if (model->subtype(current) == Subtypes::DataEvsaEntry) {
             UByteArray header = model->header(current);
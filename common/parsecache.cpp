@@ -0,0 +1,558 @@
+/* parsecache.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+*/
+
+#include "parsecache.h"
+
+#include <map>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+#include "../version.h"
+#include "guiddatabase.h"
+#include "utility.h"
+
+#if defined(QT_CORE_LIB)
+#include <QFile>
+#else
+#include "filesystem.h"
+#endif
+
+// Cache file layout, all integers are stored in native byte order:
+//   header: signature, format version, byte order mark, program version, parser version, parser features,
+//           GUID database digest, image digest and size
+//   items in pre-order: parent id, offset, type, subtype, marking, action, flags,
+//           name, text, stored info, info generator, location info, header, body, tail, parsing data, uncompressed data
+//   messages, FIT table, security info, address difference, parser state, parsing result
+// Item data found in the image at the item base is stored as a reference to the image,
+// everything else is stored inline and loaded as a slice of the cache file buffer
+#define PARSE_CACHE_SIGNATURE          "UEFIPCCH"
+#define PARSE_CACHE_SIGNATURE_LENGTH   8
+#define PARSE_CACHE_BYTE_ORDER_MARK    0x01020304U
+#define PARSE_CACHE_NO_ITEM            0xFFFFFFFFU
+
+#define PARSE_CACHE_DATA_INLINE        0
+#define PARSE_CACHE_DATA_IMAGE         1
+
+#define PARSE_CACHE_ITEM_FIXED         0x01
+#define PARSE_CACHE_ITEM_COMPRESSED    0x02
+
+// Parser features that change the resulting tree
+static UINT32 parseCacheFeatures()
+{
+    UINT32 features = 0;
+#if defined(U_ENABLE_NVRAM_PARSING_SUPPORT)
+    features |= 0x01;
+#endif
+#if defined(U_ENABLE_ME_PARSING_SUPPORT)
+    features |= 0x02;
+#endif
+#if defined(U_ENABLE_FIT_PARSING_SUPPORT)
+    features |= 0x04;
+#endif
+#if defined(U_ENABLE_GUID_DATABASE_SUPPORT)
+    features |= 0x08;
+#endif
+    return features;
+}
+
+static UString parseCachePath(const UString & directory, const UByteArray & digest)
+{
+    UString path = directory + UString("/");
+    for (int i = 0; i < digest.size(); i++)
+        path += usprintf("%02x", (UINT8)digest.at(i));
+    return path + UString(".cache");
+}
+
+//
+// Writing
+//
+
+class ParseCacheWriter
+{
+public:
+    ParseCacheWriter(const UByteArray & image) : image(image) {}
+
+    std::string data;
+
+    void addUint8(const UINT8 value) { data.push_back((char)value); }
+    void addUint32(const UINT32 value) { data.append((const char*)&value, sizeof(value)); }
+    void addUint64(const UINT64 value) { data.append((const char*)&value, sizeof(value)); }
+    void addBytes(const char* bytes, const UINT32 size) { addUint32(size); data.append(bytes, size); }
+    void addString(const UString & string) {
+#if defined(QT_CORE_LIB)
+        UByteArray utf8 = string.toUtf8();
+        addBytes(utf8.constData(), (UINT32)utf8.size());
+#else
+        addBytes((const char*)string, (UINT32)string.length());
+#endif
+    }
+
+    // Stores a reference to the image if the array holds image bytes at the given offset
+    void addArray(const UByteArray & array, const UINT32 offset) {
+        const UINT32 size = (UINT32)array.size();
+        if (size > 0 && (UINT32)image.size() >= size) {
+            // Slices of the image buffer are found without comparing their contents
+            uintptr_t begin = (uintptr_t)image.constData();
+            uintptr_t pointer = (uintptr_t)array.constData();
+            if (pointer >= begin && pointer - begin <= (uintptr_t)image.size() - size) {
+                addImageReference((UINT32)(pointer - begin), size);
+                return;
+            }
+            if (offset <= (UINT32)image.size() - size
+                && memcmp(image.constData() + offset, array.constData(), size) == 0) {
+                addImageReference(offset, size);
+                return;
+            }
+        }
+        addUint8(PARSE_CACHE_DATA_INLINE);
+        addBytes(array.constData(), size);
+    }
+
+private:
+    const UByteArray & image;
+
+    void addImageReference(const UINT32 offset, const UINT32 size) {
+        addUint8(PARSE_CACHE_DATA_IMAGE);
+        addUint32(offset);
+        addUint32(size);
+    }
+};
+
+USTATUS parseCacheStore(const UString & directory, const UByteArray & image, const UByteArray & digest, TreeModel* model, const std::vector<UModelIndex> & items, const PARSE_CACHE_RESULT & result)
+{
+    if (directory.isEmpty() || digest.size() != SHA256_HASH_SIZE || !model)
+        return U_INVALID_PARAMETER;
+
+    ParseCacheWriter writer(image);
+
+    // Header
+    writer.data.append(PARSE_CACHE_SIGNATURE, PARSE_CACHE_SIGNATURE_LENGTH);
+    writer.addUint32(PARSE_CACHE_FORMAT_VERSION);
+    writer.addUint32(PARSE_CACHE_BYTE_ORDER_MARK);
+    writer.addString(UString(PROGRAM_VERSION));
+    writer.addUint32(PARSE_CACHE_PARSER_VERSION);
+    writer.addUint32(parseCacheFeatures());
+    UByteArray guidDigest = guidDatabaseDigest();
+    writer.addBytes(guidDigest.constData(), (UINT32)guidDigest.size());
+    writer.addBytes(digest.constData(), (UINT32)digest.size());
+    writer.addUint64((UINT64)image.size());
+
+    // Items, children are pushed in reverse to be stored in pre-order
+    std::map<const void*, UINT32> ids;
+    std::vector<std::pair<UModelIndex, UINT32> > stack;
+    for (size_t i = items.size(); i > 0; i--)
+        stack.push_back(std::make_pair(items[i - 1], PARSE_CACHE_NO_ITEM));
+    std::string records;
+    UINT32 count = 0;
+    std::swap(records, writer.data);
+    while (!stack.empty()) {
+        UModelIndex index = stack.back().first;
+        UINT32 parentId = stack.back().second;
+        stack.pop_back();
+        if (!index.isValid())
+            continue;
+
+        const TreeItem* item = static_cast<const TreeItem*>(index.internalPointer());
+        UINT32 id = count++;
+        ids[item] = id;
+
+        UByteArray header = item->header();
+        UByteArray body = item->body();
+        UByteArray tail = item->tail();
+        UINT32 base = model->base(index);
+
+        writer.addUint32(parentId);
+        writer.addUint32(item->offset());
+        writer.addUint8(item->type());
+        writer.addUint8(item->subtype());
+        writer.addUint8(item->marking());
+        writer.addUint8(item->action());
+        writer.addUint8((item->fixed() ? PARSE_CACHE_ITEM_FIXED : 0) | (item->compressed() ? PARSE_CACHE_ITEM_COMPRESSED : 0));
+        writer.addString(item->name());
+        writer.addString(item->text());
+        // Generated info is stored as the generator, so storing does not generate it
+        UINT8 generator = FfsParser::infoGeneratorId(item->infoGenerator());
+        if (generator == 0 && item->infoGenerator() != NULL) {
+            writer.addString(item->info());
+            writer.addUint8(0);
+            writer.addUint8(0);
+            writer.addUint32(0);
+        }
+        else {
+            writer.addString(item->storedInfo());
+            writer.addUint8(generator);
+            writer.addUint8(item->locationInfo());
+            writer.addUint32(item->locationInfoAddress());
+        }
+        writer.addArray(header, base);
+        writer.addArray(body, base + (UINT32)header.size());
+        writer.addArray(tail, base + (UINT32)header.size() + (UINT32)body.size());
+        writer.addArray(item->parsingData(), PARSE_CACHE_NO_ITEM);
+        writer.addArray(item->uncompressedData(), PARSE_CACHE_NO_ITEM);
+
+        for (int i = model->childCount(index); i > 0; i--)
+            stack.push_back(std::make_pair(model->childIndex(i - 1, index), id));
+    }
+    std::swap(records, writer.data);
+    writer.addUint32(count);
+    writer.data += records;
+    records.clear();
+
+    // Messages and FIT table refer to items by their ids
+    std::map<const void*, UINT32>::const_iterator found;
+    writer.addUint32((UINT32)result.messages.size());
+    for (size_t i = 0; i < result.messages.size(); i++) {
+        writer.addString(result.messages[i].first);
+        found = ids.find(result.messages[i].second.internalPointer());
+        writer.addUint32(result.messages[i].second.isValid() && found != ids.end() ? found->second : PARSE_CACHE_NO_ITEM);
+    }
+    writer.addUint32((UINT32)result.fitTable.size());
+    for (size_t i = 0; i < result.fitTable.size(); i++) {
+        writer.addUint32((UINT32)result.fitTable[i].first.size());
+        for (size_t j = 0; j < result.fitTable[i].first.size(); j++)
+            writer.addString(result.fitTable[i].first[j]);
+        found = ids.find(result.fitTable[i].second.internalPointer());
+        writer.addUint32(result.fitTable[i].second.isValid() && found != ids.end() ? found->second : PARSE_CACHE_NO_ITEM);
+    }
+    writer.addString(result.securityInfo);
+    writer.addString(result.fitSecurityInfo);
+    writer.addUint64(result.addressDiff);
+    writer.addUint32(result.imageBase);
+    writer.addUint64(result.protectedRegionsBase);
+    writer.addUint32((UINT32)result.protectedRanges.size());
+    for (size_t i = 0; i < result.protectedRanges.size(); i++) {
+        const PROTECTED_RANGE & range = result.protectedRanges[i];
+        writer.addUint32(range.Offset);
+        writer.addUint32(range.Size);
+        writer.addUint32(range.AlgorithmId);
+        writer.addUint8(range.Type);
+        writer.addBytes(range.Hash.constData(), (UINT32)range.Hash.size());
+    }
+    found = ids.find(result.lastVtf.internalPointer());
+    writer.addUint32(result.lastVtf.isValid() && found != ids.end() ? found->second : PARSE_CACHE_NO_ITEM);
+    found = ids.find(result.dxeCore.internalPointer());
+    writer.addUint32(result.dxeCore.isValid() && found != ids.end() ? found->second : PARSE_CACHE_NO_ITEM);
+    writer.addUint32(result.result);
+    writer.data.append(PARSE_CACHE_SIGNATURE, PARSE_CACHE_SIGNATURE_LENGTH);
+
+    // Write to a temporary file and move it into place, so readers never see a partial file
+    UString path = parseCachePath(directory, digest);
+    UINT64 unique = (UINT64)std::chrono::high_resolution_clock::now().time_since_epoch().count()
+        ^ (UINT64)std::hash<std::thread::id>()(std::this_thread::get_id());
+    UString temporaryPath = path + usprintf(".%016llx.tmp", (unsigned long long)unique);
+    {
+        std::ofstream file(temporaryPath.toLocal8Bit(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file)
+            return U_FILE_OPEN;
+        file.write(writer.data.data(), (std::streamsize)writer.data.size());
+        if (!file) {
+            file.close();
+            std::remove(temporaryPath.toLocal8Bit());
+            return U_FILE_WRITE;
+        }
+    }
+    if (std::rename(temporaryPath.toLocal8Bit(), path.toLocal8Bit()) != 0) {
+        // Renaming over an existing file is not supported everywhere
+        std::remove(path.toLocal8Bit());
+        if (std::rename(temporaryPath.toLocal8Bit(), path.toLocal8Bit()) != 0) {
+            std::remove(temporaryPath.toLocal8Bit());
+            return U_FILE_WRITE;
+        }
+    }
+
+    return U_SUCCESS;
+}
+
+//
+// Reading
+//
+
+// Cached item before it is added to the model
+typedef struct PARSE_CACHE_ITEM_ {
+    UINT32     parent;
+    UINT32     offset;
+    UINT8      type;
+    UINT8      subtype;
+    UINT8      marking;
+    UINT8      action;
+    UINT8      flags;
+    UString    name;
+    UString    text;
+    UString    info;
+    UINT8      generator;
+    UINT8      location;
+    UINT32     address;
+    UByteArray header;
+    UByteArray body;
+    UByteArray tail;
+    UByteArray parsingData;
+    UByteArray uncompressedData;
+} PARSE_CACHE_ITEM;
+
+class ParseCacheReader
+{
+public:
+    ParseCacheReader(const UByteArray & data, const UByteArray & image) : data(data), image(image), position(0), valid(true) {}
+
+    bool isValid() const { return valid; }
+    bool atEnd() const { return position == (UINT32)data.size(); }
+
+    UINT8 getUint8() {
+        UINT8 value = 0;
+        if (require(sizeof(value)))
+            value = (UINT8)data.at(position++);
+        return value;
+    }
+    UINT32 getUint32() {
+        UINT32 value = 0;
+        if (require(sizeof(value))) {
+            value = readUnaligned((const UINT32*)(data.constData() + position));
+            position += sizeof(value);
+        }
+        return value;
+    }
+    UINT64 getUint64() {
+        UINT64 value = 0;
+        if (require(sizeof(value))) {
+            value = readUnaligned((const UINT64*)(data.constData() + position));
+            position += sizeof(value);
+        }
+        return value;
+    }
+    UByteArray getBytes() {
+        UINT32 size = getUint32();
+        if (!require(size))
+            return UByteArray();
+        UByteArray bytes = data.mid(position, size);
+        position += size;
+        return bytes;
+    }
+    UString getString() {
+        UINT32 size = getUint32();
+        if (!require(size))
+            return UString();
+        const char* bytes = data.constData() + position;
+        position += size;
+#if defined(QT_CORE_LIB)
+        return QString::fromUtf8(bytes, size);
+#else
+        return UString(bytes, (int)size);
+#endif
+    }
+    UByteArray getArray() {
+        UINT8 kind = getUint8();
+        if (kind == PARSE_CACHE_DATA_INLINE)
+            return getBytes();
+        if (kind == PARSE_CACHE_DATA_IMAGE) {
+            UINT32 offset = getUint32();
+            UINT32 size = getUint32();
+            if (offset <= (UINT32)image.size() && size <= (UINT32)image.size() - offset)
+                return image.mid(offset, size);
+        }
+        valid = false;
+        return UByteArray();
+    }
+    bool getSignature() {
+        if (!require(PARSE_CACHE_SIGNATURE_LENGTH)
+            || memcmp(data.constData() + position, PARSE_CACHE_SIGNATURE, PARSE_CACHE_SIGNATURE_LENGTH) != 0)
+            return valid = false;
+        position += PARSE_CACHE_SIGNATURE_LENGTH;
+        return true;
+    }
+
+private:
+    const UByteArray & data;
+    const UByteArray & image;
+    UINT32 position;
+    bool valid;
+
+    bool require(const UINT32 size) {
+        if (!valid || size > (UINT32)data.size() - position)
+            valid = false;
+        return valid;
+    }
+};
+
+// Cache file contents, memory-mapped where supported
+class ParseCacheFile
+{
+public:
+    UByteArray data;
+
+    bool read(const UString & path) {
+#if defined(QT_CORE_LIB)
+        // Mapped bytes are wrapped without copying, loaded items get deep copies of their slices
+        file.setFileName(path);
+        if (!file.open(QFile::ReadOnly))
+            return false;
+        uchar* mapped = file.size() > 0 && file.size() <= INT_MAX ? file.map(0, file.size()) : NULL;
+        data = mapped ? QByteArray::fromRawData((const char*)mapped, (int)file.size()) : file.readAll();
+        return true;
+#else
+        // Mapped by the reader where supported, inline data is then loaded on first access
+        return readFileIntoBuffer(path, data);
+#endif
+    }
+
+#if defined(QT_CORE_LIB)
+private:
+    QFile file; // Unmapped on destruction, after the last use of data
+#endif
+};
+
+USTATUS parseCacheLoad(const UString & directory, const UByteArray & image, const UByteArray & digest, TreeModel* model, PARSE_CACHE_RESULT & result)
+{
+    if (directory.isEmpty() || digest.size() != SHA256_HASH_SIZE || !model)
+        return U_INVALID_PARAMETER;
+
+    ParseCacheFile file;
+    if (!file.read(parseCachePath(directory, digest)))
+        return U_FILE_READ;
+    const UByteArray & data = file.data;
+
+    // Header must match this build and the image exactly
+    ParseCacheReader reader(data, image);
+    if (!reader.getSignature()
+        || reader.getUint32() != PARSE_CACHE_FORMAT_VERSION
+        || reader.getUint32() != PARSE_CACHE_BYTE_ORDER_MARK
+        || reader.getString() != UString(PROGRAM_VERSION)
+        || reader.getUint32() != PARSE_CACHE_PARSER_VERSION
+        || reader.getUint32() != parseCacheFeatures()
+        || reader.getBytes() != guidDatabaseDigest()
+        || reader.getBytes() != digest
+        || reader.getUint64() != (UINT64)image.size()
+        || !reader.isValid())
+        return U_INVALID_FILE;
+
+    // Read everything before touching the model
+    UINT32 count = reader.getUint32();
+    if (count > (UINT32)data.size())
+        return U_INVALID_FILE;
+    std::vector<PARSE_CACHE_ITEM> items(count);
+    for (UINT32 i = 0; i < count && reader.isValid(); i++) {
+        PARSE_CACHE_ITEM & item = items[i];
+        item.parent = reader.getUint32();
+        item.offset = reader.getUint32();
+        item.type = reader.getUint8();
+        item.subtype = reader.getUint8();
+        item.marking = reader.getUint8();
+        item.action = reader.getUint8();
+        item.flags = reader.getUint8();
+        item.name = reader.getString();
+        item.text = reader.getString();
+        item.info = reader.getString();
+        item.generator = reader.getUint8();
+        item.location = reader.getUint8();
+        item.address = reader.getUint32();
+        item.header = reader.getArray();
+        item.body = reader.getArray();
+        item.tail = reader.getArray();
+        item.parsingData = reader.getArray();
+        item.uncompressedData = reader.getArray();
+
+        // Parents always precede their children
+        if ((item.parent != PARSE_CACHE_NO_ITEM && item.parent >= i)
+            || (item.generator != 0 && FfsParser::infoGeneratorById(item.generator) == NULL))
+            return U_INVALID_FILE;
+    }
+
+    UINT32 messageCount = reader.getUint32();
+    if (messageCount > (UINT32)data.size())
+        return U_INVALID_FILE;
+    std::vector<std::pair<UString, UINT32> > messages(messageCount);
+    for (UINT32 i = 0; i < messageCount && reader.isValid(); i++) {
+        messages[i].first = reader.getString();
+        messages[i].second = reader.getUint32();
+    }
+
+    UINT32 fitCount = reader.getUint32();
+    if (fitCount > (UINT32)data.size())
+        return U_INVALID_FILE;
+    std::vector<std::pair<std::vector<UString>, UINT32> > fitTable(fitCount);
+    for (UINT32 i = 0; i < fitCount && reader.isValid(); i++) {
+        UINT32 columns = reader.getUint32();
+        if (columns > (UINT32)data.size())
+            return U_INVALID_FILE;
+        for (UINT32 j = 0; j < columns && reader.isValid(); j++)
+            fitTable[i].first.push_back(reader.getString());
+        fitTable[i].second = reader.getUint32();
+    }
+
+    UString securityInfo = reader.getString();
+    UString fitSecurityInfo = reader.getString();
+    UINT64 addressDiff = reader.getUint64();
+    UINT32 imageBase = reader.getUint32();
+    UINT64 protectedRegionsBase = reader.getUint64();
+    UINT32 rangeCount = reader.getUint32();
+    if (rangeCount > (UINT32)data.size())
+        return U_INVALID_FILE;
+    std::vector<PROTECTED_RANGE> protectedRanges(rangeCount);
+    for (UINT32 i = 0; i < rangeCount && reader.isValid(); i++) {
+        protectedRanges[i].Offset = reader.getUint32();
+        protectedRanges[i].Size = reader.getUint32();
+        protectedRanges[i].AlgorithmId = (UINT16)reader.getUint32();
+        protectedRanges[i].Type = reader.getUint8();
+        protectedRanges[i].Hash = reader.getBytes();
+    }
+    UINT32 lastVtf = reader.getUint32();
+    UINT32 dxeCore = reader.getUint32();
+    USTATUS parseResult = (USTATUS)reader.getUint32();
+    if (!reader.getSignature() || !reader.atEnd())
+        return U_INVALID_FILE;
+
+    // Add items to the model, flags are restored as they were stored instead of being propagated again
+    std::vector<UModelIndex> indices(count);
+    for (UINT32 i = 0; i < count; i++) {
+        const PARSE_CACHE_ITEM & item = items[i];
+        UModelIndex parent = item.parent == PARSE_CACHE_NO_ITEM ? UModelIndex() : indices[item.parent];
+        UModelIndex index = model->addItem(item.offset, item.type, item.subtype, item.name, item.text, item.info,
+                                           item.header, item.body, item.tail, Movable, parent);
+        TreeItem* treeItem = static_cast<TreeItem*>(index.internalPointer());
+        treeItem->setFixed((item.flags & PARSE_CACHE_ITEM_FIXED) != 0);
+        treeItem->setInfoGenerator(FfsParser::infoGeneratorById(item.generator));
+        treeItem->restoreLocationInfo(item.location, item.address);
+        model->setCompressed(index, (item.flags & PARSE_CACHE_ITEM_COMPRESSED) != 0);
+        if (item.marking)
+            model->setMarking(index, item.marking);
+        if (item.action)
+            model->setAction(index, item.action);
+        if (!item.parsingData.isEmpty())
+            model->setParsingData(index, item.parsingData);
+        if (!item.uncompressedData.isEmpty())
+            model->setUncompressedData(index, item.uncompressedData);
+        indices[i] = index;
+    }
+    items.clear();
+
+    result.result = parseResult;
+    result.addressDiff = addressDiff;
+    result.imageBase = imageBase;
+    result.protectedRegionsBase = protectedRegionsBase;
+    result.protectedRanges = protectedRanges;
+    result.lastVtf = lastVtf < count ? indices[lastVtf] : UModelIndex();
+    result.dxeCore = dxeCore < count ? indices[dxeCore] : UModelIndex();
+    result.securityInfo = securityInfo;
+    result.fitSecurityInfo = fitSecurityInfo;
+    for (size_t i = 0; i < messages.size(); i++)
+        result.messages.push_back(std::make_pair(messages[i].first, messages[i].second < count ? indices[messages[i].second] : UModelIndex()));
+    for (size_t i = 0; i < fitTable.size(); i++)
+        result.fitTable.push_back(std::make_pair(fitTable[i].first, fitTable[i].second < count ? indices[fitTable[i].second] : UModelIndex()));
+
+    return U_SUCCESS;
+}
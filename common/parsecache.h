@@ -0,0 +1,54 @@
+/* parsecache.h
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+*/
+
+#ifndef PARSECACHE_H
+#define PARSECACHE_H
+
+#include <vector>
+
+#include "basetypes.h"
+#include "ustring.h"
+#include "ubytearray.h"
+#include "treemodel.h"
+#include "ffsparser.h"
+
+// Bump this when the layout of cache files changes
+#define PARSE_CACHE_FORMAT_VERSION 3
+
+// Bump this with every change of parsers, tree items or tree model that changes the results for the same image,
+// cache files are keyed on it and on the program version only, so rebuilds stay reproducible
+#define PARSE_CACHE_PARSER_VERSION 2
+
+// Parser results and state that are not stored in the tree model
+typedef struct PARSE_CACHE_RESULT_ {
+    USTATUS result = U_SUCCESS;
+    UINT64  addressDiff = 0x100000000ULL;
+    UString securityInfo;
+    UString fitSecurityInfo;
+    std::vector<std::pair<UString, UModelIndex> > messages;
+    std::vector<std::pair<std::vector<UString>, UModelIndex> > fitTable;
+    UINT32  imageBase = 0;
+    UINT64  protectedRegionsBase = 0;
+    std::vector<PROTECTED_RANGE> protectedRanges;
+    UModelIndex lastVtf;
+    UModelIndex dxeCore;
+} PARSE_CACHE_RESULT;
+
+// Restores items of a previously parsed image from the cache file named after its SHA-256 digest,
+// items are appended to the model root only if the whole file is valid for the current build
+USTATUS parseCacheLoad(const UString & directory, const UByteArray & image, const UByteArray & digest, TreeModel* model, PARSE_CACHE_RESULT & result);
+
+// Stores the given top-level items with all their children and the rest of parser results
+USTATUS parseCacheStore(const UString & directory, const UByteArray & image, const UByteArray & digest, TreeModel* model, const std::vector<UModelIndex> & items, const PARSE_CACHE_RESULT & result);
+
+#endif // PARSECACHE_H
@@ -13,61 +13,394 @@
 
 #include "treeitem.h"
 #include "types.h"
+#include <cstring>
+#include <cstddef>
+#include <new>
+#include <mutex>
+#include <algorithm>
+
+// Arena block size, bigger payloads get blocks of their own
+#define TREE_ITEM_ARENA_BLOCK_SIZE 0x10000
+
+char* TreeItemArena::carve(const size_t size, std::shared_ptr<char> & block)
+{
+    // Sizes are whole granules, so every allocation stays aligned
+    if (blocks.empty() || blockUsed + size > blockSize) {
+        if (size > TREE_ITEM_ARENA_BLOCK_SIZE / 4) {
+            // Keep the current block last, it still has room for small payloads
+            block = std::shared_ptr<char>(new char[size], std::default_delete<char[]>());
+            blocks.insert(blocks.empty() ? blocks.end() : blocks.end() - 1, block);
+            return block.get();
+        }
+        blocks.push_back(std::shared_ptr<char>(new char[TREE_ITEM_ARENA_BLOCK_SIZE], std::default_delete<char[]>()));
+        blockData = blocks.back().get();
+        blockSize = TREE_ITEM_ARENA_BLOCK_SIZE;
+        blockUsed = 0;
+    }
+    char* data = blockData + blockUsed;
+    blockUsed += size;
+    block = blocks.back();
+    return data;
+}
+
+void* TreeItemArena::allocate(const size_t size)
+{
+    const size_t rounded = capacity(size ? size : 1);
+    const size_t sizeClass = rounded / granule();
+    if (sizeClass < freeLists.size() && freeLists[sizeClass]) {
+        void* data = freeLists[sizeClass];
+        freeLists[sizeClass] = *(void**)data;
+        return data;
+    }
+    std::shared_ptr<char> block;
+    return carve(rounded, block);
+}
+
+void TreeItemArena::release(void* data, const size_t size)
+{
+    if (!data)
+        return;
+    const size_t rounded = capacity(size ? size : 1);
+    if (rounded > TREE_ITEM_ARENA_BLOCK_SIZE / 4) {
+        // Big allocations have blocks of their own, that are freed right away
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].get() == data) {
+                blocks.erase(blocks.begin() + i);
+                break;
+            }
+        }
+        return;
+    }
+    const size_t sizeClass = rounded / granule();
+    if (sizeClass >= freeLists.size())
+        freeLists.resize(sizeClass + 1, NULL);
+    *(void**)data = freeLists[sizeClass];
+    freeLists[sizeClass] = data;
+}
+
+UByteArray TreeItemArena::storeBytes(const char* data, const size_t size)
+{
+#if defined(QT_CORE_LIB)
+    // Qt byte arrays can't share ownership of the block, so they keep their own copy
+    return UByteArray(data, (int)size);
+#else
+    if (size == 0)
+        return UByteArray();
+    // Copies of the array may outlive the item, so its bytes are never released to be reused
+    std::shared_ptr<char> block;
+    char* copy = carve(capacity(size), block);
+    memcpy(copy, data, size);
+    // The array shares ownership of the whole block, so it needs no allocation of its own
+    return UByteArray(std::shared_ptr<const char>(block, copy), (int32_t)size);
+#endif
+}
+
+TreeItem* TreeItem::create(TreeItemArena *arena, const UINT32 offset, const UINT8 type, const UINT8 subtype,
+                           const UString & name, const UString & text, const UString & info,
+                           const UByteArray & header, const UByteArray & body, const UByteArray & tail,
+                           const bool fixed, const bool compressed,
+                           TreeItem *parent)
+{
+    return new (arena->allocate(sizeof(TreeItem))) TreeItem(offset, type, subtype, name, text, info, header, body, tail, fixed, compressed, arena, parent);
+}
+
+void TreeItem::destroy(TreeItem *item)
+{
+    // Destroy the item and all of its descendants, their memory goes back to the arena to be reused
+    std::vector<TreeItem*> items;
+    TreeItem *current = item;
+    while (current) {
+        items.insert(items.end(), current->childItems.begin(), current->childItems.end());
+        current->releaseString(current->itemName);
+        current->releaseString(current->itemText);
+        current->releaseString(current->itemInfo);
+        TreeItemArena *arena = current->itemArena;
+        current->~TreeItem();
+        arena->release(current, sizeof(TreeItem));
+        current = NULL;
+        if (!items.empty()) {
+            current = items.back();
+            items.pop_back();
+        }
+    }
+}
 
 TreeItem::TreeItem(const UINT32 offset, const UINT8 type, const UINT8 subtype,
                    const UString & name, const UString & text, const UString & info,
                    const UByteArray & header, const UByteArray & body, const UByteArray & tail,
                    const bool fixed, const bool compressed,
-                   TreeItem *parent) :
+                   TreeItemArena *arena, TreeItem *parent) :
+itemRow(0),
 itemOffset(offset),
+itemBase(parent ? parent->itemBase + offset : offset),
 itemAction(Actions::NoAction),
 itemType(type),
 itemSubtype(subtype),
 itemMarking(0),
-itemName(name),
-itemText(text),
-itemInfo(info),
+itemName(),
+itemText(),
+itemInfo(),
+itemInfoGenerator(NULL),
+itemInfoAddress(0),
+itemInfoLocation(0),
 itemHeader(header),
 itemBody(body),
+itemBodyFillSize(0),
+itemBodyFill(0),
 itemTail(tail),
 itemFixed(fixed),
 itemCompressed(compressed),
-parentItem(parent)
+parentItem(parent),
+itemArena(arena)
 {
+#if defined(QT_CORE_LIB)
+    itemFetchedCount = 0;
+#endif
+    setString(itemName, name);
+    setString(itemText, text);
+    setString(itemInfo, info);
 }
 
-TreeItem::~TreeItem() {
-    std::list<TreeItem*>::iterator begin = childItems.begin();
-    while (begin != childItems.end()) {
-        delete *begin;
-        ++begin;
+UString TreeItem::getString(const TREE_ITEM_STRING & str) const
+{
+#if defined(QT_CORE_LIB)
+    return str;
+#else
+    return str.size ? UString(str.data, (int)str.size) : UString();
+#endif
+}
+
+void TreeItem::setString(TREE_ITEM_STRING & str, const UString & value)
+{
+#if defined(QT_CORE_LIB)
+    str = value;
+#else
+    const UINT32 size = (UINT32)value.length();
+    if (size > str.capacity) {
+        releaseString(str);
+        str.capacity = (UINT32)TreeItemArena::capacity(size);
+        str.data = (char*)itemArena->allocate(str.capacity);
+    }
+    if (size)
+        memcpy(str.data, (const char*)value, size);
+    str.size = size;
+#endif
+}
+
+void TreeItem::appendString(TREE_ITEM_STRING & str, const UString & value)
+{
+#if defined(QT_CORE_LIB)
+    str += value;
+#else
+    const UINT32 size = (UINT32)value.length();
+    if (size == 0)
+        return;
+    if (str.size + size > str.capacity) {
+        // Capacity at least doubles, so repeated appends take linear time and space
+        const UINT32 capacity = (UINT32)TreeItemArena::capacity(std::max(str.size + size, str.capacity * 2));
+        char* data = (char*)itemArena->allocate(capacity);
+        if (str.size)
+            memcpy(data, str.data, str.size);
+        itemArena->release(str.data, str.capacity);
+        str.data = data;
+        str.capacity = capacity;
+    }
+    memcpy(str.data + str.size, (const char*)value, size);
+    str.size += size;
+#endif
+}
+
+void TreeItem::releaseString(TREE_ITEM_STRING & str)
+{
+#if defined(QT_CORE_LIB)
+    str = UString();
+#else
+    itemArena->release(str.data, str.capacity);
+    str.data = NULL;
+    str.size = 0;
+    str.capacity = 0;
+#endif
+}
+
+void TreeItem::updateRows(const size_t first)
+{
+    // Renumber children starting from the first one that has moved
+    for (size_t i = first; i < childItems.size(); i++)
+        childItems[i]->itemRow = (int)i;
+}
+
+void TreeItem::setOffset(const UINT32 offset)
+{
+    // Shift cached bases of this item and all of its descendants by the same delta
+    UINT32 delta = offset - itemOffset;
+    itemOffset = offset;
+    std::vector<TreeItem*> items(1, this);
+    while (!items.empty()) {
+        TreeItem *item = items.back();
+        items.pop_back();
+        item->itemBase += delta;
+        items.insert(items.end(), item->childItems.begin(), item->childItems.end());
     }
 }
 
 UINT8 TreeItem::insertChildBefore(TreeItem *item, TreeItem *newItem)
 {
-    std::list<TreeItem*>::iterator found = std::find(childItems.begin(), childItems.end(), item);
-    if (found == childItems.end())
+    if (!item || item->parentItem != this || child(item->itemRow) != item)
         return U_ITEM_NOT_FOUND;
-    childItems.insert(found, newItem);
+    size_t row = (size_t)item->itemRow;
+    childItems.insert(childItems.begin() + row, newItem);
+    updateRows(row);
     return U_SUCCESS;
 }
 
 UINT8 TreeItem::insertChildAfter(TreeItem *item, TreeItem *newItem)
 {
-    std::list<TreeItem*>::iterator found = std::find(childItems.begin(), childItems.end(), item);
-    if (found == childItems.end())
+    if (!item || item->parentItem != this || child(item->itemRow) != item)
         return U_ITEM_NOT_FOUND;
-    childItems.insert(++found, newItem);
+    size_t row = (size_t)item->itemRow + 1;
+    childItems.insert(childItems.begin() + row, newItem);
+    updateRows(row);
     return U_SUCCESS;
 }
 
+void TreeItem::compactBody()
+{
+    // Replace a body made of a single repeated byte with that byte and its count
+    UINT32 size = (UINT32)itemBody.size();
+    if (size == 0)
+        return;
+    const UINT8* data = (const UINT8*)itemBody.constData();
+    if (data[0] != data[size - 1] || memcmp(data, data + 1, size - 1) != 0)
+        return;
+    itemBodyFill = data[0];
+    itemBodyFillSize = size;
+    itemBody = UByteArray();
+}
+
+UByteArray TreeItem::fillBytes(const UINT8 fill, const UINT32 size)
+{
+    static std::mutex lock;
+    std::lock_guard<std::mutex> guard(lock);
+#if defined(QT_CORE_LIB)
+    // Qt byte arrays can't share a part of another array, so the last expanded body of each fill value is shared
+    // with repeated requests of the same size and replaced by the next one, it is released with the last array using it
+    static QByteArray blocks[256];
+    if ((UINT32)blocks[fill].size() != size)
+        blocks[fill] = QByteArray((int)size, (char)fill);
+    return blocks[fill];
+#else
+    // Compacted bodies are views of a single block per fill value, shared by all items and grown on demand,
+    // so expanding them neither allocates nor fills memory again, outgrown blocks are released with the last array using them
+    static std::shared_ptr<const char> blocks[256];
+    static UINT32 blockSizes[256];
+    if (blockSizes[fill] < size) {
+        UINT32 newSize = std::max(size, blockSizes[fill] * 2);
+        char* block = new char[newSize];
+        memset(block, fill, newSize);
+        blocks[fill] = std::shared_ptr<const char>(block, std::default_delete<char[]>());
+        blockSizes[fill] = newSize;
+    }
+    return UByteArray(blocks[fill], (int32_t)size);
+#endif
+}
+
+// Location info flags
+#define TREE_ITEM_LOCATION_OFFSET  0x01
+#define TREE_ITEM_LOCATION_BASE    0x02
+#define TREE_ITEM_LOCATION_ADDRESS 0x04
+
+void TreeItem::setLocationInfo(const bool hasBase, const bool hasAddress, const UINT32 address)
+{
+    itemInfoLocation = TREE_ITEM_LOCATION_OFFSET;
+    if (hasBase) {
+        itemInfoLocation |= TREE_ITEM_LOCATION_BASE;
+        if (hasAddress) {
+            itemInfoLocation |= TREE_ITEM_LOCATION_ADDRESS;
+            itemInfoAddress = address;
+        }
+    }
+}
+
+UString TreeItem::info() const
+{
+    if (!itemInfoLocation && !itemInfoGenerator)
+        return getString(itemInfo);
+    
+    // Location goes first, followed by the generated info and the stored remainder
+    UString info;
+    if (itemInfoLocation) {
+        info = usprintf("Fixed: %s\n", itemFixed ? "Yes" : "No");
+        if (itemInfoLocation & TREE_ITEM_LOCATION_BASE) {
+            info += usprintf("Base: %Xh\n", itemBase);
+            if (itemInfoLocation & TREE_ITEM_LOCATION_ADDRESS) {
+                UINT32 headerSize = (UINT32)itemHeader.size();
+                if (headerSize) {
+                    info += usprintf("Header address: %08Xh\nData address: %08Xh\n", itemInfoAddress, itemInfoAddress + headerSize);
+                }
+                else {
+                    info += usprintf("Address: %08Xh\n", itemInfoAddress);
+                }
+            }
+        }
+        info += usprintf("Offset: %Xh\n", itemOffset);
+    }
+    if (itemInfoGenerator)
+        info += itemInfoGenerator(this);
+    return info + getString(itemInfo);
+}
+
+void TreeItem::addInfo(const UString &info, const bool append)
+{
+    if (append) {
+        appendString(itemInfo, info);
+    }
+    else {
+        // Text added in front has to precede the generated parts, so they are stored from now on
+        setString(itemInfo, info + this->info());
+        itemInfoGenerator = NULL;
+        itemInfoLocation = 0;
+    }
+}
+
+void TreeItem::removeChildren(const int first)
+{
+    // Destroy all children starting from the given row
+    if (first < 0 || first >= (int)childItems.size())
+        return;
+    for (size_t i = (size_t)first; i < childItems.size(); i++)
+        destroy(childItems[i]);
+    childItems.erase(childItems.begin() + first, childItems.end());
+}
+
+TreeItem* TreeItem::createStandIn()
+{
+    // Same place in the tree as this item, but not among the children of its parent,
+    // items added under it are invisible to everything that walks the tree
+    TreeItem *standIn = create(itemArena, itemOffset, itemType, itemSubtype, UString(), UString(), UString(),
+                               itemHeader, UByteArray(), UByteArray(), itemFixed, itemCompressed, parentItem);
+    standIn->itemRow = itemRow;
+    standIn->itemBase = itemBase;
+    return standIn;
+}
+
+void TreeItem::adoptChildren(TreeItem *item)
+{
+    // Move all children of the item to the end of children of this item
+    for (size_t i = 0; i < item->childItems.size(); i++) {
+        TreeItem *child = item->childItems[i];
+        child->parentItem = this;
+        child->itemRow = (int)childItems.size();
+        childItems.push_back(child);
+    }
+    item->childItems.clear();
+}
+
 UString TreeItem::data(int column) const
 {
     switch (column)
     {
         case 0: // Name
-            return itemName;
+            return getString(itemName);
         case 1: // Action
             return actionTypeToUString(itemAction);
         case 2: // Type
@@ -75,27 +408,8 @@ UString TreeItem::data(int column) const
         case 3: // Subtype
             return itemSubtypeToUString(itemType, itemSubtype);
         case 4: // Text
-            return itemText;
+            return getString(itemText);
         default:
             return UString();
     }
 }
-
-int TreeItem::row() const
-{
-    if (parentItem) {
-        std::list<TreeItem*>::const_iterator iter = parentItem->childItems.begin();
-        for (int i = 0; i < (int)parentItem->childItems.size(); ++i, ++iter) {
-            if (const_cast<TreeItem*>(this) == *iter)
-                return i;
-        }
-    }
-    return 0;
-}
-
-TreeItem* TreeItem::child(int row)
-{
-    std::list<TreeItem*>::iterator child = childItems.begin();
-    std::advance(child, row);
-    return *child;
-}
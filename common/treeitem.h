@@ -14,39 +14,97 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #ifndef TREEITEM_H
 #define TREEITEM_H
 
-#include <list>
-#include <iterator>
+#include <vector>
+#include <memory>
+#include <cstddef>
 
 #include "basetypes.h"
 #include "ubytearray.h"
 #include "ustring.h"
 
+class TreeItem;
+
+// Memory arena of a tree model, tree items and their small payloads are carved out of large blocks
+// that are released all at once when the model is destroyed
+// Memory released before that goes to free lists of its size and is reused by later allocations
+class TreeItemArena
+{
+public:
+    TreeItemArena() : blockData(NULL), blockUsed(0), blockSize(0) {}
+
+    // Sizes are rounded up to whole granules, so allocations can be released and reused
+    static size_t capacity(const size_t size) { return (size + granule() - 1) & ~(granule() - 1); }
+    void* allocate(const size_t size);                                         // Non-trivial implementation in CPP file
+    void release(void* data, const size_t size);                               // Non-trivial implementation in CPP file
+    UByteArray storeBytes(const char* data, const size_t size);                // Non-trivial implementation in CPP file
+    UByteArray storeBytes(const UByteArray & bytes) { return storeBytes(bytes.constData(), (size_t)bytes.size()); }
+
+private:
+    static size_t granule() { return alignof(std::max_align_t); }
+
+    // Blocks are refcounted, so byte arrays made by storeBytes() stay valid even after the arena is gone
+    std::vector<std::shared_ptr<char> > blocks;
+    char*  blockData;
+    size_t blockUsed;
+    size_t blockSize;
+    // Heads of lists of released allocations by their size in granules, each one starts with a pointer to the next
+    std::vector<void*> freeLists;
+
+    char* carve(const size_t size, std::shared_ptr<char> & block);
+};
+
+#if defined(QT_CORE_LIB)
+// Qt strings are implicitly shared, items keep them as is
+typedef UString TREE_ITEM_STRING;
+#else
+// String bytes stored in the arena, appends fill the rest of the capacity in place
+typedef struct TREE_ITEM_STRING_ {
+    char*  data;
+    UINT32 size;
+    UINT32 capacity;
+} TREE_ITEM_STRING;
+#endif
+
+// Produces the part of item info that is derived from item data, called only when the info is requested
+typedef UString (*TreeItemInfoGenerator)(const TreeItem* item);
+
 class TreeItem
 {
 public:
-    TreeItem(const UINT32 offset, const UINT8 type, const UINT8 subtype, const UString &name, const UString &text, const UString &info,
+    // Items live in the arena of their model, so they are created and destroyed through it
+    static TreeItem* create(TreeItemArena *arena, const UINT32 offset, const UINT8 type, const UINT8 subtype, const UString &name, const UString &text, const UString &info,
         const UByteArray & header, const UByteArray & body, const UByteArray & tail,
         const bool fixed, const bool compressed,
-        TreeItem *parent = 0);
-    ~TreeItem();                                                               // Non-trivial implementation in CPP file
+        TreeItem *parent = 0);                                                 // Non-trivial implementation in CPP file
+    static void destroy(TreeItem *item);                                       // Non-trivial implementation in CPP file
 
     // Operations with items
-    void appendChild(TreeItem *item) { childItems.push_back(item); }
-    void prependChild(TreeItem *item) { childItems.push_front(item); };
+    void appendChild(TreeItem *item) { item->itemRow = (int)childItems.size(); childItems.push_back(item); }
+    void prependChild(TreeItem *item) { childItems.insert(childItems.begin(), item); updateRows(0); };
     UINT8 insertChildBefore(TreeItem *item, TreeItem *newItem);                // Non-trivial implementation in CPP file
     UINT8 insertChildAfter(TreeItem *item, TreeItem *newItem);                 // Non-trivial implementation in CPP file
+    void removeChildren(const int first);                                      // Non-trivial implementation in CPP file
+    TreeItem* createStandIn();                                                 // Non-trivial implementation in CPP file
+    void adoptChildren(TreeItem *item);                                        // Non-trivial implementation in CPP file
 
     // Model support operations
-    TreeItem *child(int row);                                                  // Non-trivial implementation in CPP file
+    TreeItem *child(int row) { return (row >= 0 && row < (int)childItems.size()) ? childItems[row] : NULL; }
     int childCount() const {return (int)childItems.size(); }
     int columnCount() const { return 5; }
     UString data(int column) const;                                            // Non-trivial implementation in CPP file
-    int row() const;                                                           // Non-trivial implementation in CPP file
+    int row() const { return parentItem ? itemRow : 0; }
     TreeItem *parent() { return parentItem; }
+    const TreeItem *parent() const { return parentItem; }
+#if defined(QT_CORE_LIB)
+    int fetchedCount() const { return itemFetchedCount; }                      // Number of children already shown by views
+    void setFetchedCount(const int count) { itemFetchedCount = count; }
+#endif
 
     // Getters and setters for item parameters
     UINT32 offset() const { return itemOffset; }
-    void setOffset(const UINT32 offset) { itemOffset = offset; }
+    void setOffset(const UINT32 offset);                                       // Non-trivial implementation in CPP file
+
+    UINT32 base() const { return itemBase; }
 
     UINT8 type() const  { return itemType; }
     void setType(const UINT8 type) { itemType = type; }
@@ -54,24 +112,37 @@ public:
     UINT8 subtype() const { return itemSubtype; }
     void setSubtype(const UINT8 subtype) { itemSubtype = subtype; }
 
-    UString name() const  { return itemName; }
-    void setName(const UString &text) { itemName = text; }
+    UString name() const  { return getString(itemName); }
+    void setName(const UString &text) { setString(itemName, text); }
 
-    UString text() const { return itemText; }
-    void setText(const UString &text) { itemText = text; }
+    UString text() const { return getString(itemText); }
+    void setText(const UString &text) { setString(itemText, text); }
 
     UByteArray header() const { return itemHeader; }
     bool hasEmptyHeader() const { return itemHeader.isEmpty(); }
 
-    UByteArray body() const { return itemBody; };
-    bool hasEmptyBody() const { return itemBody.isEmpty(); }
+    UByteArray body() const { return itemBodyFillSize ? fillBytes(itemBodyFill, itemBodyFillSize) : itemBody; };
+    bool hasEmptyBody() const { return itemBodyFillSize == 0 && itemBody.isEmpty(); }
+    UINT32 bodySize() const { return itemBodyFillSize ? itemBodyFillSize : (UINT32)itemBody.size(); }
+    bool hasFillBody() const { return itemBodyFillSize != 0; }
+    UINT8 bodyFill() const { return itemBodyFill; }
+    void compactBody();                                                        // Non-trivial implementation in CPP file
 
     UByteArray tail() const { return itemTail; };
     bool hasEmptyTail() const { return itemTail.isEmpty(); }
 
-    UString info() const { return itemInfo; }
-    void addInfo(const UString &info, const bool append) { if (append) itemInfo += info; else itemInfo = info + itemInfo; }
-    void setInfo(const UString &info) { itemInfo = info; }
+    UString info() const;                                                      // Non-trivial implementation in CPP file
+    void addInfo(const UString &info, const bool append);                      // Non-trivial implementation in CPP file
+    void setInfo(const UString &info) { setString(itemInfo, info); itemInfoGenerator = NULL; itemInfoLocation = 0; }
+    void setInfoGenerator(const TreeItemInfoGenerator generator) { itemInfoGenerator = generator; }
+    void setLocationInfo(const bool hasBase, const bool hasAddress, const UINT32 address); // Non-trivial implementation in CPP file
+
+    // Parts of info as they are stored, without generating the rest
+    UString storedInfo() const { return getString(itemInfo); }
+    TreeItemInfoGenerator infoGenerator() const { return itemInfoGenerator; }
+    UINT8 locationInfo() const { return itemInfoLocation; }
+    UINT32 locationInfoAddress() const { return itemInfoAddress; }
+    void restoreLocationInfo(const UINT8 location, const UINT32 address) { itemInfoLocation = location; itemInfoAddress = address; }
     
     UINT8 action() const {return itemAction; }
     void setAction(const UINT8 action) { itemAction = action; }
@@ -84,7 +155,8 @@ public:
 
     UByteArray parsingData() const { return itemParsingData; };
     bool hasEmptyParsingData() const { return itemParsingData.isEmpty(); }
-    void setParsingData(const UByteArray & pdata) { itemParsingData = pdata; }
+    void setParsingData(const UByteArray & pdata) { itemParsingData = itemArena->storeBytes(pdata); }
+    void setParsingData(const void* pdata, const UINT32 size) { itemParsingData = itemArena->storeBytes((const char*)pdata, size); }
 
     UByteArray uncompressedData() const { return itemUncompressedData; };
     bool hasEmptyUncompressedData() const { return itemUncompressedData.isEmpty(); }
@@ -94,23 +166,46 @@ public:
     void setMarking(const UINT8 marking) { itemMarking = marking; }
 
 private:
-    std::list<TreeItem*> childItems;
+    TreeItem(const UINT32 offset, const UINT8 type, const UINT8 subtype, const UString &name, const UString &text, const UString &info,
+        const UByteArray & header, const UByteArray & body, const UByteArray & tail,
+        const bool fixed, const bool compressed,
+        TreeItemArena *arena, TreeItem *parent);
+    ~TreeItem() {}
+    void updateRows(const size_t first);                                       // Non-trivial implementation in CPP file
+    static UByteArray fillBytes(const UINT8 fill, const UINT32 size);          // Non-trivial implementation in CPP file
+    UString getString(const TREE_ITEM_STRING & str) const;                     // Non-trivial implementation in CPP file
+    void setString(TREE_ITEM_STRING & str, const UString & value);             // Non-trivial implementation in CPP file
+    void appendString(TREE_ITEM_STRING & str, const UString & value);          // Non-trivial implementation in CPP file
+    void releaseString(TREE_ITEM_STRING & str);                                // Non-trivial implementation in CPP file
+
+    std::vector<TreeItem*> childItems;
+    int        itemRow;
+#if defined(QT_CORE_LIB)
+    int        itemFetchedCount;
+#endif
     UINT32     itemOffset;
+    UINT32     itemBase;
     UINT8      itemAction;
     UINT8      itemType;
     UINT8      itemSubtype;
     UINT8      itemMarking;
-    UString    itemName;
-    UString    itemText;
-    UString    itemInfo;
+    TREE_ITEM_STRING itemName;
+    TREE_ITEM_STRING itemText;
+    TREE_ITEM_STRING itemInfo;
+    TreeItemInfoGenerator itemInfoGenerator;
+    UINT32     itemInfoAddress;
+    UINT8      itemInfoLocation;
     UByteArray itemHeader;
     UByteArray itemBody;
+    UINT32     itemBodyFillSize;
+    UINT8      itemBodyFill;
     UByteArray itemTail;
     bool       itemFixed;
     bool       itemCompressed;
     UByteArray itemParsingData;
     UByteArray itemUncompressedData;
     TreeItem*  parentItem;
+    TreeItemArena* itemArena;
 };
 
 #endif // TREEITEM_H
@@ -14,8 +14,12 @@
 #include "treemodel.h"
 
 #include "stack"
+#include <algorithm>
 
 #if defined(QT_CORE_LIB)
+// Children are shown by views in batches of this size, so expanding a huge branch only lays out its beginning
+#define TREE_MODEL_FETCH_BATCH_SIZE 256
+
 QVariant TreeModel::data(const UModelIndex &index, int role) const
 {
     if (!index.isValid())
@@ -67,6 +71,53 @@ QVariant TreeModel::headerData(int section, Qt::Orientation orientation,
     
     return QVariant();
 }
+
+bool TreeModel::hasChildren(const UModelIndex &parent) const
+{
+    return childCount(parent) > 0;
+}
+
+bool TreeModel::canFetchMore(const UModelIndex &parent) const
+{
+    if (parent.column() > 0)
+        return false;
+    
+    TreeItem *parentItem = parent.isValid() ? static_cast<TreeItem*>(parent.internalPointer()) : rootItem;
+    return parentItem->fetchedCount() < parentItem->childCount();
+}
+
+void TreeModel::fetchMore(const UModelIndex &parent)
+{
+    if (parent.column() > 0)
+        return;
+    
+    TreeItem *parentItem = parent.isValid() ? static_cast<TreeItem*>(parent.internalPointer()) : rootItem;
+    fetchRows(parent, parentItem->fetchedCount() + TREE_MODEL_FETCH_BATCH_SIZE);
+}
+
+void TreeModel::fetchItem(const UModelIndex &index)
+{
+    if (!index.isValid())
+        return;
+    
+    // Parents have to be shown first
+    UModelIndex parent = index.parent();
+    fetchItem(parent);
+    fetchRows(parent, (index.row() / TREE_MODEL_FETCH_BATCH_SIZE + 1) * TREE_MODEL_FETCH_BATCH_SIZE);
+}
+
+void TreeModel::fetchRows(const UModelIndex &parent, const int count)
+{
+    TreeItem *parentItem = parent.isValid() ? static_cast<TreeItem*>(parent.internalPointer()) : rootItem;
+    int first = parentItem->fetchedCount();
+    int last = std::min(count, parentItem->childCount());
+    if (last <= first)
+        return;
+    
+    beginInsertRows(parent, first, last - 1);
+    parentItem->setFetchedCount(last);
+    endInsertRows();
+}
 #else
 UString TreeModel::data(const UModelIndex &index, int role) const
 {
@@ -112,6 +163,7 @@ int TreeModel::columnCount(const UModelIndex &parent) const
 
 UModelIndex TreeModel::index(int row, int column, const UModelIndex &parent) const
 {
+    // Views get only the children they have fetched
     if (!hasIndex(row, column, parent))
         return UModelIndex();
     
@@ -129,6 +181,40 @@ UModelIndex TreeModel::index(int row, int column, const UModelIndex &parent) con
         return UModelIndex();
 }
 
+bool TreeModel::isFetched(const UModelIndex &index) const
+{
+#if defined(QT_CORE_LIB)
+    const TreeItem *item = index.isValid() ? static_cast<TreeItem*>(index.internalPointer()) : rootItem;
+    for (; item != rootItem && item->parent(); item = item->parent()) {
+        if (item->row() >= item->parent()->fetchedCount())
+            return false;
+    }
+#else
+    U_UNUSED_PARAMETER(index);
+#endif
+    return true;
+}
+
+UModelIndex TreeModel::childIndex(int row, const UModelIndex &parent) const
+{
+    // Children not yet fetched by views are accessible too
+    if (parent.column() > 0)
+        return UModelIndex();
+    
+    TreeItem *parentItem;
+    
+    if (!parent.isValid())
+        parentItem = rootItem;
+    else
+        parentItem = static_cast<TreeItem*>(parent.internalPointer());
+    
+    TreeItem *childItem = parentItem->child(row);
+    if (childItem)
+        return createIndex(row, 0, childItem);
+    else
+        return UModelIndex();
+}
+
 UModelIndex TreeModel::parent(const UModelIndex &index) const
 {
     if (!index.isValid())
@@ -147,6 +233,19 @@ UModelIndex TreeModel::parent(const UModelIndex &index) const
 }
 
 int TreeModel::rowCount(const UModelIndex &parent) const
+{
+#if defined(QT_CORE_LIB)
+    if (parent.column() > 0)
+        return 0;
+    
+    TreeItem *parentItem = parent.isValid() ? static_cast<TreeItem*>(parent.internalPointer()) : rootItem;
+    return std::min(parentItem->fetchedCount(), parentItem->childCount());
+#else
+    return childCount(parent);
+#endif
+}
+
+int TreeModel::childCount(const UModelIndex &parent) const
 {
     TreeItem *parentItem;
     if (parent.column() > 0)
@@ -160,18 +259,22 @@ int TreeModel::rowCount(const UModelIndex &parent) const
     return parentItem->childCount();
 }
 
-UINT32 TreeModel::base(const UModelIndex &current) const
+UINT32 TreeModel::base(const UModelIndex &index) const
 {
-    // Rewrite this as loop if we ever see an image that is too deep for this naive implementation
-    if (!current.isValid())
+    if (!index.isValid())
         return 0;
-    
-    UModelIndex parent = current.parent();
-    if (!parent.isValid())
-        return offset(current);
-    else {
-        return offset(current) + base(parent);
-    }
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    return item->base();
+}
+
+bool TreeModel::hasFlatBase(const UModelIndex &index) const
+{
+    // Base is meaningful only for items that are not compressed,
+    // or are compressed but have an uncompressed parent
+    if (!index.isValid())
+        return false;
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    return !item->compressed() || (item->parent() && item->parent() != rootItem && !item->parent()->compressed());
 }
 
 UINT32 TreeModel::offset(const UModelIndex &index) const
@@ -238,6 +341,23 @@ bool TreeModel::hasEmptyBody(const UModelIndex &index) const
     return item->hasEmptyBody();
 }
 
+UINT32 TreeModel::bodySize(const UModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    return item->bodySize();
+}
+
+bool TreeModel::hasFillBody(const UModelIndex &index, UINT8 & fill) const
+{
+    if (!index.isValid())
+        return false;
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    fill = item->bodyFill();
+    return item->hasFillBody();
+}
+
 UByteArray TreeModel::tail(const UModelIndex &index) const
 {
     if (!index.isValid())
@@ -324,7 +444,7 @@ void TreeModel::setFixed(const UModelIndex &index, const bool fixed)
         setFixed(index.parent(), true);
     }
     
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setCompressed(const UModelIndex &index, const bool compressed)
@@ -334,22 +454,23 @@ void TreeModel::setCompressed(const UModelIndex &index, const bool compressed)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setCompressed(compressed);
+    invalidateSpans();
     
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::TreeModel::setMarkingEnabled(const bool enabled)
 {
     markingEnabledFlag = enabled;
     
-    emit dataChanged(UModelIndex(), UModelIndex());
+    notifyDataChanged(UModelIndex(), UModelIndex());
 }
 
 void TreeModel::TreeModel::setMarkingDarkMode(const bool enabled)
 {
     markingDarkModeFlag = enabled;
 
-    emit dataChanged(UModelIndex(), UModelIndex());
+    notifyDataChanged(UModelIndex(), UModelIndex());
 }
 
 void TreeModel::setMarking(const UModelIndex &index, const UINT8 marking)
@@ -360,7 +481,7 @@ void TreeModel::setMarking(const UModelIndex &index, const UINT8 marking)
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setMarking(marking);
     
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setOffset(const UModelIndex &index, const UINT32 offset)
@@ -370,7 +491,8 @@ void TreeModel::setOffset(const UModelIndex &index, const UINT32 offset)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setOffset(offset);
-    emit dataChanged(index, index);
+    invalidateSpans();
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setType(const UModelIndex &index, const UINT8 data)
@@ -380,7 +502,7 @@ void TreeModel::setType(const UModelIndex &index, const UINT8 data)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setType(data);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setSubtype(const UModelIndex & index, const UINT8 subtype)
@@ -390,7 +512,7 @@ void TreeModel::setSubtype(const UModelIndex & index, const UINT8 subtype)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setSubtype(subtype);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setName(const UModelIndex &index, const UString &data)
@@ -400,7 +522,7 @@ void TreeModel::setName(const UModelIndex &index, const UString &data)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setName(data);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setText(const UModelIndex &index, const UString &data)
@@ -410,7 +532,7 @@ void TreeModel::setText(const UModelIndex &index, const UString &data)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setText(data);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setInfo(const UModelIndex &index, const UString &data)
@@ -420,7 +542,7 @@ void TreeModel::setInfo(const UModelIndex &index, const UString &data)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setInfo(data);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::addInfo(const UModelIndex &index, const UString &data, const bool append)
@@ -430,7 +552,27 @@ void TreeModel::addInfo(const UModelIndex &index, const UString &data, const boo
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->addInfo(data, append);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
+}
+
+void TreeModel::setInfoGenerator(const UModelIndex &index, const TreeItemInfoGenerator generator)
+{
+    if (!index.isValid())
+        return;
+    
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    item->setInfoGenerator(generator);
+    notifyDataChanged(index, index);
+}
+
+void TreeModel::setLocationInfo(const UModelIndex &index, const bool hasBase, const bool hasAddress, const UINT32 address)
+{
+    if (!index.isValid())
+        return;
+    
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    item->setLocationInfo(hasBase, hasAddress, address);
+    notifyDataChanged(index, index);
 }
 
 void TreeModel::setAction(const UModelIndex &index, const UINT8 action)
@@ -440,7 +582,7 @@ void TreeModel::setAction(const UModelIndex &index, const UINT8 action)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setAction(action);
-    emit dataChanged(index, index);
+    notifyDataChanged(index, index);
 }
 
 UByteArray TreeModel::parsingData(const UModelIndex &index) const
@@ -468,7 +610,17 @@ void TreeModel::setParsingData(const UModelIndex &index, const UByteArray &data)
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setParsingData(data);
-    emit dataChanged(this->index(0, 0), index);
+    notifyDataChanged(this->index(0, 0), index);
+}
+
+void TreeModel::setParsingData(const UModelIndex &index, const void* data, const UINT32 size)
+{
+    if (!index.isValid())
+        return;
+    
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    item->setParsingData(data, size);
+    notifyDataChanged(this->index(0, 0), index);
 }
 
 UByteArray TreeModel::uncompressedData(const UModelIndex &index) const
@@ -496,7 +648,7 @@ void TreeModel::setUncompressedData(const UModelIndex &index, const UByteArray &
     
     TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
     item->setUncompressedData(data);
-    emit dataChanged(this->index(0, 0), index);
+    notifyDataChanged(this->index(0, 0), index);
 }
 
 UModelIndex TreeModel::addItem(const UINT32 offset, const UINT8 type, const UINT8 subtype,
@@ -524,36 +676,129 @@ UModelIndex TreeModel::addItem(const UINT32 offset, const UINT8 type, const UINT
         }
     }
     
-    TreeItem *newItem = new TreeItem(offset, type, subtype, name, text, info, header, body, tail, Movable, this->compressed(parent), parentItem);
+    TreeItem *newItem = TreeItem::create(&arena, offset, type, subtype, name, text, info, header, body, tail, Movable, this->compressed(parent), parentItem);
     
-    if (mode == CREATE_MODE_APPEND) {
-        emit layoutAboutToBeChanged();
-        parentItem->appendChild(newItem);
+    // Empty areas are usually megabytes of the same byte, keep them as run-length descriptors expanded on access
+    if ((type == Types::Padding && subtype != Subtypes::DataPadding) || type == Types::FreeSpace)
+        newItem->compactBody();
+    
+    if (mode != CREATE_MODE_APPEND && mode != CREATE_MODE_PREPEND && mode != CREATE_MODE_BEFORE && mode != CREATE_MODE_AFTER) {
+        TreeItem::destroy(newItem);
+        return UModelIndex();
     }
-    else if (mode == CREATE_MODE_PREPEND) {
+    
+    if (updateDepth == 0)
         emit layoutAboutToBeChanged();
+    
+    if (mode == CREATE_MODE_APPEND)
+        parentItem->appendChild(newItem);
+    else if (mode == CREATE_MODE_PREPEND)
         parentItem->prependChild(newItem);
-    }
-    else if (mode == CREATE_MODE_BEFORE) {
-        emit layoutAboutToBeChanged();
+    else if (mode == CREATE_MODE_BEFORE)
         parentItem->insertChildBefore(item, newItem);
-    }
-    else if (mode == CREATE_MODE_AFTER) {
-        emit layoutAboutToBeChanged();
+    else
         parentItem->insertChildAfter(item, newItem);
-    }
-    else {
-        delete newItem;
-        return UModelIndex();
-    }
     
-    emit layoutChanged();
+#if defined(QT_CORE_LIB)
+    // Items inserted into the part of the children already shown by views are shown right away
+    if (parentItem->fetchedCount() > 0 && newItem->row() <= parentItem->fetchedCount())
+        parentItem->setFetchedCount(parentItem->fetchedCount() + 1);
+#endif
+    
+    if (updateDepth == 0)
+        emit layoutChanged();
+    invalidateSpans();
+    createdItems++;
     
     UModelIndex created = createIndex(newItem->row(), parentColumn, newItem);
     setFixed(created, (bool)fixed); // Non-trivial logic requires additional call
     return created;
 }
 
+void TreeModel::removeChildren(const UModelIndex & parent, const int first)
+{
+    TreeItem *parentItem = parent.isValid() ? static_cast<TreeItem*>(parent.internalPointer()) : rootItem;
+    if (first < 0 || first >= parentItem->childCount())
+        return;
+    
+#if defined(QT_CORE_LIB)
+    // Views know only about the rows they have fetched
+    int shown = std::min(parentItem->fetchedCount(), parentItem->childCount());
+    bool notify = updateDepth == 0 && first < shown;
+    if (notify)
+        beginRemoveRows(parent, first, shown - 1);
+    parentItem->removeChildren(first);
+    if (parentItem->fetchedCount() > first)
+        parentItem->setFetchedCount(first);
+    if (notify)
+        endRemoveRows();
+#else
+    parentItem->removeChildren(first);
+#endif
+    invalidateSpans();
+}
+
+UModelIndex TreeModel::createStandIn(const UModelIndex & index)
+{
+    if (!index.isValid())
+        return UModelIndex();
+    
+    TreeItem *standInItem = static_cast<TreeItem*>(index.internalPointer())->createStandIn();
+    return createIndex(standInItem->row(), 0, standInItem);
+}
+
+void TreeModel::commitStandIn(const UModelIndex & standIn, const UModelIndex & index)
+{
+    if (!standIn.isValid() || !index.isValid())
+        return;
+    
+    TreeItem *standInItem = static_cast<TreeItem*>(standIn.internalPointer());
+    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
+    
+#if defined(QT_CORE_LIB)
+    int first = item->childCount();
+    int count = standInItem->childCount();
+    
+    // Rows appended right after all the rows views have fetched are shown right away, like the ones added by addItem()
+    bool shown = count > 0 && item->fetchedCount() > 0 && item->fetchedCount() == first;
+    bool notify = shown && updateDepth == 0;
+    if (notify)
+        beginInsertRows(index, first, first + count - 1);
+    item->adoptChildren(standInItem);
+    if (shown)
+        item->setFetchedCount(first + count);
+    if (notify)
+        endInsertRows();
+#else
+    item->adoptChildren(standInItem);
+#endif
+    
+    TreeItem::destroy(standInItem);
+    invalidateSpans();
+}
+
+void TreeModel::dropStandIn(const UModelIndex & standIn)
+{
+    // Nothing outside of the stand-in refers to its items, so there is nobody to notify
+    if (standIn.isValid())
+        TreeItem::destroy(static_cast<TreeItem*>(standIn.internalPointer()));
+}
+
+void TreeModel::beginUpdate()
+{
+    if (updateDepth++ == 0)
+        beginResetModel();
+}
+
+void TreeModel::endUpdate()
+{
+    if (updateDepth == 0)
+        return;
+    
+    if (--updateDepth == 0)
+        endResetModel();
+}
+
 UModelIndex TreeModel::findParentOfType(const UModelIndex& index, UINT8 type) const
 {
     if (!index.isValid() || !index.parent().isValid())
@@ -591,24 +836,124 @@ UModelIndex TreeModel::findLastParentOfType(const UModelIndex& index, UINT8 type
     return lastParentOfType;
 }
 
+void TreeModel::buildSpans() const
+{
+    spans.clear();
+    if (rootItem->childCount() == 0)
+        return;
+
+    // Collect all items with meaningful base below the first top-level item,
+    // children of items without meaningful base can't have one either
+    std::vector<std::pair<TreeItem*, int> > items;
+    items.push_back(std::make_pair(rootItem->child(0), 0));
+    while (!items.empty()) {
+        TreeItem *item = items.back().first;
+        int depth = items.back().second;
+        items.pop_back();
+        for (int i = 0; i < item->childCount(); i++) {
+            TreeItem *child = item->child(i);
+            if (child->compressed() && item->compressed())
+                continue;
+            UINT32 fullSize = (UINT32)(child->header().size() + child->bodySize() + child->tail().size());
+            if (fullSize) {
+                TREE_ITEM_SPAN span = {};
+                span.begin = child->base();
+                span.end = span.begin + fullSize;
+                span.depth = depth + 1;
+                span.item = child;
+                spans.push_back(span);
+            }
+            items.push_back(std::make_pair(child, depth + 1));
+        }
+    }
+    std::stable_sort(spans.begin(), spans.end());
+
+    // Spans sorted by begin form an implicit balanced search tree with the middle span as its root,
+    // store the maximum end of every subtree in its root to be able to prune subtrees during lookup
+    std::vector<std::pair<size_t, size_t> > ranges;
+    std::vector<std::pair<size_t, size_t> > order;
+    ranges.push_back(std::make_pair((size_t)0, spans.size()));
+    while (!ranges.empty()) {
+        std::pair<size_t, size_t> range = ranges.back();
+        ranges.pop_back();
+        if (range.first >= range.second)
+            continue;
+        order.push_back(range);
+        size_t middle = range.first + (range.second - range.first) / 2;
+        ranges.push_back(std::make_pair(range.first, middle));
+        ranges.push_back(std::make_pair(middle + 1, range.second));
+    }
+    // Subtrees are always visited after their roots, so walk them in reverse
+    for (std::vector<std::pair<size_t, size_t> >::reverse_iterator it = order.rbegin(); it != order.rend(); ++it) {
+        size_t middle = it->first + (it->second - it->first) / 2;
+        UINT64 maxEnd = spans[middle].end;
+        if (middle > it->first)
+            maxEnd = std::max(maxEnd, spans[it->first + (middle - it->first) / 2].maxEnd);
+        if (middle + 1 < it->second)
+            maxEnd = std::max(maxEnd, spans[middle + 1 + (it->second - middle - 1) / 2].maxEnd);
+        spans[middle].maxEnd = maxEnd;
+    }
+}
+
+void TreeModel::collectSpans(size_t first, size_t last, UINT64 address, std::vector<const TREE_ITEM_SPAN*> & found) const
+{
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+        if (spans[middle].maxEnd <= address)
+            return;
+        collectSpans(first, middle, address, found);
+        if (spans[middle].begin > address)
+            return;
+        if (address < spans[middle].end)
+            found.push_back(&spans[middle]);
+        first = middle + 1;
+    }
+}
+
+void TreeModel::findCoveringItems(UINT32 address, std::vector<std::pair<std::pair<int, int>, TreeItem*> > & items) const
+{
+    std::lock_guard<std::mutex> lock(spansMutex);
+    if (!spansValid) {
+        buildSpans();
+        spansValid = true;
+    }
+
+    std::vector<const TREE_ITEM_SPAN*> found;
+    collectSpans(0, spans.size(), address, found);
+
+    // Order covering items from outermost to innermost, and by row on the same level
+    items.clear();
+    for (size_t i = 0; i < found.size(); i++)
+        items.push_back(std::make_pair(std::make_pair(found[i]->depth, found[i]->item->row()), found[i]->item));
+    std::sort(items.begin(), items.end());
+}
+
+std::vector<UModelIndex> TreeModel::findAllCovering(UINT32 address) const
+{
+    std::vector<std::pair<std::pair<int, int>, TreeItem*> > items;
+    findCoveringItems(address, items);
+
+    std::vector<UModelIndex> covering;
+    for (size_t i = 0; i < items.size(); i++)
+        covering.push_back(createIndex(items[i].second->row(), 0, items[i].second));
+    return covering;
+}
+
 UModelIndex TreeModel::findByBase(UINT32 base) const
 {
-    UModelIndex parentIndex = index(0,0);
-    
-goDeeper:
-    int n = rowCount(parentIndex);
-    for (int i = 0; i < n; i++) {
-        UModelIndex currentIndex = parentIndex.model()->index(i, 0, parentIndex);
-        
-        UINT32 currentBase = this->base(currentIndex);
-        UINT32 fullSize = (UINT32)(header(currentIndex).size() + body(currentIndex).size() + tail(currentIndex).size());
-        if ((compressed(currentIndex) == false || (compressed(currentIndex) == true && compressed(currentIndex.parent()) == false)) // Base is meaningful only for true uncompressed items
-            && currentBase <= base && base < currentBase + fullSize) { // Base must be in range [currentBase, currentBase + fullSize)
-            // Found a better candidate
-            parentIndex = currentIndex;
-            goto goDeeper;
+    std::vector<std::pair<std::pair<int, int>, TreeItem*> > items;
+    findCoveringItems(base, items);
+
+    // Descend from the first top-level item choosing the first covering child on each level,
+    // items are ordered by level and row, so the first match on the next level is that child
+    TreeItem *current = rootItem->child(0);
+    int depth = 0;
+    for (size_t i = 0; i < items.size() && items[i].first.first <= depth + 1; i++) {
+        if (items[i].first.first == depth + 1 && items[i].second->parent() == current) {
+            current = items[i].second;
+            depth++;
         }
     }
-    
-    return (parentIndex == index(0, 0) ? UModelIndex() : parentIndex);
+
+    return (current == rootItem->child(0) ? UModelIndex() : createIndex(current->row(), 0, current));
 }
@@ -14,6 +14,10 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #ifndef TREEMODEL_H
 #define TREEMODEL_H
 
+#include <vector>
+#include <mutex>
+#include <atomic>
+
 enum ItemFixedState {
     Movable,
     Fixed
@@ -90,10 +94,21 @@ private:
 };
 #endif
 
+// Span of the absolute address space occupied by an item with meaningful base
+typedef struct TREE_ITEM_SPAN_ {
+    UINT64    begin;
+    UINT64    end;
+    UINT64    maxEnd;  // Maximum end of all spans in the implicit search subtree rooted at this span
+    int       depth;
+    TreeItem* item;
+    friend bool operator< (const struct TREE_ITEM_SPAN_ & lhs, const struct TREE_ITEM_SPAN_ & rhs) { return lhs.begin < rhs.begin; }
+} TREE_ITEM_SPAN;
+
 #if defined(QT_CORE_LIB)
 class TreeModel : public QAbstractItemModel
 {
 private:
+    TreeItemArena arena;
     TreeItem *rootItem;
     bool markingEnabledFlag;
     bool markingDarkModeFlag;
@@ -103,8 +118,15 @@ public:
     Qt::ItemFlags flags(const UModelIndex &index) const;
     QVariant headerData(int section, Qt::Orientation orientation,
         int role = Qt::DisplayRole) const;
-    TreeModel(QObject *parent = 0) : QAbstractItemModel(parent), markingEnabledFlag(true), markingDarkModeFlag(false) {
-        rootItem = new TreeItem(0, Types::Root, 0, UString(), UString(), UString(), UByteArray(), UByteArray(), UByteArray(), true, false);
+
+    // Views get children of an item in batches, rowCount() returns the number of children fetched so far
+    bool hasChildren(const UModelIndex &parent = UModelIndex()) const;
+    bool canFetchMore(const UModelIndex &parent) const;
+    void fetchMore(const UModelIndex &parent);
+    // Fetch the item and all its parents, so views can show it
+    void fetchItem(const UModelIndex &index);
+    TreeModel(QObject *parent = 0) : QAbstractItemModel(parent), markingEnabledFlag(true), markingDarkModeFlag(false), updateDepth(0), createdItems(0), spansValid(false) {
+        rootItem = TreeItem::create(&arena, 0, Types::Root, 0, UString(), UString(), UString(), UByteArray(), UByteArray(), UByteArray(), true, false);
     }
 
 #else
@@ -113,6 +135,7 @@ public:
 class TreeModel
 {
 private:
+    TreeItemArena arena;
     TreeItem *rootItem;
     bool markingEnabledFlag;
     bool markingDarkModeFlag;
@@ -120,13 +143,15 @@ private:
     void dataChanged(const UModelIndex &, const UModelIndex &) {}
     void layoutAboutToBeChanged() {}
     void layoutChanged() {}
+    void beginResetModel() {}
+    void endResetModel() {}
 
 public:
     UString data(const UModelIndex &index, int role) const;
     UString headerData(int section, int orientation, int role = 0) const;
 
-    TreeModel() : markingEnabledFlag(false), markingDarkModeFlag(false) {
-        rootItem = new TreeItem(0, Types::Root, 0, UString(), UString(), UString(), UByteArray(), UByteArray(), UByteArray(), true, false);
+    TreeModel() : markingEnabledFlag(false), markingDarkModeFlag(false), updateDepth(0), createdItems(0), spansValid(false) {
+        rootItem = TreeItem::create(&arena, 0, Types::Root, 0, UString(), UString(), UString(), UByteArray(), UByteArray(), UByteArray(), true, false);
     }
 
     bool hasIndex(int row, int column, const UModelIndex &parent = UModelIndex()) const {
@@ -139,7 +164,7 @@ public:
 #endif
 
     ~TreeModel() {
-        delete rootItem;
+        TreeItem::destroy(rootItem);
     }
 
     bool markingEnabled() { return markingEnabledFlag; }
@@ -151,12 +176,16 @@ public:
     UModelIndex index(int row, int column, const UModelIndex &parent = UModelIndex()) const;
     UModelIndex parent(const UModelIndex &index) const;
     int rowCount(const UModelIndex &parent = UModelIndex()) const;
+    // All children of the item, including the ones views have not fetched yet
+    int childCount(const UModelIndex &parent = UModelIndex()) const;
+    UModelIndex childIndex(int row, const UModelIndex &parent = UModelIndex()) const;
     int columnCount(const UModelIndex &parent = UModelIndex()) const;
 
     UINT8 action(const UModelIndex &index) const;
     void setAction(const UModelIndex &index, const UINT8 action);
 
     UINT32 base(const UModelIndex &index) const;
+    bool hasFlatBase(const UModelIndex &index) const;
     UINT32 offset(const UModelIndex &index) const;
     void setOffset(const UModelIndex &index, const UINT32 offset);
 
@@ -175,6 +204,8 @@ public:
     UString info(const UModelIndex &index) const;
     void setInfo(const UModelIndex &index, const UString &info);
     void addInfo(const UModelIndex &index, const UString &info, const bool append = true);
+    void setInfoGenerator(const UModelIndex &index, const TreeItemInfoGenerator generator);
+    void setLocationInfo(const UModelIndex &index, const bool hasBase, const bool hasAddress, const UINT32 address);
 
     bool fixed(const UModelIndex &index) const;
     void setFixed(const UModelIndex &index, const bool fixed);
@@ -194,6 +225,8 @@ public:
 
     UByteArray body(const UModelIndex &index) const;
     bool hasEmptyBody(const UModelIndex &index) const;
+    UINT32 bodySize(const UModelIndex &index) const;
+    bool hasFillBody(const UModelIndex &index, UINT8 & fill) const;
 
     UByteArray tail(const UModelIndex &index) const;
     bool hasEmptyTail(const UModelIndex &index) const;
@@ -201,16 +234,56 @@ public:
     UByteArray parsingData(const UModelIndex &index) const;
     bool hasEmptyParsingData(const UModelIndex &index) const;
     void setParsingData(const UModelIndex &index, const UByteArray &pdata);
+    void setParsingData(const UModelIndex &index, const void* pdata, const UINT32 size);
 
     UModelIndex addItem(const UINT32 offset, const UINT8 type, const UINT8 subtype,
         const UString & name, const UString & text, const UString & info,
         const UByteArray & header, const UByteArray & body, const UByteArray & tail,
         const ItemFixedState fixed,
         const UModelIndex & parent = UModelIndex(), const UINT8 mode = CREATE_MODE_APPEND);
+    void removeChildren(const UModelIndex & parent, const int first);
+
+    // Items can be built under a stand-in of an item outside of the tree, unseen by views and lookups,
+    // and then either moved under the item at once or dropped together with the stand-in
+    UModelIndex createStandIn(const UModelIndex & index);
+    void commitStandIn(const UModelIndex & standIn, const UModelIndex & index);
+    void dropStandIn(const UModelIndex & standIn);
+
+    // Structural changes made between these calls are announced to views as a single model reset,
+    // per-item layout and data change signals are suppressed until the outermost endUpdate()
+    void beginUpdate();
+    void endUpdate();
+
+    // Number of items added to the model so far, removed items included
+    UINT32 itemsCreated() const { return createdItems; }
 
     UModelIndex findParentOfType(const UModelIndex & index, UINT8 type) const;
     UModelIndex findLastParentOfType(const UModelIndex & index, UINT8 type) const;
     UModelIndex findByBase(UINT32 base) const;
+    std::vector<UModelIndex> findAllCovering(UINT32 address) const;
+
+private:
+#if defined(QT_CORE_LIB)
+    void fetchRows(const UModelIndex &parent, const int count);
+#endif
+    int updateDepth;
+    UINT32 createdItems;
+    void notifyDataChanged(const UModelIndex &topLeft, const UModelIndex &bottomRight) {
+        if (updateDepth == 0 && isFetched(topLeft) && isFetched(bottomRight))
+            emit dataChanged(topLeft, bottomRight);
+    }
+    // Views know only about items fetched together with all their parents
+    bool isFetched(const UModelIndex &index) const;
+
+    // Interval index over items with meaningful base, rebuilt lazily after the tree changes,
+    // lookups may come from several threads at once, so building and searching it is serialized
+    mutable std::vector<TREE_ITEM_SPAN> spans;
+    mutable std::atomic<bool> spansValid;
+    mutable std::mutex spansMutex;
+    void invalidateSpans() { spansValid = false; }
+    void buildSpans() const;
+    void collectSpans(size_t first, size_t last, UINT64 address, std::vector<const TREE_ITEM_SPAN*> & found) const;
+    void findCoveringItems(UINT32 address, std::vector<std::pair<std::pair<int, int>, TreeItem*> > & items) const;
 };
 
 #if defined(QT_CORE_LIB)
@@ -20,63 +20,115 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #else
 // Use own implementation
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <string>
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <algorithm>
 
+// Byte array is a view of (offset, length) into a refcounted backing buffer,
+// so copies and left/right/mid slices share bytes with the array they were made from.
+// The backing buffer is either owned by the arrays or is external read-only memory, i.e. a mapped file.
+// Write access (non-const data(), operator[], begin(), end()) detaches the view first.
+// NOTE: constData() of a slice is not guaranteed to be NUL-terminated, and is NULL for an array without a backing buffer
 class UByteArray
 {
 public:
-    UByteArray() : d() {}
-    UByteArray(const UByteArray & ba) : d(ba.d) {}
-    UByteArray(const std::basic_string<char> & bs) : d(bs) {}
-    UByteArray(const std::vector<char> & bc) : d(bc.data(), bc.size()) {}
-    UByteArray(const char* bytes, int32_t size) : d(bytes, size) {}
-    UByteArray(const size_t n, char c) : d(n, c) {}
+    UByteArray() : d(), e(), o(0), l(0) {}
+    UByteArray(const UByteArray & ba) : d(ba.d), e(ba.e), o(ba.o), l(ba.l) {}
+    UByteArray(const std::basic_string<char> & bs) : d(), e(), o(0), l(0) { assign(bs.data(), (int32_t)bs.size()); }
+    UByteArray(const std::vector<char> & bc) : d(), e(), o(0), l(0) { assign(bc.data(), (int32_t)bc.size()); }
+    UByteArray(const char* bytes, int32_t size) : d(), e(), o(0), l(0) { assign(bytes, size); }
+    UByteArray(const size_t n, char c) : d(), e(), o(0), l(0) { if (n) { d = std::make_shared<std::basic_string<char> >(n, c); l = (int32_t)n; } }
+    // External bytes are released by the deleter of the storage once the last view of them is gone
+    UByteArray(const std::shared_ptr<const char> & storage, int32_t size) : d(), e(), o(0), l(0) { if (storage && size > 0) { e = storage; l = size; } }
     ~UByteArray() {}
 
-    bool isEmpty() const { return d.length() == 0; }
-       
-    char* data() { return d.length() == 0 ? NULL : &(d.at(0)); /* Feels dirty, but works for all basic_string implementations I know, is fully OK in C++11 and later*/ }
-    const char* data() const { return d.c_str(); }
-    const char* constData() const { return d.c_str(); }
-    void clear() { d.clear(); }
+    // Refers to external bytes without copying them, the caller must keep them alive while the array or its slices are in use
+    static UByteArray fromRawData(const char* bytes, int32_t size) { return UByteArray(std::shared_ptr<const char>(bytes, [](const char*) {}), size); }
 
-    UByteArray toUpper() { std::basic_string<char> s = d; std::transform(s.begin(), s.end(), s.begin(), ::toupper); return UByteArray(s); }
-    uint32_t toUInt(bool* ok = NULL, const uint8_t base = 10) { return (uint32_t)strtoul(d.c_str(), NULL, base); }
+    bool isEmpty() const { return l == 0; }
 
-    int32_t size() const { return (int32_t)d.size();  }
-    int32_t count(char ch) const { return (int32_t)std::count(d.begin(), d.end(), ch); }
-    char at(uint32_t i) const { return d.at(i); }
-    char operator[](uint32_t i) const { return d[i]; }
-    char& operator[](uint32_t i) { return d[i]; }
+    char* data() { if (l == 0) return NULL; detach(); return &((*d)[o]); }
+    const char* data() const { return constData(); }
+    const char* constData() const { return e ? e.get() + o : (d ? d->data() + o : NULL); }
+    void clear() { d.reset(); e.reset(); o = 0; l = 0; }
 
-    bool startsWith(const UByteArray & ba) const { return 0 == d.find(ba.d, 0); }
-    int indexOf(const UByteArray & ba, int from = 0) const { return (int)d.find(ba.d, from); }
+    UByteArray toUpper() { std::basic_string<char> s(constData(), l); std::transform(s.begin(), s.end(), s.begin(), ::toupper); return UByteArray(s); }
+    uint32_t toUInt(bool* ok = NULL, const uint8_t base = 10) { return (uint32_t)strtoul(std::basic_string<char>(constData(), l).c_str(), NULL, base); }
+
+    int32_t size() const { return l;  }
+    int32_t count(char ch) const { return (int32_t)std::count(begin(), end(), ch); }
+    char at(uint32_t i) const { return constData()[i]; }
+    char operator[](uint32_t i) const { return constData()[i]; }
+    char& operator[](uint32_t i) { return data()[i]; }
+
+    bool startsWith(const UByteArray & ba) const { return ba.l <= l && (ba.l == 0 || 0 == memcmp(constData(), ba.constData(), ba.l)); }
+    int indexOf(const UByteArray & ba, int from = 0) const {
+        if (from < 0)
+            from = 0;
+        if (from > l || ba.l > l - from)
+            return -1;
+        const char* found = std::search(begin() + from, end(), ba.begin(), ba.end());
+        return (found == end() && ba.l != 0) ? -1 : (int)(found - begin());
+    }
     int lastIndexOf(const UByteArray & ba, int from = 0) const {
-        size_t old_index = d.npos;
-        size_t index = d.find(ba.d, from);
-        while (index != d.npos) {
+        int old_index = -1;
+        int index = indexOf(ba, from);
+        while (index != -1) {
             old_index = index;
-            index = d.find(ba.d, index + 1);
+            index = indexOf(ba, index + 1);
         }
-        return (int)old_index;
+        return old_index;
     }
 
-    UByteArray left(int32_t len) const { return d.substr(0, len); }
-    UByteArray right(int32_t len) const { return d.substr(d.size() - len, len); }
-    UByteArray mid(int32_t pos, int32_t len = -1) const { return d.substr(pos, len); }
+    UByteArray left(int32_t len) const { return mid(0, len); }
+    UByteArray right(int32_t len) const { return (len < 0 || len >= l) ? *this : mid(l - len, len); }
+    UByteArray mid(int32_t pos, int32_t len = -1) const {
+        if (pos < 0 || pos >= l)
+            return UByteArray();
+        if (len < 0 || len > l - pos)
+            len = l - pos;
+        UByteArray ba;
+        if (len > 0) {
+            ba.d = d;
+            ba.e = e;
+            ba.o = o + pos;
+            ba.l = len;
+        }
+        return ba;
+    }
 
-    UByteArray & operator=(const UByteArray & ba) { d = ba.d; return *this; }
-    UByteArray & operator+=(const UByteArray & ba) { d += ba.d; return *this; }
-    bool operator== (const UByteArray & ba) const { return d == ba.d; }
-    bool operator!= (const UByteArray & ba) const { return d != ba.d; }
-    inline void swap(UByteArray &other) { std::swap(d, other.d); }
+    UByteArray & operator=(const UByteArray & ba) { d = ba.d; e = ba.e; o = ba.o; l = ba.l; return *this; }
+    UByteArray & operator+=(const UByteArray & ba) {
+        if (ba.l == 0)
+            return *this;
+        if (l == 0)
+            return *this = ba;
+        // Append in place only if this view solely owns the whole backing buffer
+        if (e || !(isSoleOwner() && o == 0 && (size_t)l == d->size())) {
+            std::shared_ptr<std::basic_string<char> > n = std::make_shared<std::basic_string<char> >();
+            n->reserve((size_t)l + ba.l);
+            n->assign(constData(), l);
+            d = n;
+            e.reset();
+            o = 0;
+        }
+        d->append(ba.constData(), ba.l);
+        l += ba.l;
+        return *this;
+    }
+    bool operator== (const UByteArray & ba) const { return l == ba.l && (l == 0 || 0 == memcmp(constData(), ba.constData(), l)); }
+    bool operator!= (const UByteArray & ba) const { return !(*this == ba); }
+    inline void swap(UByteArray &other) { std::swap(d, other.d); std::swap(e, other.e); std::swap(o, other.o); std::swap(l, other.l); }
     UByteArray toHex() {
         std::basic_string<char> hex(size() * 2, '\x00');
+        const char* p = constData();
         for (int32_t i = 0; i < size(); i++) {
-            uint8_t low  = d[i] & 0x0F;
-            uint8_t high = (d[i] & 0xF0) >> 4;
+            uint8_t low  = p[i] & 0x0F;
+            uint8_t high = (p[i] & 0xF0) >> 4;
             low += (low < 10 ? '0' : 'a' - 10);
             high += (high < 10 ? '0' : 'a' - 10);
             hex[2*i] = high;
@@ -85,13 +137,41 @@ public:
         return UByteArray(hex);
     }
 
-    std::basic_string<char>::iterator begin() {return d.begin();}
-    std::basic_string<char>::iterator end() {return d.end();}
-    std::basic_string<char>::const_iterator begin() const {return d.begin();}
-    std::basic_string<char>::const_iterator end() const {return d.end();}
-    
+    char* begin() { return l == 0 ? NULL : data(); }
+    char* end() { return l == 0 ? NULL : data() + l; }
+    const char* begin() const { return constData(); }
+    const char* end() const { return constData() + l; }
+
 private:
-    std::basic_string<char> d;
+    std::shared_ptr<std::basic_string<char> > d;
+    std::shared_ptr<const char> e;
+    int32_t o;
+    int32_t l;
+
+    void assign(const char* bytes, int32_t size) {
+        if (bytes != NULL && size > 0) {
+            d = std::make_shared<std::basic_string<char> >(bytes, (size_t)size);
+            l = size;
+        }
+    }
+
+    // Views released by other threads may have been reading the buffer until just now,
+    // the fence orders those reads before any write that follows a positive check
+    bool isSoleOwner() const {
+        if (d.use_count() != 1)
+            return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+    }
+
+    // Make this view the sole owner of its bytes before they get modified
+    void detach() {
+        if (!e && isSoleOwner())
+            return;
+        d = std::make_shared<std::basic_string<char> >(constData(), (size_t)l);
+        e.reset();
+        o = 0;
+    }
 };
 
 inline const UByteArray operator+(const UByteArray &a1, const UByteArray &a2)
@@ -112,8 +112,8 @@ UString uFromUcs2(const char* str, size_t max_len)
     // Naive implementation assuming that only ASCII LE part of UCS2 is used, str may not be aligned.
     UString msg;
     const char *str8 = str;
-    size_t rest = (max_len == 0) ? SIZE_MAX : max_len;
-    while (str8[0] && rest) {
+    size_t rest = max_len;
+    while (rest && str8[0]) {
         msg += str8[0];
         str8 += 2;
         rest--;
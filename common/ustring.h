@@ -33,6 +33,7 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 UString usprintf(const char* fmt, ...) ATTRIBUTE_FORMAT_(printf, 1, 2);
 UString urepeated(char c, int len);
-UString uFromUcs2(const char* str, size_t max_len = 0);
+// Converts at most max_len UCS-2 characters up to the first NUL, data is not expected to be NUL-terminated
+UString uFromUcs2(const char* str, size_t max_len);
 
 #endif // USTRING_H
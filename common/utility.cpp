@@ -14,6 +14,12 @@
 #include <cstdio>
 #include <cctype>
 #include <cstring>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <atomic>
 
 #include "treemodel.h"
 #include "utility.h"
@@ -22,6 +28,30 @@
 #include "Tiano/EfiTianoDecompress.h"
 #include "LZMA/LzmaCompress.h"
 #include "LZMA/LzmaDecompress.h"
+#include "digest/sha1.h"
+#include "digest/sha2.h"
+#include "digest/sm3.h"
+
+// Baseline vector instruction set of the target, can also be chosen by the build
+#if !defined(U_USE_SSE2) && !defined(U_USE_NEON)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define U_USE_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define U_USE_NEON
+#endif
+#endif
+
+#if defined(U_USE_SSE2)
+#include <emmintrin.h>
+// AVX2 routines are built with the instruction set enabled only for them, and are used if the CPU supports it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define U_USE_AVX2
+#define U_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(U_USE_NEON)
+#include <arm_neon.h>
+#endif
 
 // Returns bytes as string when all bytes are ascii visible, hex representation otherwise
 UString visibleAsciiOrHex(UINT8* bytes, UINT32 length)
@@ -190,21 +220,133 @@ UString errorCodeToUString(USTATUS errorCode)
         case U_STORES_NOT_FOUND:                return UString("Stores not found");
         case U_INVALID_STORE_SIZE:              return UString("Invalid store size");
         case U_INVALID_STORE:                   return UString("Invalid store");
+        case U_ABORTED:                         return UString("Operation aborted");
         default:                                return usprintf("Unknown error %02lX", errorCode);
     }
 }
 
+// Largest spill buffer kept by a thread after a call
+#define DECOMPRESSION_SPILL_CAP 0x100000
+
+// Decompressor state kept between calls made by the same thread
+class DecompressionContext
+{
+public:
+    DecompressionContext() : spill(NULL), spillSize(0), inflateReady(false) { LzmaDec_Construct(&lzma); memset(&stream, 0, sizeof(stream)); }
+    ~DecompressionContext() { free(spill); if (inflateReady) inflateEnd(&stream); LzmaDecompressFreeState(&lzma); }
+    
+    // EFI 1.1/Tiano scratch space
+    std::vector<UINT8> scratch;
+    // Inflate output that does not fit into the pre-sized buffer, kept uninitialized
+    UINT8* spill;
+    size_t spillSize;
+    // LZMA decoder with probability tables
+    CLzmaDec lzma;
+    
+    // Returns the inflate stream reset for the given window bits, NULL if it can't be initialized
+    z_stream* inflateStream(const int windowBits) {
+        if (inflateReady) {
+            if (inflateReset2(&stream, windowBits) == Z_OK)
+                return &stream;
+            inflateEnd(&stream);
+            inflateReady = false;
+        }
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, windowBits) != Z_OK)
+            return NULL;
+        inflateReady = true;
+        return &stream;
+    }
+    
+    // Frees the spill buffer if it outgrew the size worth keeping between calls
+    void trimSpill() {
+        if (spillSize > DECOMPRESSION_SPILL_CAP) {
+            free(spill);
+            spill = NULL;
+            spillSize = 0;
+        }
+    }
+    
+private:
+    z_stream stream;
+    bool inflateReady;
+};
+
+static DecompressionContext & decompressionContext()
+{
+    static thread_local DecompressionContext context;
+    return context;
+}
+
+// Allocates an uninitialized byte array of the given size to decompress into, returns its writable data
+static char* allocateDecompressed(UByteArray & decompressed, const UINT32 size)
+{
+#if defined(QT_CORE_LIB)
+    decompressed = UByteArray((int)size, Qt::Uninitialized);
+    return size ? decompressed.data() : NULL;
+#else
+    // The array takes ownership of the buffer, pages are only touched by the decompressor itself
+    char* buffer = (char*)malloc(size ? size : 1);
+    if (!buffer)
+        return NULL;
+    decompressed = UByteArray(std::shared_ptr<const char>(buffer, free), (int32_t)size);
+    return buffer;
+#endif
+}
+
 // Compression routines
+USTATUS standardDecompress(const UByteArray & compressedData, const UINT8 algorithm, UByteArray & decompressedData)
+{
+    UINT32 decompressedSize = 0;
+    UINT32 scratchSize = 0;
+    
+    // Get buffer sizes
+    const UINT8* data = (const UINT8*)compressedData.constData();
+    UINT32 dataSize = (UINT32)compressedData.size();
+    
+    // Check header to be valid
+    const EFI_TIANO_HEADER* header = (const EFI_TIANO_HEADER*)data;
+    if (dataSize < sizeof(EFI_TIANO_HEADER) || header->CompSize + sizeof(EFI_TIANO_HEADER) != dataSize)
+        return U_STANDARD_DECOMPRESSION_FAILED;
+    
+    // Get info function is the same for both algorithms
+    if (U_SUCCESS != EfiTianoGetInfo(data, dataSize, &decompressedSize, &scratchSize))
+        return U_STANDARD_DECOMPRESSION_FAILED;
+    
+    if (decompressedSize > INT32_MAX)
+        return U_STANDARD_DECOMPRESSION_FAILED;
+    
+    // Decompress directly into the resulting array, scratch space is reused
+    UByteArray result;
+    char* decompressed = allocateDecompressed(result, decompressedSize);
+    std::vector<UINT8> & scratch = decompressionContext().scratch;
+    if (!decompressed && decompressedSize)
+        return U_STANDARD_DECOMPRESSION_FAILED;
+    if (scratch.size() < scratchSize)
+        scratch.resize(scratchSize);
+    
+    // Decompress section data using the requested algorithm
+    USTATUS status;
+    if (algorithm == COMPRESSION_ALGORITHM_TIANO)
+        status = TianoDecompress(data, dataSize, decompressed, decompressedSize, scratch.data(), scratchSize);
+    else if (algorithm == COMPRESSION_ALGORITHM_EFI11)
+        status = EfiDecompress(data, dataSize, decompressed, decompressedSize, scratch.data(), scratchSize);
+    else
+        status = U_UNKNOWN_COMPRESSION_TYPE;
+    
+    if (status != U_SUCCESS)
+        return U_STANDARD_DECOMPRESSION_FAILED;
+    
+    decompressedData = result;
+    return U_SUCCESS;
+}
+
 USTATUS decompress(const UByteArray & compressedData, const UINT8 compressionType, UINT8 & algorithm, UINT32 & dictionarySize, UByteArray & decompressedData, UByteArray & efiDecompressedData)
 {
     const UINT8* data;
     UINT32 dataSize;
     UINT8* decompressed;
-    UINT8* efiDecompressed;
     UINT32 decompressedSize = 0;
-    UINT8* scratch;
-    UINT32 scratchSize = 0;
-    const EFI_TIANO_HEADER* header;
     
     // For all but LZMA dictionary size is 0
     dictionarySize = 0;
@@ -217,64 +359,25 @@ USTATUS decompress(const UByteArray & compressedData, const UINT8 compressionTyp
             return U_SUCCESS;
         }
         case EFI_STANDARD_COMPRESSION: {
-            // Set default algorithm to unknown
-            algorithm = COMPRESSION_ALGORITHM_UNKNOWN;
-            
-            // Get buffer sizes
-            data = (UINT8*)compressedData.data();
-            dataSize = (UINT32)compressedData.size();
-            
-            // Check header to be valid
-            header = (const EFI_TIANO_HEADER*)data;
-            if (header->CompSize + sizeof(EFI_TIANO_HEADER) != dataSize)
-                return U_STANDARD_DECOMPRESSION_FAILED;
-            
-            // Get info function is the same for both algorithms
-            if (U_SUCCESS != EfiTianoGetInfo(data, dataSize, &decompressedSize, &scratchSize))
-                return U_STANDARD_DECOMPRESSION_FAILED;
-            
-            // Allocate memory
-            decompressed = (UINT8*)malloc(decompressedSize);
-            efiDecompressed = (UINT8*)malloc(decompressedSize);
-            scratch = (UINT8*)malloc(scratchSize);
-            if (!decompressed || !efiDecompressed || !scratch) {
-                free(decompressed);
-                free(efiDecompressed);
-                free(scratch);
-                return U_STANDARD_DECOMPRESSION_FAILED;
-            }
-            
             // Decompress section data using both algorithms
-            USTATUS result = U_SUCCESS;
-            // Try Tiano
-            USTATUS TianoResult = TianoDecompress(data, dataSize, decompressed, decompressedSize, scratch, scratchSize);
-            // Try EFI 1.1
-            USTATUS EfiResult = EfiDecompress(data, dataSize, efiDecompressed, decompressedSize, scratch, scratchSize);
+            USTATUS TianoResult = standardDecompress(compressedData, COMPRESSION_ALGORITHM_TIANO, decompressedData);
+            USTATUS EfiResult = standardDecompress(compressedData, COMPRESSION_ALGORITHM_EFI11, TianoResult == U_SUCCESS ? efiDecompressedData : decompressedData);
             
-            if (decompressedSize > INT32_MAX) {
-                result = U_STANDARD_DECOMPRESSION_FAILED;
-            }
-            else if (EfiResult == U_SUCCESS && TianoResult == U_SUCCESS) { // Both decompressions are OK
+            if (EfiResult == U_SUCCESS && TianoResult == U_SUCCESS) { // Both decompressions are OK
                 algorithm = COMPRESSION_ALGORITHM_UNDECIDED;
-                decompressedData = UByteArray((const char*)decompressed, (int)decompressedSize);
-                efiDecompressedData = UByteArray((const char*)efiDecompressed, (int)decompressedSize);
             }
             else if (TianoResult == U_SUCCESS) { // Only Tiano is OK
                 algorithm = COMPRESSION_ALGORITHM_TIANO;
-                decompressedData = UByteArray((const char*)decompressed, (int)decompressedSize);
             }
             else if (EfiResult == U_SUCCESS) { // Only EFI 1.1 is OK
                 algorithm = COMPRESSION_ALGORITHM_EFI11;
-                decompressedData = UByteArray((const char*)efiDecompressed, (int)decompressedSize);
             }
             else { // Both decompressions failed
-                result = U_STANDARD_DECOMPRESSION_FAILED;
+                algorithm = COMPRESSION_ALGORITHM_UNKNOWN;
+                return U_STANDARD_DECOMPRESSION_FAILED;
             }
             
-            free(decompressed);
-            free(efiDecompressed);
-            free(scratch);
-            return result;
+            return U_SUCCESS;
         }
         case EFI_CUSTOMIZED_COMPRESSION: {
             // Set default algorithm to unknown
@@ -299,26 +402,22 @@ USTATUS decompress(const UByteArray & compressedData, const UINT8 compressionTyp
                 algorithm = COMPRESSION_ALGORITHM_LZMA;
             }
             
-            // Allocate memory
-            decompressed = (UINT8*)malloc(decompressedSize);
-            if (!decompressed) {
-                return U_OUT_OF_MEMORY;
-            }
-            
-            // Decompress section data
-            if (U_SUCCESS != LzmaDecompress(data, dataSize, decompressed)) {
-                free(decompressed);
+            if (decompressedSize > INT32_MAX) {
                 return U_CUSTOMIZED_DECOMPRESSION_FAILED;
             }
             
-            if (decompressedSize > INT32_MAX) {
-                free(decompressed);
+            // Decompress section data directly into the resulting array, size is taken from LZMA header
+            UByteArray result;
+            decompressed = (UINT8*)allocateDecompressed(result, decompressedSize);
+            if (!decompressed && decompressedSize) {
+                return U_OUT_OF_MEMORY;
+            }
+            if (U_SUCCESS != LzmaDecompressWithState(&decompressionContext().lzma, data, dataSize, decompressed)) {
                 return U_CUSTOMIZED_DECOMPRESSION_FAILED;
             }
             
             dictionarySize = readUnaligned((UINT32*)(data + 1)); // LZMA dictionary size is stored in bytes 1-4 of LZMA properties header
-            decompressedData = UByteArray((const char*)decompressed, (int)decompressedSize);
-            free(decompressed);
+            decompressedData = result;
             return U_SUCCESS;
         }
         case EFI_CUSTOMIZED_COMPRESSION_LZMAF86: {
@@ -335,20 +434,17 @@ USTATUS decompress(const UByteArray & compressedData, const UINT8 compressionTyp
             }
             algorithm = COMPRESSION_ALGORITHM_LZMAF86;
             
-            // Allocate memory
-            decompressed = (UINT8*)malloc(decompressedSize);
-            if (!decompressed) {
-                return U_OUT_OF_MEMORY;
-            }
-            
-            // Decompress section data
-            if (U_SUCCESS != LzmaDecompress(data, dataSize, decompressed)) {
-                free(decompressed);
+            if (decompressedSize > INT32_MAX) {
                 return U_CUSTOMIZED_DECOMPRESSION_FAILED;
             }
             
-            if (decompressedSize > INT32_MAX) {
-                free(decompressed);
+            // Decompress section data directly into the resulting array, size is taken from LZMA header
+            UByteArray result;
+            decompressed = (UINT8*)allocateDecompressed(result, decompressedSize);
+            if (!decompressed && decompressedSize) {
+                return U_OUT_OF_MEMORY;
+            }
+            if (U_SUCCESS != LzmaDecompressWithState(&decompressionContext().lzma, data, dataSize, decompressed)) {
                 return U_CUSTOMIZED_DECOMPRESSION_FAILED;
             }
             
@@ -357,13 +453,11 @@ USTATUS decompress(const UByteArray & compressedData, const UINT8 compressionTyp
             UINT32 state = 0;
             const UINT8 x86LookAhead = 4;
             if (decompressedSize != x86LookAhead + x86_Convert(decompressed, decompressedSize, 0, &state, 0)) {
-                free(decompressed);
                 return U_CUSTOMIZED_DECOMPRESSION_FAILED;
             }
             
             dictionarySize = readUnaligned((UINT32*)(data + 1)); // LZMA dictionary size is stored in bytes 1-4 of LZMA properties header
-            decompressedData = UByteArray((const char*)decompressed, (int)decompressedSize);
-            free(decompressed);
+            decompressedData = result;
             return U_SUCCESS;
         }
         default: {
@@ -375,6 +469,194 @@ USTATUS decompress(const UByteArray & compressedData, const UINT8 compressionTyp
 
 
 
+// Best vector instruction set supported by both the build and the CPU
+static UINT8 supportedSimdLevel()
+{
+#if defined(U_USE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_LEVEL_AVX2;
+#endif
+#if defined(U_USE_SSE2) || defined(U_USE_NEON)
+    return SIMD_LEVEL_BASE;
+#else
+    return SIMD_LEVEL_NONE;
+#endif
+}
+
+// Vector instruction set used by checksum and comparison routines, detected on first use
+static std::atomic<UINT8> & simdLevel()
+{
+    static std::atomic<UINT8> level(supportedSimdLevel());
+    return level;
+}
+
+UINT8 limitSimdLevel(const UINT8 maxLevel)
+{
+    UINT8 level = std::min(maxLevel, supportedSimdLevel());
+    simdLevel().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+// Vector parts of the routines below process the buffer from start on and advance start past the bytes they processed,
+// the rest is done by scalar code
+// Sums are kept in wrapping lanes, which keeps them modulo the counter size just like the scalar counter
+#if defined(U_USE_SSE2)
+static UINT8 sum8Simd(const UINT8* buffer, const UINT32 bufferSize, UINT32 & start)
+{
+    UINT32 index = start;
+    __m128i sums = _mm_setzero_si128();
+    for (; index + 16 <= bufferSize; index += 16)
+        sums = _mm_add_epi8(sums, _mm_loadu_si128((const __m128i*)(buffer + index)));
+    sums = _mm_sad_epu8(sums, _mm_setzero_si128());
+    start = index;
+    return (UINT8)(_mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+}
+
+static UINT16 sum16Simd(const UINT16* buffer, const UINT32 count, UINT32 & start)
+{
+    UINT32 index = start;
+    __m128i sums = _mm_setzero_si128();
+    for (; index + 8 <= count; index += 8)
+        sums = _mm_add_epi16(sums, _mm_loadu_si128((const __m128i*)(buffer + index)));
+    sums = _mm_add_epi16(sums, _mm_srli_si128(sums, 8));
+    sums = _mm_add_epi16(sums, _mm_srli_si128(sums, 4));
+    sums = _mm_add_epi16(sums, _mm_srli_si128(sums, 2));
+    start = index;
+    return (UINT16)_mm_cvtsi128_si32(sums);
+}
+
+static UINT32 sum32Simd(const UINT32* buffer, const UINT32 count, UINT32 & start)
+{
+    UINT32 index = start;
+    __m128i sums = _mm_setzero_si128();
+    for (; index + 4 <= count; index += 4)
+        sums = _mm_add_epi32(sums, _mm_loadu_si128((const __m128i*)(buffer + index)));
+    sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 8));
+    sums = _mm_add_epi32(sums, _mm_srli_si128(sums, 4));
+    start = index;
+    return (UINT32)_mm_cvtsi128_si32(sums);
+}
+
+// Compares 64 bytes at once and stops at the first block with a different byte in it
+static bool allBytesEqualSimd(const UINT8* buffer, const UINT32 bufferSize, const UINT8 value, UINT32 & start)
+{
+    UINT32 index = start;
+    const __m128i pattern = _mm_set1_epi8((char)value);
+    for (; index + 64 <= bufferSize; index += 64) {
+        __m128i equal = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(buffer + index)), pattern),
+                                                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(buffer + index + 16)), pattern)),
+                                      _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(buffer + index + 32)), pattern),
+                                                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(buffer + index + 48)), pattern)));
+        if (_mm_movemask_epi8(equal) != 0xFFFF)
+            return false;
+    }
+    start = index;
+    return true;
+}
+#elif defined(U_USE_NEON)
+static UINT8 sum8Simd(const UINT8* buffer, const UINT32 bufferSize, UINT32 & start)
+{
+    UINT32 index = start;
+    uint8x16_t sums = vdupq_n_u8(0);
+    for (; index + 16 <= bufferSize; index += 16)
+        sums = vaddq_u8(sums, vld1q_u8(buffer + index));
+    start = index;
+    return vaddvq_u8(sums);
+}
+
+static UINT16 sum16Simd(const UINT16* buffer, const UINT32 count, UINT32 & start)
+{
+    UINT32 index = start;
+    uint16x8_t sums = vdupq_n_u16(0);
+    for (; index + 8 <= count; index += 8)
+        sums = vaddq_u16(sums, vreinterpretq_u16_u8(vld1q_u8((const UINT8*)(buffer + index))));
+    start = index;
+    return vaddvq_u16(sums);
+}
+
+static UINT32 sum32Simd(const UINT32* buffer, const UINT32 count, UINT32 & start)
+{
+    UINT32 index = start;
+    uint32x4_t sums = vdupq_n_u32(0);
+    for (; index + 4 <= count; index += 4)
+        sums = vaddq_u32(sums, vreinterpretq_u32_u8(vld1q_u8((const UINT8*)(buffer + index))));
+    start = index;
+    return vaddvq_u32(sums);
+}
+
+static bool allBytesEqualSimd(const UINT8* buffer, const UINT32 bufferSize, const UINT8 value, UINT32 & start)
+{
+    UINT32 index = start;
+    const uint8x16_t pattern = vdupq_n_u8(value);
+    for (; index + 64 <= bufferSize; index += 64) {
+        uint8x16_t equal = vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(buffer + index), pattern),
+                                             vceqq_u8(vld1q_u8(buffer + index + 16), pattern)),
+                                    vandq_u8(vceqq_u8(vld1q_u8(buffer + index + 32), pattern),
+                                             vceqq_u8(vld1q_u8(buffer + index + 48), pattern)));
+        if (vminvq_u8(equal) != 0xFF)
+            return false;
+    }
+    start = index;
+    return true;
+}
+#endif
+
+#if defined(U_USE_AVX2)
+U_TARGET_AVX2 static UINT8 sum8Avx2(const UINT8* buffer, const UINT32 bufferSize, UINT32 & start)
+{
+    UINT32 index = start;
+    __m256i sums = _mm256_setzero_si256();
+    for (; index + 32 <= bufferSize; index += 32)
+        sums = _mm256_add_epi8(sums, _mm256_loadu_si256((const __m256i*)(buffer + index)));
+    sums = _mm256_sad_epu8(sums, _mm256_setzero_si256());
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    start = index;
+    return (UINT8)(_mm_cvtsi128_si32(half) + _mm_cvtsi128_si32(_mm_srli_si128(half, 8)));
+}
+
+U_TARGET_AVX2 static UINT16 sum16Avx2(const UINT16* buffer, const UINT32 count, UINT32 & start)
+{
+    UINT32 index = start;
+    __m256i sums = _mm256_setzero_si256();
+    for (; index + 16 <= count; index += 16)
+        sums = _mm256_add_epi16(sums, _mm256_loadu_si256((const __m256i*)(buffer + index)));
+    __m128i half = _mm_add_epi16(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    half = _mm_add_epi16(half, _mm_srli_si128(half, 8));
+    half = _mm_add_epi16(half, _mm_srli_si128(half, 4));
+    half = _mm_add_epi16(half, _mm_srli_si128(half, 2));
+    start = index;
+    return (UINT16)_mm_cvtsi128_si32(half);
+}
+
+U_TARGET_AVX2 static UINT32 sum32Avx2(const UINT32* buffer, const UINT32 count, UINT32 & start)
+{
+    UINT32 index = start;
+    __m256i sums = _mm256_setzero_si256();
+    for (; index + 8 <= count; index += 8)
+        sums = _mm256_add_epi32(sums, _mm256_loadu_si256((const __m256i*)(buffer + index)));
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+    half = _mm_add_epi32(half, _mm_srli_si128(half, 8));
+    half = _mm_add_epi32(half, _mm_srli_si128(half, 4));
+    start = index;
+    return (UINT32)_mm_cvtsi128_si32(half);
+}
+
+U_TARGET_AVX2 static bool allBytesEqualAvx2(const UINT8* buffer, const UINT32 bufferSize, const UINT8 value, UINT32 & start)
+{
+    UINT32 index = start;
+    const __m256i pattern = _mm256_set1_epi8((char)value);
+    for (; index + 64 <= bufferSize; index += 64) {
+        __m256i equal = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(buffer + index)), pattern),
+                                         _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(buffer + index + 32)), pattern));
+        if ((UINT32)_mm256_movemask_epi8(equal) != 0xFFFFFFFFU)
+            return false;
+    }
+    start = index;
+    return true;
+}
+#endif
+
 // 8bit sum calculation routine
 UINT8 calculateSum8(const UINT8* buffer, UINT32 bufferSize)
 {
@@ -382,9 +664,22 @@ UINT8 calculateSum8(const UINT8* buffer, UINT32 bufferSize)
         return 0;
     
     UINT8 counter = 0;
+    UINT32 index = 0;
     
-    while (bufferSize--)
-        counter += buffer[bufferSize];
+    UINT8 level = simdLevel().load(std::memory_order_relaxed);
+#if defined(U_USE_AVX2)
+    if (level >= SIMD_LEVEL_AVX2)
+        counter = sum8Avx2(buffer, bufferSize, index);
+    else
+#endif
+#if defined(U_USE_SSE2) || defined(U_USE_NEON)
+    if (level >= SIMD_LEVEL_BASE)
+        counter = sum8Simd(buffer, bufferSize, index);
+#endif
+    (void)level;
+    
+    for (; index < bufferSize; index++)
+        counter += buffer[index];
     
     return counter;
 }
@@ -409,8 +704,21 @@ UINT16 calculateChecksum16(const UINT16* buffer, UINT32 bufferSize)
     
     bufferSize /= sizeof(UINT16);
     
+    // The buffer is not guaranteed to be aligned
+    UINT8 level = simdLevel().load(std::memory_order_relaxed);
+#if defined(U_USE_AVX2)
+    if (level >= SIMD_LEVEL_AVX2)
+        counter = sum16Avx2(buffer, bufferSize, index);
+    else
+#endif
+#if defined(U_USE_SSE2) || defined(U_USE_NEON)
+    if (level >= SIMD_LEVEL_BASE)
+        counter = sum16Simd(buffer, bufferSize, index);
+#endif
+    (void)level;
+    
     for (; index < bufferSize; index++) {
-        counter = (UINT16)(counter + buffer[index]);
+        counter = (UINT16)(counter + readUnaligned(buffer + index));
     }
     
     return (UINT16)(0x10000 - counter);
@@ -427,19 +735,130 @@ UINT32 calculateChecksum32(const UINT32* buffer, UINT32 bufferSize)
     
     bufferSize /= sizeof(UINT32);
     
+    // The buffer is not guaranteed to be aligned
+    UINT8 level = simdLevel().load(std::memory_order_relaxed);
+#if defined(U_USE_AVX2)
+    if (level >= SIMD_LEVEL_AVX2)
+        counter = sum32Avx2(buffer, bufferSize, index);
+    else
+#endif
+#if defined(U_USE_SSE2) || defined(U_USE_NEON)
+    if (level >= SIMD_LEVEL_BASE)
+        counter = sum32Simd(buffer, bufferSize, index);
+#endif
+    (void)level;
+    
     for (; index < bufferSize; index++) {
-        counter = (UINT32)(counter + buffer[index]);
+        counter = (UINT32)(counter + readUnaligned(buffer + index));
     }
     
     return (UINT32)(0x100000000ULL - counter);
 }
 
+void calculateDigests(const UByteArray & buffer, const std::vector<std::pair<UINT32, UINT32> > & ranges, const UINT8 algorithms, DIGESTS & digests)
+{
+    // Chunks are small enough for every digest after the first one to read them from cache
+    const UINT32 chunkSize = 0x10000;
+    
+    struct sha1_state sha1State;
+    struct sha256_state sha256State;
+    struct sha512_state sha384State;
+    struct sha512_state sha512State;
+    struct sm3_context sm3State;
+    sha1_init(&sha1State);
+    sha256_init(&sha256State);
+    sha384_init(&sha384State);
+    sha512_init(&sha512State);
+    sm3_init(&sm3State);
+    
+    const UINT8* data = (const UINT8*)buffer.constData();
+    const UINT32 bufferSize = (UINT32)buffer.size();
+    for (size_t i = 0; i < ranges.size(); i++) {
+        if (ranges[i].first >= bufferSize)
+            continue;
+        UINT32 offset = ranges[i].first;
+        UINT32 end = offset + std::min(ranges[i].second, bufferSize - offset);
+        while (offset < end) {
+            UINT32 size = std::min(chunkSize, end - offset);
+            if (algorithms & DIGEST_ALGORITHM_SHA1)
+                sha1_process(&sha1State, data + offset, size);
+            if (algorithms & DIGEST_ALGORITHM_SHA256)
+                sha256_process(&sha256State, data + offset, size);
+            if (algorithms & DIGEST_ALGORITHM_SHA384)
+                sha512_process(&sha384State, data + offset, size);
+            if (algorithms & DIGEST_ALGORITHM_SHA512)
+                sha512_process(&sha512State, data + offset, size);
+            if (algorithms & DIGEST_ALGORITHM_SM3)
+                sm3_update(&sm3State, data + offset, size);
+            offset += size;
+        }
+    }
+    
+    if (algorithms & DIGEST_ALGORITHM_SHA1) {
+        digests.sha1 = UByteArray(SHA1_HASH_SIZE, '\x00');
+        sha1_done(&sha1State, (unsigned char*)digests.sha1.data());
+    }
+    if (algorithms & DIGEST_ALGORITHM_SHA256) {
+        digests.sha256 = UByteArray(SHA256_HASH_SIZE, '\x00');
+        sha256_done(&sha256State, (unsigned char*)digests.sha256.data());
+    }
+    if (algorithms & DIGEST_ALGORITHM_SHA384) {
+        digests.sha384 = UByteArray(SHA384_HASH_SIZE, '\x00');
+        sha384_done(&sha384State, (unsigned char*)digests.sha384.data());
+    }
+    if (algorithms & DIGEST_ALGORITHM_SHA512) {
+        digests.sha512 = UByteArray(SHA512_HASH_SIZE, '\x00');
+        sha512_done(&sha512State, (unsigned char*)digests.sha512.data());
+    }
+    if (algorithms & DIGEST_ALGORITHM_SM3) {
+        digests.sm3 = UByteArray(SM3_HASH_SIZE, '\x00');
+        sm3_final(&sm3State, (uint8_t*)digests.sm3.data());
+    }
+}
+
+// Check that all bytes of a buffer are equal to a given value
+bool allBytesEqual(const UINT8* buffer, UINT32 bufferSize, UINT8 value)
+{
+    if (!buffer)
+        return bufferSize == 0;
+    
+    UINT32 index = 0;
+    
+    UINT8 level = simdLevel().load(std::memory_order_relaxed);
+#if defined(U_USE_AVX2)
+    if (level >= SIMD_LEVEL_AVX2) {
+        if (!allBytesEqualAvx2(buffer, bufferSize, value, index))
+            return false;
+    }
+    else
+#endif
+#if defined(U_USE_SSE2) || defined(U_USE_NEON)
+    if (level >= SIMD_LEVEL_BASE) {
+        if (!allBytesEqualSimd(buffer, bufferSize, value, index))
+            return false;
+    }
+#endif
+    (void)level;
+    
+    for (; index < bufferSize; index++) {
+        if (buffer[index] != value)
+            return false;
+    }
+    
+    return true;
+}
+
+bool allBytesEqual(const UByteArray & data, UINT8 value)
+{
+    return allBytesEqual((const UINT8*)data.constData(), (UINT32)data.size(), value);
+}
+
 // Get padding type for a given padding
 UINT8 getPaddingType(const UByteArray & padding)
 {
-    if (padding.count('\x00') == padding.size())
+    if (allBytesEqual(padding, 0x00))
         return Subtypes::ZeroPadding;
-    if (padding.count('\xFF') == padding.size())
+    if (allBytesEqual(padding, 0xFF))
         return Subtypes::OnePadding;
     return Subtypes::DataPadding;
 }
@@ -479,6 +898,63 @@ INTN findPattern(const UINT8 *pattern, const UINT8 *patternMask, UINTN patternSi
     return -1;
 }
 
+void findSignatures(const UINT32 *signatures, UINTN signaturesCount,
+                    const UINT8 *data, UINTN dataSize, std::vector<UINT32> &offsets)
+{
+    offsets.clear();
+    if (signaturesCount == 0 || dataSize < sizeof(UINT32))
+        return;
+    
+    UINTN offset = 0;
+#if defined(U_USE_SSE2)
+    // Compare the first two bytes of every signature against 16 consecutive offsets at once,
+    // and check full signatures only at offsets where any of those pairs matched
+    std::vector<char> firstBytes(signaturesCount);
+    std::vector<char> secondBytes(signaturesCount);
+    for (UINTN i = 0; i < signaturesCount; i++) {
+        firstBytes[i] = (char)(signatures[i] & 0xFF);
+        secondBytes[i] = (char)((signatures[i] >> 8) & 0xFF);
+    }
+    
+    for (; offset + 16 + sizeof(UINT32) <= dataSize; offset += 16) {
+        __m128i first = _mm_loadu_si128((const __m128i*)(data + offset));
+        __m128i second = _mm_loadu_si128((const __m128i*)(data + offset + 1));
+        __m128i found = _mm_setzero_si128();
+        for (UINTN i = 0; i < signaturesCount; i++) {
+            found = _mm_or_si128(found, _mm_and_si128(_mm_cmpeq_epi8(first, _mm_set1_epi8(firstBytes[i])),
+                                                      _mm_cmpeq_epi8(second, _mm_set1_epi8(secondBytes[i]))));
+        }
+        
+        UINT32 mask = (UINT32)_mm_movemask_epi8(found);
+        while (mask) {
+            UINT32 bit = 0;
+            while (!(mask & (1U << bit)))
+                bit++;
+            mask &= mask - 1;
+            
+            UINT32 value = readUnaligned((const UINT32*)(data + offset + bit));
+            for (UINTN i = 0; i < signaturesCount; i++) {
+                if (value == signatures[i]) {
+                    offsets.push_back((UINT32)(offset + bit));
+                    break;
+                }
+            }
+        }
+    }
+#endif
+    
+    // Check the rest byte by byte
+    for (; offset + sizeof(UINT32) <= dataSize; offset++) {
+        UINT32 value = readUnaligned((const UINT32*)(data + offset));
+        for (UINTN i = 0; i < signaturesCount; i++) {
+            if (value == signatures[i]) {
+                offsets.push_back((UINT32)offset);
+                break;
+            }
+        }
+    }
+}
+
 bool makePattern(const CHAR8 *textPattern, std::vector<UINT8> &pattern, std::vector<UINT8> &patternMask)
 {
     UINTN len = std::strlen(textPattern);
@@ -492,8 +968,8 @@ bool makePattern(const CHAR8 *textPattern, std::vector<UINT8> &pattern, std::vec
     patternMask.resize(len);
     
     for (UINTN i = 0; i < len; i++) {
-        int v1 = char2hex(std::toupper(textPattern[i * 2]));
-        int v2 = char2hex(std::toupper(textPattern[i * 2 + 1]));
+        int v1 = char2hex(std::toupper((unsigned char)textPattern[i * 2]));
+        int v2 = char2hex(std::toupper((unsigned char)textPattern[i * 2 + 1]));
         
         if (v1 == -1 || v2 == -1)
             return false;
@@ -512,6 +988,398 @@ bool makePattern(const CHAR8 *textPattern, std::vector<UINT8> &pattern, std::vec
     return true;
 }
 
+static inline bool byteInSet(const UINT8 *set, UINT8 value)
+{
+    return (set[value >> 3] >> (value & 7)) & 1;
+}
+
+// Reads two hex digits of a byte class item
+static bool readPatternByte(const CHAR8 *&text, UINT32 &value)
+{
+    int v1 = char2hex(std::toupper((unsigned char)text[0]));
+    if (v1 < 0)
+        return false;
+    int v2 = char2hex(std::toupper((unsigned char)text[1]));
+    if (v2 < 0)
+        return false;
+    
+    value = (UINT32)((v1 << 4) | v2);
+    text += 2;
+    return true;
+}
+
+// Reads a decimal repetition count
+static bool readPatternCount(const CHAR8 *&text, UINT32 &value)
+{
+    if (*text < '0' || *text > '9')
+        return false;
+    
+    value = 0;
+    while (*text >= '0' && *text <= '9') {
+        value = value * 10 + (UINT32)(*text++ - '0');
+        if (value > BYTE_PATTERN_MAX_SIZE)
+            return false;
+    }
+    return true;
+}
+
+bool BytePattern::compile(const CHAR8 *textPattern)
+{
+    units.clear();
+    slotUnits.clear();
+    unitSlots.clear();
+    entrySlots.clear();
+    entryAccepts.clear();
+    minMatchSize = maxMatchSize = fixedPrefix = anchorSlot = 0;
+    anchorValue = -1;
+    
+    if (!textPattern)
+        return false;
+    
+    Unit unit;
+    bool highNibble = false;
+    bool canRepeat = false;
+    UINT8 value = 0, mask = 0;
+    const CHAR8 *text = textPattern;
+    while (*text) {
+        CHAR8 c = *text++;
+        if (c == ' ')
+            continue;
+        
+        int v = char2hex(std::toupper((unsigned char)c));
+        if (v != -1) {
+            // Two nibbles make a byte that matches all values equal to it under the mask
+            value = (UINT8)(value << 4);
+            mask = (UINT8)(mask << 4);
+            if (v != -2) {
+                value |= (UINT8)v;
+                mask |= 0x0F;
+            }
+            
+            highNibble = !highNibble;
+            canRepeat = !highNibble;
+            if (!highNibble) {
+                memset(unit.set, 0, sizeof(unit.set));
+                for (UINT32 b = 0; b < 0x100; b++) {
+                    if ((b & mask) == value)
+                        unit.set[b >> 3] |= (UINT8)(1 << (b & 7));
+                }
+                unit.minCount = unit.maxCount = 1;
+                units.push_back(unit);
+                value = mask = 0;
+            }
+            continue;
+        }
+        
+        // Classes and repetitions work on whole bytes only
+        if (highNibble)
+            return false;
+        
+        if (c == '[') {
+            bool negate = (*text == '^');
+            if (negate)
+                text++;
+            
+            bool empty = true;
+            memset(unit.set, 0, sizeof(unit.set));
+            while (*text != ']') {
+                if (*text == ' ') {
+                    text++;
+                    continue;
+                }
+                
+                UINT32 from, to;
+                if (!readPatternByte(text, from))
+                    return false;
+                to = from;
+                while (*text == ' ')
+                    text++;
+                if (*text == '-') {
+                    text++;
+                    while (*text == ' ')
+                        text++;
+                    if (!readPatternByte(text, to) || to < from)
+                        return false;
+                }
+                
+                for (UINT32 b = from; b <= to; b++)
+                    unit.set[b >> 3] |= (UINT8)(1 << (b & 7));
+                empty = false;
+            }
+            text++;
+            
+            if (empty)
+                return false;
+            if (negate) {
+                for (UINT32 i = 0; i < sizeof(unit.set); i++)
+                    unit.set[i] = (UINT8)~unit.set[i];
+            }
+            
+            unit.minCount = unit.maxCount = 1;
+            units.push_back(unit);
+            canRepeat = true;
+        }
+        else if (c == '{' || c == '?') {
+            if (!canRepeat)
+                return false;
+            
+            UINT32 minCount = 0, maxCount = 1;
+            if (c == '{') {
+                if (!readPatternCount(text, minCount))
+                    return false;
+                maxCount = minCount;
+                if (*text == ',') {
+                    text++;
+                    if (!readPatternCount(text, maxCount))
+                        return false;
+                }
+                if (*text++ != '}' || maxCount == 0 || maxCount < minCount)
+                    return false;
+            }
+            
+            units.back().minCount = minCount;
+            units.back().maxCount = maxCount;
+            canRepeat = false;
+        }
+        else {
+            return false;
+        }
+    }
+    
+    // A trailing nibble matches a byte with any low nibble
+    if (highNibble) {
+        value = (UINT8)(value << 4);
+        mask = (UINT8)(mask << 4);
+        memset(unit.set, 0, sizeof(unit.set));
+        for (UINT32 b = 0; b < 0x100; b++) {
+            if ((b & mask) == value)
+                unit.set[b >> 3] |= (UINT8)(1 << (b & 7));
+        }
+        unit.minCount = unit.maxCount = 1;
+        units.push_back(unit);
+    }
+    
+    UINT64 minSize = 0, maxSize = 0;
+    for (size_t i = 0; i < units.size(); i++) {
+        minSize += units[i].minCount;
+        maxSize += units[i].maxCount;
+    }
+    if (minSize == 0 || maxSize > BYTE_PATTERN_MAX_SIZE) {
+        units.clear();
+        return false;
+    }
+    minMatchSize = (UINTN)minSize;
+    maxMatchSize = (UINTN)maxSize;
+    
+    // Number the states, and collect the states entered with every unit
+    unitSlots.resize(units.size() + 1);
+    for (size_t i = 0; i < units.size(); i++) {
+        unitSlots[i] = (UINT32)slotUnits.size();
+        slotUnits.insert(slotUnits.end(), units[i].maxCount, (UINT32)i);
+    }
+    unitSlots[units.size()] = (UINT32)slotUnits.size();
+    
+    entrySlots.resize(units.size() + 1);
+    entryAccepts.resize(units.size() + 1);
+    entryAccepts[units.size()] = true;
+    for (size_t i = units.size(); i-- > 0;) {
+        entrySlots[i].push_back(unitSlots[i]);
+        entryAccepts[i] = false;
+        if (units[i].minCount == 0) {
+            entrySlots[i].insert(entrySlots[i].end(), entrySlots[i + 1].begin(), entrySlots[i + 1].end());
+            entryAccepts[i] = entryAccepts[i + 1];
+        }
+    }
+    
+    // Bytes up to the first variable repetition are always at the same place
+    for (size_t i = 0; i < units.size(); i++) {
+        fixedPrefix += units[i].minCount;
+        if (units[i].minCount != units[i].maxCount)
+            break;
+    }
+    
+    UINT32 bestCount = 0x101;
+    UINTN position = 0;
+    for (size_t i = 0; i < units.size() && position < fixedPrefix; i++) {
+        UINT32 count = 0;
+        int last = -1;
+        for (UINT32 b = 0; b < 0x100; b++) {
+            if (byteInSet(units[i].set, (UINT8)b)) {
+                count++;
+                last = (int)b;
+            }
+        }
+        if (count < bestCount) {
+            bestCount = count;
+            anchorSlot = position;
+            anchorValue = (count == 1) ? last : -1;
+        }
+        position += units[i].minCount;
+    }
+    
+    return true;
+}
+
+bool BytePattern::matchesAnything() const
+{
+    for (size_t i = 0; i < units.size(); i++) {
+        for (UINT32 j = 0; j < sizeof(units[i].set); j++) {
+            if (units[i].set[j] != 0xFF)
+                return false;
+        }
+    }
+    return !units.empty();
+}
+
+bool BytePattern::matchesAt(const UINT8 *data, UINTN dataSize, UINTN offset, std::vector<UINT32> &states, std::vector<UINT32> &marks, UINT32 &generation, UINTN &matchSize) const
+{
+    // Check the fixed part first
+    UINTN position = 0;
+    for (size_t i = 0; i < units.size() && position < fixedPrefix; i++) {
+        for (UINT32 j = 0; j < units[i].minCount; j++, position++) {
+            if (!byteInSet(units[i].set, data[offset + position]))
+                return false;
+        }
+    }
+    
+    if (minMatchSize == maxMatchSize) {
+        matchSize = minMatchSize;
+        return true;
+    }
+    
+    // Run the NFA from the start, the first accepting state gives the shortest match
+    states.assign(entrySlots[0].begin(), entrySlots[0].end());
+    size_t next = states.size();
+    for (UINTN i = offset; i < dataSize && !states.empty(); i++) {
+        if (++generation == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            generation = 1;
+        }
+        
+        for (size_t j = 0; j < next; j++) {
+            UINT32 slot = states[j];
+            UINT32 unit = slotUnits[slot];
+            if (!byteInSet(units[unit].set, data[i]))
+                continue;
+            
+            UINT32 count = slot - unitSlots[unit] + 1;
+            if (count < units[unit].maxCount && marks[slot + 1] != generation) {
+                marks[slot + 1] = generation;
+                states.push_back(slot + 1);
+            }
+            if (count >= units[unit].minCount) {
+                if (entryAccepts[unit + 1]) {
+                    matchSize = i - offset + 1;
+                    return true;
+                }
+                const std::vector<UINT32> &entry = entrySlots[unit + 1];
+                for (size_t k = 0; k < entry.size(); k++) {
+                    if (marks[entry[k]] != generation) {
+                        marks[entry[k]] = generation;
+                        states.push_back(entry[k]);
+                    }
+                }
+            }
+        }
+        
+        states.erase(states.begin(), states.begin() + next);
+        next = states.size();
+    }
+    
+    return false;
+}
+
+INTN BytePattern::find(const UINT8 *data, UINTN dataSize, UINTN dataOff, UINTN &matchSize) const
+{
+    if (units.empty() || dataOff >= dataSize || dataSize - dataOff < minMatchSize)
+        return -1;
+    
+    std::vector<UINT32> states;
+    std::vector<UINT32> marks(slotUnits.size(), 0);
+    UINT32 generation = 0;
+    
+    const UINTN lastOff = dataSize - minMatchSize;
+    for (UINTN offset = dataOff; offset <= lastOff; offset++) {
+        if (anchorValue >= 0) {
+            const UINT8 *found = (const UINT8*)memchr(data + offset + anchorSlot, anchorValue, lastOff - offset + 1);
+            if (!found)
+                return -1;
+            offset = (UINTN)(found - data) - anchorSlot;
+        }
+        
+        if (matchesAt(data, dataSize, offset, states, marks, generation, matchSize))
+            return (INTN)offset;
+    }
+    
+    return -1;
+}
+
+// Inflates the whole input into the output, sizeHint is the expected output size or 0 if unknown
+static USTATUS inflateToArray(const UByteArray & input, const int windowBits, const UINT32 sizeHint, UByteArray & output, const USTATUS failure)
+{
+    DecompressionContext & context = decompressionContext();
+    
+    // Large spill buffers are freed however the call ends
+    struct SpillTrimmer {
+        DecompressionContext & context;
+        ~SpillTrimmer() { context.trimSpill(); }
+    } spillTrimmer = { context };
+    
+    z_stream* stream = context.inflateStream(windowBits);
+    if (!stream)
+        return failure;
+    
+    stream->next_in = (z_const Bytef*)input.constData();
+    stream->avail_in = (uInt)input.size();
+    
+    // Inflate into the pre-sized output first, the rest goes to the spill buffer that grows as needed
+    UByteArray head;
+    char* headData = sizeHint ? allocateDecompressed(head, sizeHint) : NULL;
+    uLong headSize = headData ? sizeHint : 0;
+    stream->next_out = (Bytef*)headData;
+    stream->avail_out = (uInt)headSize;
+    
+    int ret = Z_OK;
+    while (ret == Z_OK) {
+        if (stream->avail_out == 0) {
+            size_t used = stream->total_out - headSize;
+            if (context.spillSize < used + 0x1000) {
+                size_t newSize = std::max<size_t>(context.spillSize * 2, std::max<size_t>(used + 0x1000, (size_t)input.size() * 4));
+                UINT8* newSpill = (UINT8*)realloc(context.spill, newSize);
+                if (!newSpill)
+                    return failure;
+                context.spill = newSpill;
+                context.spillSize = newSize;
+            }
+            stream->next_out = context.spill + used;
+            stream->avail_out = (uInt)(context.spillSize - used);
+        }
+        ret = inflate(stream, Z_NO_FLUSH);
+    }
+    
+    // Spilled data is copied once into an array of the exact size,
+    // so is the head when the size hint was much larger than the data
+    uLong total = stream->total_out;
+    if (total == headSize) {
+        output = head;
+    }
+    else if (total < headSize && headSize - total <= std::max<uLong>(total / 8, 0x1000)) {
+        output = head.left((int)total);
+    }
+    else {
+        char* data = allocateDecompressed(output, (UINT32)total);
+        if (!data && total)
+            return failure;
+        size_t fromHead = std::min<size_t>(total, headSize);
+        if (fromHead)
+            memcpy(data, head.constData(), fromHead);
+        if (total > headSize)
+            memcpy(data + headSize, context.spill, total - headSize);
+    }
+    
+    return ret == Z_STREAM_END ? U_SUCCESS : failure;
+}
+
 USTATUS gzipDecompress(const UByteArray & input, UByteArray & output)
 {
     output.clear();
@@ -519,30 +1387,17 @@ USTATUS gzipDecompress(const UByteArray & input, UByteArray & output)
     if (input.size() == 0)
         return U_SUCCESS;
     
-    z_stream stream = {};
-    stream.next_in = (z_const Bytef *)input.data();
-    stream.avail_in = (uInt)input.size();
-    stream.zalloc = Z_NULL;
-    stream.zfree = Z_NULL;
-    stream.opaque = Z_NULL;
-    
-    // 15 for the maximum history buffer, 16 for gzip only input
-    int ret = inflateInit2(&stream, 15U | 16U);
-    if (ret != Z_OK)
-        return U_GZIP_DECOMPRESSION_FAILED;
-    
-    while (ret == Z_OK) {
-        Bytef out[0x1000] = {};
-        stream.next_out = out;
-        stream.avail_out = sizeof(out);
-        
-        ret = inflate(&stream, Z_NO_FLUSH);
-        if ((ret == Z_OK || ret == Z_STREAM_END) && stream.avail_out != sizeof(out))
-            output += UByteArray((char *)out, sizeof(out) - stream.avail_out);
+    // Size of the uncompressed data modulo 2^32 is stored in the last 4 bytes of a gzip member,
+    // it is used only as a hint limited by the maximum deflate compression ratio
+    UINT32 sizeHint = 0;
+    if (input.size() >= 18) {
+        UINT32 isize = readUnaligned((const UINT32*)(input.constData() + input.size() - sizeof(UINT32)));
+        if ((UINT64)isize <= (UINT64)input.size() * 1032 && isize <= INT32_MAX)
+            sizeHint = isize;
     }
     
-    inflateEnd(&stream);
-    return ret == Z_STREAM_END ? U_SUCCESS : U_GZIP_DECOMPRESSION_FAILED;
+    // 15 for the maximum history buffer, 16 for gzip only input
+    return inflateToArray(input, 15 | 16, sizeHint, output, U_GZIP_DECOMPRESSION_FAILED);
 }
 
 USTATUS zlibDecompress(const UByteArray& input, UByteArray& output)
@@ -552,28 +1407,129 @@ USTATUS zlibDecompress(const UByteArray& input, UByteArray& output)
     if (input.size() == 0)
         return U_SUCCESS;
 
-    z_stream stream = {};
-    stream.next_in = (z_const Bytef*)input.data();
-    stream.avail_in = (uInt)input.size();
-    stream.zalloc = Z_NULL;
-    stream.zfree = Z_NULL;
-    stream.opaque = Z_NULL;
-
     // 15 for the maximum history buffer
-    int ret = inflateInit2(&stream, 15U);
-    if (ret != Z_OK)
-        return U_ZLIB_DECOMPRESSION_FAILED;
+    return inflateToArray(input, 15, 0, output, U_ZLIB_DECOMPRESSION_FAILED);
+}
 
-    while (ret == Z_OK) {
-        Bytef out[0x1000] = {};
-        stream.next_out = out;
-        stream.avail_out = sizeof(out);
+void buildVolumeFileMap(const TreeModel * model, const UModelIndex & volume, VOLUME_FILE_MAP & files)
+{
+    files.clear();
+    
+    int rowCount = model->childCount(volume);
+    files.reserve((size_t)rowCount);
+    for (int i = 0; i < rowCount; i++) {
+        UModelIndex current = model->childIndex(i, volume);
+        if (model->type(current) != Types::File)
+            continue;
+        
+        UByteArray header = model->header(current);
+        if ((size_t)header.size() < sizeof(EFI_GUID))
+            continue;
+        
+        files[readUnaligned((const EFI_GUID*)header.constData())].push_back(i);
+    }
+}
+
+// Range of task indices owned by a parallelFor worker, the owner takes tasks from the front, thieves from the back
+struct PARALLEL_FOR_RANGE {
+    std::mutex lock;
+    UINTN begin;
+    UINTN end;
+};
 
-        ret = inflate(&stream, Z_NO_FLUSH);
-        if ((ret == Z_OK || ret == Z_STREAM_END) && stream.avail_out != sizeof(out))
-            output += UByteArray((char*)out, sizeof(out) - stream.avail_out);
+static bool takeParallelForTask(PARALLEL_FOR_RANGE &range, bool steal, UINTN &task)
+{
+    std::lock_guard<std::mutex> guard(range.lock);
+    if (range.begin == range.end)
+        return false;
+    task = steal ? --range.end : range.begin++;
+    return true;
+}
+
+void parallelFor(UINTN count, UINT32 threadCount, const std::function<void(UINTN)> &task)
+{
+    if (threadCount > count)
+        threadCount = (UINT32)count;
+    
+    // Run small jobs on the calling thread
+    if (threadCount < 2) {
+        for (UINTN i = 0; i < count; i++)
+            task(i);
+        return;
+    }
+    
+    // Split the tasks evenly, workers that run out of own tasks steal from the others
+    std::vector<PARALLEL_FOR_RANGE> ranges(threadCount);
+    for (UINT32 i = 0; i < threadCount; i++) {
+        ranges[i].begin = count * i / threadCount;
+        ranges[i].end = count * (i + 1) / threadCount;
     }
+    
+    auto worker = [&](UINT32 self) {
+        UINTN current;
+        while (takeParallelForTask(ranges[self], false, current))
+            task(current);
+        for (UINT32 i = 1; i < threadCount; i++) {
+            PARALLEL_FOR_RANGE &victim = ranges[(self + i) % threadCount];
+            while (takeParallelForTask(victim, true, current))
+                task(current);
+        }
+    };
+    
+    // The calling thread is the worker number zero
+    std::vector<std::thread> threads;
+    for (UINT32 i = 1; i < threadCount; i++)
+        threads.push_back(std::thread(worker, i));
+    worker(0);
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
 
-    inflateEnd(&stream);
-    return ret == Z_STREAM_END ? U_SUCCESS : U_ZLIB_DECOMPRESSION_FAILED;
+WorkerPool::WorkerPool(UINT32 threadLimit, UINTN queueLimit)
+: threadLimit(threadLimit > 0 ? threadLimit : 1), queueLimit(queueLimit > 0 ? queueLimit : 1), idleThreads(0), stopping(false)
+{
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    queueNotEmpty.notify_all();
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+}
+
+void WorkerPool::submit(const std::function<void()> &task)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    queueNotFull.wait(guard, [this] { return queue.size() < queueLimit; });
+    queue.push_back(task);
+    
+    // Start another thread only if the started ones can't take this task right away
+    if (idleThreads < queue.size() && threads.size() < threadLimit)
+        threads.push_back(std::thread(&WorkerPool::run, this));
+    queueNotEmpty.notify_one();
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        idleThreads++;
+        queueNotEmpty.wait(guard, [this] { return stopping || !queue.empty(); });
+        idleThreads--;
+        
+        // Tasks submitted before the pool is destroyed are still run
+        if (queue.empty())
+            return;
+        
+        std::function<void()> task = queue.front();
+        queue.pop_front();
+        guard.unlock();
+        queueNotFull.notify_one();
+        task();
+        guard.lock();
+    }
 }
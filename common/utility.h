@@ -15,6 +15,13 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define UTILITY_H
 
 #include <vector>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "../common/zlib/zlib.h"
 
@@ -38,12 +45,24 @@ UString errorCodeToUString(USTATUS errorCode);
 // EFI/Tiano/LZMA decompression routine
 USTATUS decompress(const UByteArray & compressed, const UINT8 compressionType, UINT8 & algorithm, UINT32 & dictionarySize, UByteArray & decompressed, UByteArray & efiDecompressed);
 
+// EFI 1.1 or Tiano decompression routine, algorithm must be either COMPRESSION_ALGORITHM_EFI11 or COMPRESSION_ALGORITHM_TIANO
+USTATUS standardDecompress(const UByteArray & compressed, const UINT8 algorithm, UByteArray & decompressed);
+
 // GZIP decompression routine
 USTATUS gzipDecompress(const UByteArray & compressed, UByteArray & decompressed);
 
 // ZLIB decompression routine
 USTATUS zlibDecompress(const UByteArray& compressed, UByteArray& decompressed);
 
+// Vector instruction sets used by checksum and byte comparison routines
+#define SIMD_LEVEL_NONE 0 // Scalar code only
+#define SIMD_LEVEL_BASE 1 // SSE2 or NEON, whichever the build targets
+#define SIMD_LEVEL_AVX2 2 // Chosen at runtime when the CPU supports it
+
+// The best level supported by the build and the CPU is used by default, tests and benchmarks can limit it
+// Returns the level used from now on
+UINT8 limitSimdLevel(const UINT8 maxLevel);
+
 // 8bit sum calculation routine
 UINT8 calculateSum8(const UINT8* buffer, UINT32 bufferSize);
 
@@ -56,6 +75,29 @@ UINT16 calculateChecksum16(const UINT16* buffer, UINT32 bufferSize);
 // 32bit checksum calculation routine
 UINT32 calculateChecksum32(const UINT32* buffer, UINT32 bufferSize);
 
+// Digest algorithms computed by calculateDigests, can be combined
+#define DIGEST_ALGORITHM_SHA1   0x01
+#define DIGEST_ALGORITHM_SHA256 0x02
+#define DIGEST_ALGORITHM_SHA384 0x04
+#define DIGEST_ALGORITHM_SHA512 0x08
+#define DIGEST_ALGORITHM_SM3    0x10
+
+typedef struct DIGESTS_ {
+    UByteArray sha1;
+    UByteArray sha256;
+    UByteArray sha384;
+    UByteArray sha512;
+    UByteArray sm3;
+} DIGESTS;
+
+// Calculate digests of (offset, size) ranges of a buffer as if they were concatenated, ranges are clamped to the buffer like mid() does
+// All requested digests are fed from the same cache-sized chunks, so the data is read once and ranges are never copied
+void calculateDigests(const UByteArray & buffer, const std::vector<std::pair<UINT32, UINT32> > & ranges, const UINT8 algorithms, DIGESTS & digests);
+
+// Check that all bytes of a buffer are equal to a given value, empty buffers pass the check
+bool allBytesEqual(const UINT8* buffer, UINT32 bufferSize, UINT8 value);
+bool allBytesEqual(const UByteArray & data, UINT8 value);
+
 // Return padding type from it's contents
 UINT8 getPaddingType(const UByteArray & padding);
 
@@ -66,6 +108,114 @@ bool makePattern(const CHAR8 *textPattern, std::vector<UINT8> &pattern, std::vec
 INTN findPattern(const UINT8 *pattern, const UINT8 *patternMask, UINTN patternSize,
     const UINT8 *data, UINTN dataSize, UINTN dataOff);
 
+// Maximum number of bytes a byte pattern can match
+#define BYTE_PATTERN_MAX_SIZE 0x10000
+
+// Byte pattern matched directly against binary data
+// Syntax: hex digits with . being any nibble, [XX-YY...] for byte classes with ^ to negate them,
+// {n} or {n,m} or ? after a byte or a class for bounded repetition, spaces are ignored
+class BytePattern
+{
+public:
+    BytePattern() : minMatchSize(0), maxMatchSize(0), fixedPrefix(0), anchorSlot(0), anchorValue(-1) {}
+
+    // Returns false if the text is not a valid pattern or can match nothing but an empty string
+    bool compile(const CHAR8 *textPattern);
+
+    // Find the first match starting at or after dataOff, returns its offset and the size of the shortest match at it
+    INTN find(const UINT8 *data, UINTN dataSize, UINTN dataOff, UINTN &matchSize) const;
+
+    UINTN minSize() const { return minMatchSize; }
+    UINTN maxSize() const { return maxMatchSize; }
+
+    // Check that the pattern matches at any offset of any data that is long enough
+    bool matchesAnything() const;
+
+private:
+    struct Unit {
+        UINT8  set[32]; // Bitmap of byte values this unit matches
+        UINT32 minCount;
+        UINT32 maxCount;
+    };
+
+    std::vector<Unit> units;
+    UINTN minMatchSize;
+    UINTN maxMatchSize;
+
+    // Bytes at the start of every match have fixed positions and are checked first,
+    // scanning for the most selective of them when it can be only one value
+    UINTN fixedPrefix;
+    UINTN anchorSlot;
+    int anchorValue;
+
+    // Matches run as an NFA with one state per byte a match can consume,
+    // entering a unit also enters all following units that can be skipped
+    std::vector<UINT32> slotUnits;
+    std::vector<UINT32> unitSlots;
+    std::vector<std::vector<UINT32> > entrySlots;
+    std::vector<bool> entryAccepts;
+
+    bool matchesAt(const UINT8 *data, UINTN dataSize, UINTN offset, std::vector<UINT32> &states, std::vector<UINT32> &marks, UINT32 &generation, UINTN &matchSize) const;
+};
+
+// Find offsets of all 32-bit little-endian signatures from a given set in a binary blob
+void findSignatures(const UINT32 *signatures, UINTN signaturesCount,
+    const UINT8 *data, UINTN dataSize, std::vector<UINT32> &offsets);
+
+// Hash and equality of GUIDs for unordered containers
+struct GuidHash
+{
+    size_t operator()(const EFI_GUID & guid) const {
+        UINT64 halves[2];
+        memcpy(halves, &guid, sizeof(halves));
+        return (size_t)((halves[0] * 0x9E3779B97F4A7C15ULL) ^ halves[1]);
+    }
+};
+
+struct GuidEqual
+{
+    bool operator()(const EFI_GUID & lhs, const EFI_GUID & rhs) const { return memcmp(&lhs, &rhs, sizeof(EFI_GUID)) == 0; }
+};
+
+// Rows of files of a volume by their GUIDs, rows are in ascending order
+typedef std::unordered_map<EFI_GUID, std::vector<int>, GuidHash, GuidEqual> VOLUME_FILE_MAP;
+
+// Collect rows of all files of a volume, including pad files, by their GUIDs
+void buildVolumeFileMap(const TreeModel * model, const UModelIndex & volume, VOLUME_FILE_MAP & files);
+
+// Run task(0) ... task(count - 1) on up to threadCount threads, tasks are balanced between threads by work stealing
+void parallelFor(UINTN count, UINT32 threadCount, const std::function<void(UINTN)> &task);
+
+// Persistent worker threads running tasks in order of submission
+// Threads are started only when a task is submitted and no started thread is idle, up to threadLimit of them
+// At most queueLimit tasks wait for a thread, submit blocks while the queue is full
+class WorkerPool
+{
+public:
+    WorkerPool(UINT32 threadLimit, UINTN queueLimit);
+    // Waits for all submitted tasks to finish
+    ~WorkerPool();
+
+    void submit(const std::function<void()> &task);
+
+    UINT32 maxThreadCount() const { return threadLimit; }
+
+private:
+    WorkerPool(const WorkerPool &);
+    WorkerPool & operator=(const WorkerPool &);
+    void run();
+
+    UINT32 threadLimit;
+    UINTN queueLimit;
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()> > queue;
+    std::mutex lock;
+    std::condition_variable queueNotEmpty;
+    std::condition_variable queueNotFull;
+    UINT32 idleThreads;
+    bool stopping;
+};
+
 // Safely dereferences misaligned pointers
 template <typename T>
 inline T readUnaligned(const T *v) {
@@ -24,8 +24,8 @@ extern "C" int LLVMFuzzerTestOneInput(const char *Data, long long Size) {
     TreeModel* model = new TreeModel();
     FfsParser* ffsParser = new FfsParser(model);
 
-    // Parse the image
-    (void)ffsParser->parse(UByteArray(Data, (uint32_t)Size));
+    // Parse the image in place, the input stays alive until this function returns
+    (void)ffsParser->parse(UByteArray::fromRawData(Data, (int32_t)Size));
 
     delete model;
     delete ffsParser;
@@ -0,0 +1,120 @@
+/* bytepattern_test.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <vector>
+
+#include "test.h"
+#include "../common/utility.h"
+
+// Offset of the first match of the pattern in the data at or after the given offset, -1 if there is none
+static INTN findIn(const char* text, const std::vector<UINT8> & data, UINTN offset, UINTN & matchSize)
+{
+    BytePattern pattern;
+    matchSize = 0;
+    if (!pattern.compile(text))
+        return -2;
+    return pattern.find(data.data(), data.size(), offset, matchSize);
+}
+
+static INTN findIn(const char* text, const std::vector<UINT8> & data)
+{
+    UINTN matchSize;
+    return findIn(text, data, 0, matchSize);
+}
+
+static void testSyntax()
+{
+    BytePattern pattern;
+
+    // Plain bytes, nibble wildcards and spaces between items
+    TEST_CHECK(pattern.compile("AABB"));
+    TEST_CHECK(pattern.minSize() == 2 && pattern.maxSize() == 2);
+    TEST_CHECK(pattern.compile("aa .b ?"));
+    TEST_CHECK(pattern.minSize() == 1 && pattern.maxSize() == 2);
+    TEST_CHECK(pattern.compile("A"));
+    TEST_CHECK(pattern.minSize() == 1);
+
+    // Classes with ranges, spaces around them and negation
+    TEST_CHECK(pattern.compile("[00-1F]{2}"));
+    TEST_CHECK(pattern.minSize() == 2 && pattern.maxSize() == 2);
+    TEST_CHECK(pattern.compile("[^ 00 - FE ]"));
+    TEST_CHECK(pattern.compile("[01 05 10-20]{1,4}"));
+    TEST_CHECK(pattern.minSize() == 1 && pattern.maxSize() == 4);
+
+    // Invalid patterns
+    TEST_CHECK(!pattern.compile(""));
+    TEST_CHECK(!pattern.compile("AG"));
+    TEST_CHECK(!pattern.compile("A?"));
+    TEST_CHECK(!pattern.compile("[]"));
+    TEST_CHECK(!pattern.compile("[00 -]"));
+    TEST_CHECK(!pattern.compile("[00 - ]"));
+    TEST_CHECK(!pattern.compile("[1F - 00]"));
+    TEST_CHECK(!pattern.compile("[0]"));
+    TEST_CHECK(!pattern.compile("[00"));
+    TEST_CHECK(!pattern.compile("{2}"));
+    TEST_CHECK(!pattern.compile("AA{2"));
+    TEST_CHECK(!pattern.compile("AA{3,2}"));
+    TEST_CHECK(!pattern.compile("AA{0}"));
+    TEST_CHECK(!pattern.compile("AA??"));
+    TEST_CHECK(!pattern.compile("AA?"));
+    TEST_CHECK(!pattern.compile("AA{70000}"));
+
+    // Characters outside of ASCII are rejected
+    TEST_CHECK(!pattern.compile("A\xC4"));
+    TEST_CHECK(!pattern.compile("[\xE4\xE4]"));
+}
+
+static void testFind()
+{
+    const UINT8 bytes[] = { 0x30, 0x05, 0x1F, 0xFF, 0x12, 0x34, 0x56, 0x12, 0x34, 0x34, 0x78 };
+    std::vector<UINT8> data(bytes, bytes + sizeof(bytes));
+    UINTN matchSize;
+
+    // Plain bytes and nibble wildcards
+    TEST_CHECK(findIn("1234", data, 0, matchSize) == 4 && matchSize == 2);
+    TEST_CHECK(findIn("1234", data, 5, matchSize) == 7 && matchSize == 2);
+    TEST_CHECK(findIn("1.3.", data) == 4);
+    TEST_CHECK(findIn(".F", data) == 2);
+    TEST_CHECK(findIn("F", data) == 3);
+    TEST_CHECK(findIn("9999", data) == -1);
+
+    // Classes and negation
+    TEST_CHECK(findIn("[00-1F]{2}", data, 0, matchSize) == 1 && matchSize == 2);
+    TEST_CHECK(findIn("[^ 00 - FE ]", data) == 3);
+    TEST_CHECK(findIn("[^30]", data) == 1);
+    TEST_CHECK(findIn("[56 78] 12", data) == 6);
+
+    // Repetitions match the shortest run at the first offset
+    TEST_CHECK(findIn("12 34{1,2} 78", data, 0, matchSize) == 7 && matchSize == 4);
+    TEST_CHECK(findIn("12 34{2} 78", data, 0, matchSize) == 7 && matchSize == 4);
+    TEST_CHECK(findIn("12 34{3} 78", data) == -1);
+    TEST_CHECK(findIn("56? 12 34", data, 0, matchSize) == 4 && matchSize == 2);
+    TEST_CHECK(findIn("FF 12 34 56? 12", data, 0, matchSize) == 3 && matchSize == 5);
+
+    // Matches ending at the last byte of the buffer
+    TEST_CHECK(findIn("34 78", data, 0, matchSize) == 9 && matchSize == 2);
+    TEST_CHECK(findIn("78", data, 10, matchSize) == 10 && matchSize == 1);
+    TEST_CHECK(findIn("[70-7F]", data) == 10);
+    TEST_CHECK(findIn("34{2} 78", data, 0, matchSize) == 8 && matchSize == 3);
+    TEST_CHECK(findIn("34 78 ..?", data, 0, matchSize) == 9 && matchSize == 2);
+    TEST_CHECK(findIn("34 78 ..", data) == -1);
+
+    // Offsets at or past the end find nothing
+    TEST_CHECK(findIn("78", data, 11, matchSize) == -1);
+}
+
+int main()
+{
+    testSyntax();
+    testFind();
+    return testResult();
+}
@@ -0,0 +1,54 @@
+/* checksum_benchmark.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "../common/utility.h"
+
+// Throughput of checksum and comparison routines at every SIMD level supported here, in MB/s
+// Buffers are small enough to stay in cache, so the numbers show the routines themselves and not the memory
+static double throughput(const std::function<UINT32()> & routine, const size_t bufferSize)
+{
+    volatile UINT32 sink = 0;
+    size_t rounds = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    while (elapsed.count() < 0.25) {
+        for (int i = 0; i < 64; i++)
+            sink = sink + routine();
+        rounds += 64;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    return (double)rounds * bufferSize / elapsed.count() / 1e6;
+}
+
+int main()
+{
+    std::vector<UINT8> buffer(0x10000 + 1, 0xFF);
+    const UINT8* data = buffer.data() + 1; // Firmware structures are often not aligned
+    const UINT32 size = 0x10000;
+    
+    std::printf("level    sum8  checksum16  checksum32  allBytesEqual\n");
+    for (UINT8 level = SIMD_LEVEL_NONE; level <= SIMD_LEVEL_AVX2; level++) {
+        if (limitSimdLevel(level) != level)
+            continue;
+        std::printf("%5u %7.0f %11.0f %11.0f %14.0f\n", level,
+                    throughput([&]() { return (UINT32)calculateSum8(data, size); }, size),
+                    throughput([&]() { return (UINT32)calculateChecksum16((const UINT16*)data, size); }, size),
+                    throughput([&]() { return calculateChecksum32((const UINT32*)data, size); }, size),
+                    throughput([&]() { return (UINT32)allBytesEqual(data, size, 0xFF); }, size));
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+/* checksum_test.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "test.h"
+#include "../common/utility.h"
+
+// Plain loops the vector routines have to agree with
+static UINT8 sum8Reference(const UINT8* buffer, UINT32 size)
+{
+    UINT8 sum = 0;
+    for (UINT32 i = 0; i < size; i++)
+        sum = (UINT8)(sum + buffer[i]);
+    return sum;
+}
+
+static UINT16 checksum16Reference(const UINT8* buffer, UINT32 size)
+{
+    UINT16 sum = 0;
+    for (UINT32 i = 0; i + 1 < size; i += 2)
+        sum = (UINT16)(sum + (buffer[i] | (buffer[i + 1] << 8)));
+    return (UINT16)(0x10000 - sum);
+}
+
+static UINT32 checksum32Reference(const UINT8* buffer, UINT32 size)
+{
+    UINT32 sum = 0;
+    for (UINT32 i = 0; i + 3 < size; i += 4)
+        sum += (UINT32)buffer[i] | ((UINT32)buffer[i + 1] << 8) | ((UINT32)buffer[i + 2] << 16) | ((UINT32)buffer[i + 3] << 24);
+    return (UINT32)(0x100000000ULL - sum);
+}
+
+static bool allBytesEqualReference(const UINT8* buffer, UINT32 size, UINT8 value)
+{
+    for (UINT32 i = 0; i < size; i++) {
+        if (buffer[i] != value)
+            return false;
+    }
+    return true;
+}
+
+// Every level is checked at all buffer alignments and at sizes around the vector widths
+static void testLevel(const UINT8 level)
+{
+    std::mt19937 rng(level + 1);
+    std::vector<UINT8> data(0x1000 + 64);
+    
+    for (int round = 0; round < 4; round++) {
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = round == 0 ? 0xFF : (UINT8)rng();
+        
+        for (UINT32 offset = 0; offset < 64; offset++) {
+            for (UINT32 size = 0; size + offset <= data.size(); size += (size < 260 ? 1 : 0x3F)) {
+                const UINT8* buffer = data.data() + offset;
+                TEST_CHECK(calculateSum8(buffer, size) == sum8Reference(buffer, size));
+                TEST_CHECK(calculateChecksum8(buffer, size) == (UINT8)(0x100 - sum8Reference(buffer, size)));
+                TEST_CHECK(calculateChecksum16((const UINT16*)buffer, size) == checksum16Reference(buffer, size));
+                TEST_CHECK(calculateChecksum32((const UINT32*)buffer, size) == checksum32Reference(buffer, size));
+            }
+        }
+    }
+    
+    // A single different byte at any position is found
+    std::vector<UINT8> same(300, 0x5A);
+    for (UINT32 size = 0; size <= same.size(); size++) {
+        TEST_CHECK(allBytesEqual(same.data(), size, 0x5A));
+        TEST_CHECK(allBytesEqual(same.data(), size, 0xA5) == (size == 0));
+        for (UINT32 position = 0; position < size; position++) {
+            same[position] = 0x5B;
+            TEST_CHECK(allBytesEqual(same.data(), size, 0x5A) == allBytesEqualReference(same.data(), size, 0x5A));
+            same[position] = 0x5A;
+        }
+    }
+    TEST_CHECK(allBytesEqual(NULL, 0, 0x00));
+    TEST_CHECK(!allBytesEqual(NULL, 1, 0x00));
+}
+
+int main()
+{
+    for (UINT8 level = SIMD_LEVEL_NONE; level <= SIMD_LEVEL_AVX2; level++) {
+        if (limitSimdLevel(level) == level) {
+            std::printf("Checking SIMD level %u\n", level);
+            testLevel(level);
+        }
+    }
+    return testResult();
+}
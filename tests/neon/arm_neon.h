@@ -0,0 +1,49 @@
+/* arm_neon.h
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+// Scalar stand-ins for the AArch64 NEON intrinsics used by common/utility.cpp,
+// so the NEON code paths can be built and checked on any host
+// Signatures follow the Arm C Language Extensions, lanes are in little-endian order
+
+#ifndef TEST_ARM_NEON_H
+#define TEST_ARM_NEON_H
+
+#include <cstdint>
+#include <cstring>
+
+typedef struct { uint8_t  v[16]; } uint8x16_t;
+typedef struct { uint16_t v[8];  } uint16x8_t;
+typedef struct { uint32_t v[4];  } uint32x4_t;
+
+static inline uint8x16_t vdupq_n_u8(uint8_t value) { uint8x16_t r; for (int i = 0; i < 16; i++) r.v[i] = value; return r; }
+static inline uint16x8_t vdupq_n_u16(uint16_t value) { uint16x8_t r; for (int i = 0; i < 8; i++) r.v[i] = value; return r; }
+static inline uint32x4_t vdupq_n_u32(uint32_t value) { uint32x4_t r; for (int i = 0; i < 4; i++) r.v[i] = value; return r; }
+
+static inline uint8x16_t vld1q_u8(const uint8_t* ptr) { uint8x16_t r; memcpy(r.v, ptr, sizeof(r.v)); return r; }
+
+static inline uint16x8_t vreinterpretq_u16_u8(uint8x16_t a) { uint16x8_t r; memcpy(r.v, a.v, sizeof(r.v)); return r; }
+static inline uint32x4_t vreinterpretq_u32_u8(uint8x16_t a) { uint32x4_t r; memcpy(r.v, a.v, sizeof(r.v)); return r; }
+
+static inline uint8x16_t vaddq_u8(uint8x16_t a, uint8x16_t b) { for (int i = 0; i < 16; i++) a.v[i] = (uint8_t)(a.v[i] + b.v[i]); return a; }
+static inline uint16x8_t vaddq_u16(uint16x8_t a, uint16x8_t b) { for (int i = 0; i < 8; i++) a.v[i] = (uint16_t)(a.v[i] + b.v[i]); return a; }
+static inline uint32x4_t vaddq_u32(uint32x4_t a, uint32x4_t b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] + b.v[i]; return a; }
+
+// Across-lane sums wrap to the lane size
+static inline uint8_t vaddvq_u8(uint8x16_t a) { uint8_t r = 0; for (int i = 0; i < 16; i++) r = (uint8_t)(r + a.v[i]); return r; }
+static inline uint16_t vaddvq_u16(uint16x8_t a) { uint16_t r = 0; for (int i = 0; i < 8; i++) r = (uint16_t)(r + a.v[i]); return r; }
+static inline uint32_t vaddvq_u32(uint32x4_t a) { uint32_t r = 0; for (int i = 0; i < 4; i++) r += a.v[i]; return r; }
+
+static inline uint8x16_t vceqq_u8(uint8x16_t a, uint8x16_t b) { for (int i = 0; i < 16; i++) a.v[i] = a.v[i] == b.v[i] ? 0xFF : 0x00; return a; }
+static inline uint8x16_t vandq_u8(uint8x16_t a, uint8x16_t b) { for (int i = 0; i < 16; i++) a.v[i] &= b.v[i]; return a; }
+static inline uint8_t vminvq_u8(uint8x16_t a) { uint8_t r = 0xFF; for (int i = 0; i < 16; i++) r = a.v[i] < r ? a.v[i] : r; return r; }
+
+#endif // TEST_ARM_NEON_H
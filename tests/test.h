@@ -0,0 +1,36 @@
+/* test.h
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <cstdio>
+
+// Failed checks are reported and counted, tests keep running to report all of them
+static int testFailures = 0;
+
+#define TEST_CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            testFailures++; \
+        } \
+    } while (0)
+
+static inline int testResult()
+{
+    if (testFailures)
+        std::printf("%d check(s) failed\n", testFailures);
+    return testFailures ? 1 : 0;
+}
+
+#endif // TEST_H
@@ -0,0 +1,130 @@
+/* treemodel_benchmark.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "../common/treemodel.h"
+
+// Every operator new is counted, tree items and the arena blocks that hold them are allocated this way,
+// array forms are replaced too, so every allocation is paired with the matching deallocation
+static size_t allocationCount = 0;
+static size_t allocationBytes = 0;
+
+static void* countedAllocate(size_t size)
+{
+    allocationCount++;
+    allocationBytes += size;
+    void* data = std::malloc(size ? size : 1);
+    if (!data)
+        throw std::bad_alloc();
+    return data;
+}
+
+void* operator new(size_t size)
+{
+    return countedAllocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void* data) noexcept
+{
+    std::free(data);
+}
+
+void operator delete[](void* data) noexcept
+{
+    std::free(data);
+}
+
+void operator delete(void* data, size_t) noexcept
+{
+    std::free(data);
+}
+
+void operator delete[](void* data, size_t) noexcept
+{
+    std::free(data);
+}
+
+struct Counters {
+    size_t count;
+    size_t bytes;
+    std::chrono::steady_clock::time_point start;
+};
+
+static Counters startCounting()
+{
+    Counters counters = { allocationCount, allocationBytes, std::chrono::steady_clock::now() };
+    return counters;
+}
+
+static void printCounters(const char* name, const Counters & counters)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - counters.start;
+    std::printf("%-26s %10zu %14zu %10.1f\n", name, allocationCount - counters.count, allocationBytes - counters.bytes, elapsed.count());
+}
+
+// Allocations and time of building, changing and destroying a model shaped like a parsed image
+int main()
+{
+    const int itemCount = 50000;
+    const int infoLines = 32;
+    const int rollbackCount = 2000;
+    const int rollbackItems = 64;
+    
+    std::printf("phase                      allocations          bytes    time ms\n");
+    TreeModel *model = new TreeModel();
+    UModelIndex image = model->addItem(0, Types::Image, 0, UString("Image"), UString(), UString(),
+                                       UByteArray(), UByteArray(), UByteArray(), Fixed);
+    
+    Counters counters = startCounting();
+    std::vector<UModelIndex> items;
+    items.reserve(itemCount);
+    for (int i = 0; i < itemCount; i++) {
+        items.push_back(model->addItem((UINT32)i * 0x10, Types::File, 0, usprintf("8C8CE578-8A3D-4F1C-9935-%012X", i), UString("Text"), UString("Type: 07h\n"),
+                                       UByteArray(), UByteArray(), UByteArray(), Movable, image));
+    }
+    printCounters("add items", counters);
+    
+    // Parsers add info line by line
+    counters = startCounting();
+    for (int line = 0; line < infoLines; line++) {
+        for (int i = 0; i < itemCount; i++)
+            model->addInfo(items[i], usprintf("Line %d: %08Xh\n", line, i));
+    }
+    printCounters("append info lines", counters);
+    
+    // Sections parsed ahead of time are built and dropped over and over in images with bad sections
+    counters = startCounting();
+    for (int round = 0; round < rollbackCount; round++) {
+        UModelIndex parent = items[round % itemCount];
+        for (int i = 0; i < rollbackItems; i++) {
+            UModelIndex child = model->addItem((UINT32)i, Types::Section, 0, UString("Section"), UString(), UString("Type: 10h\n"),
+                                               UByteArray(), UByteArray(), UByteArray(), Movable, parent);
+            model->addInfo(child, UString("Full size: 4h\n"));
+        }
+        model->removeChildren(parent, 0);
+    }
+    printCounters("add and remove children", counters);
+    
+    counters = startCounting();
+    delete model;
+    printCounters("destroy model", counters);
+    return 0;
+}
@@ -0,0 +1,226 @@
+/* treemodel_test.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+#include "../common/treemodel.h"
+
+// Address lookup as it was done before the interval index, by descending into the first covering child
+static UModelIndex findByBaseReference(const TreeModel & model, UINT32 base)
+{
+    UModelIndex parentIndex = model.index(0, 0);
+    bool deeper = true;
+    while (deeper) {
+        deeper = false;
+        for (int i = 0; i < model.childCount(parentIndex); i++) {
+            UModelIndex currentIndex = model.index(i, 0, parentIndex);
+            UINT32 currentBase = model.base(currentIndex);
+            UINT32 fullSize = (UINT32)(model.header(currentIndex).size() + model.body(currentIndex).size() + model.tail(currentIndex).size());
+            if ((!model.compressed(currentIndex) || !model.compressed(currentIndex.parent()))
+                && currentBase <= base && base < currentBase + fullSize) {
+                parentIndex = currentIndex;
+                deeper = true;
+                break;
+            }
+        }
+    }
+    return (parentIndex == model.index(0, 0) ? UModelIndex() : parentIndex);
+}
+
+static void collectCovering(const TreeModel & model, const UModelIndex & parent, UINT32 address, std::vector<UModelIndex> & found)
+{
+    for (int i = 0; i < model.childCount(parent); i++) {
+        UModelIndex child = model.index(i, 0, parent);
+        if (model.compressed(child) && model.compressed(parent))
+            continue;
+        UINT32 fullSize = (UINT32)(model.header(child).size() + model.body(child).size() + model.tail(child).size());
+        if (model.base(child) <= address && address < model.base(child) + fullSize)
+            found.push_back(child);
+        collectCovering(model, child, address, found);
+    }
+}
+
+static bool indexLess(const UModelIndex & lhs, const UModelIndex & rhs)
+{
+    return lhs.internalPointer() < rhs.internalPointer();
+}
+
+// Items of random sizes at random offsets inside their parents, siblings may overlap
+static void addChildren(TreeModel & model, std::mt19937 & rng, const UModelIndex & parent, UINT32 parentSize, int depth)
+{
+    if (depth == 0 || parentSize < 2)
+        return;
+    int count = (int)(rng() % 5);
+    for (int i = 0; i < count; i++) {
+        UINT32 offset = rng() % parentSize;
+        UINT32 size = 1 + rng() % (parentSize - offset);
+        UINT32 headerSize = rng() % 2 ? std::min<UINT32>(size, 4) : 0;
+        UModelIndex child = model.addItem(offset, Types::Section, 0, UString("Item"), UString(), UString(),
+                                          UByteArray(headerSize, 'h'), UByteArray(size - headerSize, (char)(rng() % 3)), UByteArray(),
+                                          Movable, parent);
+        if (rng() % 4 == 0)
+            model.setCompressed(child, true);
+        addChildren(model, rng, child, size, depth - 1);
+    }
+}
+
+static void testLookups()
+{
+    std::mt19937 rng(1);
+    for (int round = 0; round < 200; round++) {
+        TreeModel model;
+        const UINT32 imageSize = 0x1000;
+        UModelIndex image = model.addItem(0, Types::Image, 0, UString("Image"), UString(), UString(),
+                                          UByteArray(), UByteArray((size_t)imageSize, '\xFF'), UByteArray(), Fixed);
+        addChildren(model, rng, image, imageSize, 5);
+        
+        for (UINT32 address = 0; address < imageSize + 0x10; address += 1 + rng() % 7) {
+            TEST_CHECK(model.findByBase(address) == findByBaseReference(model, address));
+            
+            std::vector<UModelIndex> covering = model.findAllCovering(address);
+            std::vector<UModelIndex> expected;
+            collectCovering(model, image, address, expected);
+            std::sort(covering.begin(), covering.end(), indexLess);
+            std::sort(expected.begin(), expected.end(), indexLess);
+            TEST_CHECK(covering == expected);
+        }
+        
+        // The index follows changes of the tree
+        if (model.childCount(image) > 0) {
+            model.removeChildren(image, 0);
+            for (UINT32 address = 0; address < imageSize; address += 0x10)
+                TEST_CHECK(model.findByBase(address) == UModelIndex());
+        }
+    }
+}
+
+// The index is built by whichever lookup comes first, lookups may run on several threads
+static void testConcurrentLookups()
+{
+    std::mt19937 rng(2);
+    TreeModel model;
+    const UINT32 imageSize = 0x10000;
+    UModelIndex image = model.addItem(0, Types::Image, 0, UString("Image"), UString(), UString(),
+                                      UByteArray(), UByteArray((size_t)imageSize, '\xFF'), UByteArray(), Fixed);
+    addChildren(model, rng, image, imageSize, 6);
+    
+    std::vector<UModelIndex> expected;
+    for (UINT32 address = 0; address < imageSize; address += 0x40)
+        expected.push_back(findByBaseReference(model, address));
+    
+    for (int round = 0; round < 20; round++) {
+        model.setCompressed(image, false); // Invalidates the index
+        std::vector<std::thread> threads;
+        std::vector<int> failures(4, 0);
+        for (int t = 0; t < 4; t++) {
+            threads.push_back(std::thread([&model, &expected, &failures, t]() {
+                for (UINT32 address = 0, i = 0; address < imageSize; address += 0x40, i++) {
+                    if (!(model.findByBase(address) == expected[i]))
+                        failures[t]++;
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+        for (int t = 0; t < 4; t++)
+            TEST_CHECK(failures[t] == 0);
+    }
+}
+
+// Items under a stand-in are not in the tree until they are committed
+static void testStandIns()
+{
+    TreeModel model;
+    UModelIndex image = model.addItem(0, Types::Image, 0, UString("Image"), UString(), UString(),
+                                      UByteArray(), UByteArray((size_t)0x1000, '\xFF'), UByteArray(), Fixed);
+    UModelIndex section = model.addItem(0x100, Types::Section, 0, UString("Section"), UString(), UString(),
+                                        UByteArray(4, 'h'), UByteArray((size_t)0x100, '\x00'), UByteArray(), Movable, image);
+    
+    for (int round = 0; round < 2; round++) {
+        UModelIndex standIn = model.createStandIn(section);
+        TEST_CHECK(standIn.isValid());
+        TEST_CHECK(standIn.parent() == image);
+        TEST_CHECK(model.base(standIn) == model.base(section));
+        for (UINT32 i = 0; i < 4; i++) {
+            UModelIndex child = model.addItem(4 + i * 0x40, Types::Section, 0, UString("Child"), UString(), UString(),
+                                              UByteArray(4, 'h'), UByteArray((size_t)0x3C, (char)i), UByteArray(), Movable, standIn);
+            TEST_CHECK(child.parent() == standIn);
+        }
+        TEST_CHECK(model.childCount(image) == 1);
+        TEST_CHECK(model.childCount(section) == 0);
+        TEST_CHECK(model.findByBase(0x148) == section);
+        
+        if (round == 0) {
+            model.dropStandIn(standIn);
+            TEST_CHECK(model.childCount(section) == 0);
+            continue;
+        }
+        
+        model.commitStandIn(standIn, section);
+        TEST_CHECK(model.childCount(section) == 4);
+        for (int i = 0; i < 4; i++) {
+            UModelIndex child = model.index(i, 0, section);
+            TEST_CHECK(child.row() == i);
+            TEST_CHECK(child.parent() == section);
+            TEST_CHECK(model.base(child) == model.base(section) + 4 + (UINT32)i * 0x40);
+        }
+        TEST_CHECK(model.findByBase(0x148) == model.index(1, 0, section));
+    }
+}
+
+// Strings kept in the arena survive appends, shrinking, growing and reuse of memory of removed items
+static void testStrings()
+{
+    TreeModel model;
+    UModelIndex image = model.addItem(0, Types::Image, 0, UString("Image"), UString(), UString("Image info\n"),
+                                      UByteArray(), UByteArray((size_t)0x1000, '\xFF'), UByteArray(), Fixed);
+    UString expected("Image info\n");
+    for (int round = 0; round < 100; round++) {
+        UModelIndex file = model.addItem(0x10, Types::File, 0, usprintf("File %d", round), UString("Text"), UString(),
+                                         UByteArray(), UByteArray((size_t)0x10, '\x00'), UByteArray(), Movable, image);
+        for (int line = 0; line < round % 10; line++)
+            model.addInfo(file, usprintf("Line %d\n", line));
+        model.addInfo(file, UString("First\n"), false);
+        UString line = usprintf("Line %d of image info\n", round);
+        model.addInfo(image, line);
+        expected += line;
+        
+        UString fileInfo("First\n");
+        for (int i = 0; i < round % 10; i++)
+            fileInfo += usprintf("Line %d\n", i);
+        TEST_CHECK(model.info(file) == fileInfo);
+        TEST_CHECK(model.name(file) == usprintf("File %d", round));
+        model.setName(file, UString("F"));
+        TEST_CHECK(model.name(file) == UString("F"));
+        model.setName(file, UString("A much longer name of the file"));
+        TEST_CHECK(model.name(file) == UString("A much longer name of the file"));
+        TEST_CHECK(model.text(file) == UString("Text"));
+        
+        if (round % 3 == 2)
+            model.removeChildren(image, 0);
+    }
+    TEST_CHECK(model.info(image) == expected);
+    TEST_CHECK(model.name(image) == UString("Image"));
+}
+
+int main()
+{
+    testLookups();
+    testStandIns();
+    testStrings();
+    testConcurrentLookups();
+    return testResult();
+}
@@ -0,0 +1,102 @@
+/* treewalk_benchmark.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "../common/treemodel.h"
+
+// Time per item of an operation repeated until it takes a while, in nanoseconds
+static double timePerItem(const std::function<UINTN()> & operation)
+{
+    UINTN items = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::nano> elapsed(0);
+    while (elapsed.count() < 2.5e8) {
+        items += operation();
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+    return elapsed.count() / items;
+}
+
+// Depth-first walk the way parsers and reports do it, by rows of children
+static UINTN walk(const TreeModel & model, const UModelIndex & index, UINT32 & sink)
+{
+    UINTN count = 1;
+    sink += model.offset(index);
+    for (int i = 0; i < model.childCount(index); i++)
+        count += walk(model, model.childIndex(i, index), sink);
+    return count;
+}
+
+// Cost of walking and navigating a synthetic volume with 20k files, two sections each
+int main()
+{
+    const int fileCount = 20000;
+    const int insertCount = 2000;
+    
+    TreeModel model;
+    UModelIndex image = model.addItem(0, Types::Image, 0, UString("Image"), UString(), UString(),
+                                      UByteArray(), UByteArray(), UByteArray(), Fixed);
+    UModelIndex volume = model.addItem(0, Types::Volume, 0, UString("Volume"), UString(), UString(),
+                                       UByteArray(), UByteArray(), UByteArray(), Fixed, image);
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<UModelIndex> files;
+    files.reserve(fileCount);
+    for (int i = 0; i < fileCount; i++) {
+        UModelIndex file = model.addItem((UINT32)i * 0x100, Types::File, 0, UString("File"), UString(), UString(),
+                                         UByteArray(), UByteArray(), UByteArray(), Movable, volume);
+        for (int j = 0; j < 2; j++) {
+            model.addItem((UINT32)j * 0x80, Types::Section, 0, UString("Section"), UString(), UString(),
+                          UByteArray(), UByteArray(), UByteArray(), Movable, file);
+        }
+        files.push_back(file);
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("build %d files:            %10.1f ms\n", fileCount, elapsed.count());
+    
+    // Items found in the middle of a volume are inserted next to their neighbours
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < insertCount; i++) {
+        model.addItem(0, Types::Padding, 0, UString("Padding"), UString(), UString(),
+                      UByteArray(), UByteArray(), UByteArray(), Movable, files[(i * 7919) % fileCount], i % 2 ? CREATE_MODE_AFTER : CREATE_MODE_BEFORE);
+    }
+    elapsed = std::chrono::steady_clock::now() - start;
+    std::printf("insert %d items in between: %9.1f ms\n", insertCount, elapsed.count());
+    
+    UINT32 sink = 0;
+    std::printf("recursive walk:             %10.1f ns per item\n", timePerItem([&]() { return walk(model, image, sink); }));
+    
+    // Lookups of parents and rows, i.e. for messages and selection of items
+    std::printf("parent and row lookup:      %10.1f ns per item\n", timePerItem([&]() {
+        for (size_t i = 0; i < files.size(); i++) {
+            UModelIndex parent = model.parent(files[i]);
+            sink += (UINT32)files[i].row() + (UINT32)parent.row();
+        }
+        return (UINTN)files.size();
+    }));
+    
+    // Random access to children by row
+    std::printf("child by row:               %10.1f ns per item\n", timePerItem([&]() {
+        int count = model.childCount(volume);
+        for (int i = 0; i < count; i++) {
+            UModelIndex file = model.childIndex((i * 7919) % count, volume);
+            sink += model.offset(file);
+        }
+        return (UINTN)count;
+    }));
+    
+    return sink == 0xFFFFFFFF;
+}
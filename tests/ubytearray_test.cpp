@@ -0,0 +1,162 @@
+/* ubytearray_test.cpp
+
+Copyright (c) 2026, UEFITool contributors. All rights reserved.
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+*/
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "test.h"
+#include "../common/ubytearray.h"
+#include "../common/ustring.h"
+
+static void testSlices()
+{
+    UByteArray ba("0123456789", 10);
+    UByteArray copy = ba;
+    TEST_CHECK(copy.constData() == ba.constData());
+    
+    UByteArray slice = ba.mid(2, 4);
+    TEST_CHECK(slice.size() == 4);
+    TEST_CHECK(slice.constData() == ba.constData() + 2);
+    TEST_CHECK(slice == UByteArray("2345", 4));
+    TEST_CHECK(ba.left(3) == UByteArray("012", 3));
+    TEST_CHECK(ba.right(3) == UByteArray("789", 3));
+    TEST_CHECK(ba.right(20) == ba);
+    
+    // Out of range slices are empty or clamped to the array, as QByteArray::mid does
+    TEST_CHECK(ba.mid(10).isEmpty());
+    TEST_CHECK(ba.mid(-1, 2).isEmpty());
+    TEST_CHECK(ba.mid(8, 10) == UByteArray("89", 2));
+    TEST_CHECK(ba.mid(8, -1) == UByteArray("89", 2));
+    TEST_CHECK(ba.mid(3, 0).isEmpty());
+    TEST_CHECK(ba.mid(2, 4).mid(1, 2) == UByteArray("34", 2));
+}
+
+static void testCopyOnWrite()
+{
+    UByteArray ba("0123456789", 10);
+    UByteArray slice = ba.mid(2, 4);
+    
+    // Writing to a slice detaches it
+    slice[0] = 'x';
+    TEST_CHECK(slice == UByteArray("x345", 4));
+    TEST_CHECK(ba == UByteArray("0123456789", 10));
+    
+    // Writing to the only view of a buffer keeps it in place
+    UByteArray single("abc", 3);
+    const char* before = single.constData();
+    single[1] = 'B';
+    TEST_CHECK(single.constData() == before);
+    TEST_CHECK(single == UByteArray("aBc", 3));
+    
+    // Appending to a shared array does not change other views of its buffer
+    UByteArray head = ba.left(5);
+    head += UByteArray("ab", 2);
+    TEST_CHECK(head == UByteArray("01234ab", 7));
+    TEST_CHECK(ba == UByteArray("0123456789", 10));
+    
+    UByteArray copy = ba;
+    copy += UByteArray("!", 1);
+    TEST_CHECK(copy.size() == 11);
+    TEST_CHECK(ba.size() == 10);
+    
+    // Appending to the sole owner of a buffer reuses it
+    UByteArray owner("xy", 2);
+    owner += UByteArray("z", 1);
+    TEST_CHECK(owner == UByteArray("xyz", 3));
+}
+
+static void testExternalStorage()
+{
+    static const char raw[] = "external";
+    bool released = false;
+    {
+        UByteArray ba(std::shared_ptr<const char>(raw, [&released](const char*) { released = true; }), 8);
+        UByteArray slice = ba.mid(2, 3);
+        TEST_CHECK(slice.constData() == raw + 2);
+        ba.clear();
+        TEST_CHECK(!released);
+        
+        // Writing copies external bytes instead of changing them
+        slice[0] = 'T';
+        TEST_CHECK(slice == UByteArray("Ter", 3));
+        TEST_CHECK(raw[2] == 't');
+        TEST_CHECK(released);
+    }
+    
+    UByteArray fromRaw = UByteArray::fromRawData(raw, 8);
+    TEST_CHECK(fromRaw.constData() == raw);
+    fromRaw += UByteArray("!", 1);
+    TEST_CHECK(fromRaw == UByteArray("external!", 9));
+    TEST_CHECK(fromRaw.constData() != raw);
+}
+
+// Slices of one buffer are handed to threads that read, modify and release them,
+// while the owner keeps modifying its own view in place
+static void testThreads()
+{
+    const int threadCount = 4;
+    const int iterations = 2000;
+    for (int round = 0; round < 20; round++) {
+        UByteArray ba(std::string(4096, 'a'));
+        std::vector<std::thread> threads;
+        std::vector<int> failures(threadCount, 0);
+        for (int t = 0; t < threadCount; t++) {
+            UByteArray slice = ba.mid(t * 1024, 1024);
+            threads.push_back(std::thread([slice, t, &failures]() mutable {
+                for (int i = 0; i < iterations; i++) {
+                    UByteArray copy = slice;
+                    if (copy.at(i % 1024) != 'a')
+                        failures[t]++;
+                    copy[i % 1024] = 'b';
+                    if (copy.at(i % 1024) != 'b' || slice.at(i % 1024) != 'a')
+                        failures[t]++;
+                }
+                slice.clear();
+            }));
+        }
+        
+        // Writes detach the owner while the threads still hold their slices
+        for (int i = 0; i < iterations; i++)
+            ba[i % 4096] = 'a';
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+        for (int t = 0; t < threadCount; t++)
+            TEST_CHECK(failures[t] == 0);
+        
+        // All slices are gone, so the buffer is written in place again
+        const char* before = ba.constData();
+        ba[0] = 'c';
+        TEST_CHECK(ba.constData() == before);
+        TEST_CHECK(ba.count('a') == 4095);
+    }
+}
+
+static void testUcs2()
+{
+    // Slices are not NUL-terminated, conversion must stop at the given bound
+    UByteArray image("A\0B\0C\0D\0", 8);
+    TEST_CHECK(uFromUcs2(image.constData(), image.mid(0, 4).size() / 2) == UString("AB"));
+    TEST_CHECK(uFromUcs2(image.constData(), image.mid(0, 1).size() / 2) == UString(""));
+    TEST_CHECK(uFromUcs2(image.constData(), 0) == UString(""));
+    TEST_CHECK(uFromUcs2("A\0\0\0C\0", 3) == UString("A"));
+}
+
+int main()
+{
+    testSlices();
+    testCopyOnWrite();
+    testExternalStorage();
+    testThreads();
+    testUcs2();
+    return testResult();
+}